@@ -46,7 +46,7 @@ public:
   MyGLApp() : GLApp(800,600,1,"Assignment 03 - Hello Shading") {}
 
   virtual void init() override {
-    time = glfwGetTime();
+    time = getTime();
     setupShaders();
     setupGeometry();
     GL(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
@@ -73,7 +73,7 @@ public:
   }
 
   virtual void draw() override {
-    double t = glfwGetTime();
+    double t = getTime();
     double d = t - time;
     time = t;
 
@@ -295,6 +295,5 @@ public:
 
 int main(int argc, char** argv) {
   MyGLApp myApp;
-  myApp.run();
-  return EXIT_SUCCESS;
+  return myApp.run();
 }
@@ -279,6 +279,5 @@ public:
 
 int main(int argc, char** argv) {
   MyGLApp myApp;
-  myApp.run();
-  return EXIT_SUCCESS;
+  return myApp.run();
 }
@@ -2,6 +2,9 @@
 #include <GLApp.h>
 #include <Vec2.h>
 #include <GLFramebuffer.h>
+#include <GLProgramVariants.h>
+#include <ShadowMapCache.h>
+#include <CascadedShadowMap.h>
 
 #include "Teapot.h"
 #include "UnitPlane.h"
@@ -43,14 +46,18 @@ class MyGLApp : public GLApp {
 public:
   LightProperties light;
   Mat4 projectionMatrix;
+  float aspectRatio{1.0f};
 
   GLTexture2D stonesDiffuse{GL_LINEAR, GL_LINEAR};
   GLTexture2D stonesSpecular{GL_LINEAR, GL_LINEAR};
   GLTexture2D stonesNormals{GL_LINEAR, GL_LINEAR};
   GLTexture2D udeNormals{GL_LINEAR, GL_LINEAR};
 
-  GLProgram pPhongBump;
-  GLProgram pPhongBumpTex;
+  GLProgramVariants phongBump;
+  const GLProgram& pPhongBump;
+  const GLProgram& pPhongBumpTex;
+  const GLProgram& pPhongBumpCascaded;
+  const GLProgram& pPhongBumpTexCascaded;
   GLProgram pLight;
 
   GLArray lightArray;
@@ -73,8 +80,13 @@ public:
   GLBuffer teapotIndexBuffer{GL_ELEMENT_ARRAY_BUFFER};
 
   GLProgram shadowProgram;
-  GLFramebuffer framebuffer;
-  GLDepthTexture shadowMap;
+  ShadowMapCache shadows{2048, 2048};
+  // four 1024² cascades fill as many texels as the single 2048² map
+  CascadedShadowMap cascades{1024, 4};
+  bool cascaded{false};
+  const float shadowDistance{400.0f};
+  uint64_t sceneGeneration{0}; // bump whenever a shadow caster changes
+  Mat4 casterViewProjection;   // light view-projection of the shadow pass being drawn
   const Mat4 cliptToTextureMatrix {
     0.5f, 0.0f, 0.0f, 0.5f,
     0.0f, 0.5f, 0.0f, 0.5f,
@@ -105,19 +117,18 @@ public:
 
   MyGLApp() :
     GLApp(800,600,1,"Assignment 06 - Hello Sky"),
+    phongBump{GLProgramVariants::createFromFile("res/phongBump.vert","res/phongBump.frag")},
+    pPhongBump{phongBump.get(0)},
+    pPhongBumpTex{phongBump.get({"TEXTURED"})},
+    pPhongBumpCascaded{phongBump.get({"CASCADED"})},
+    pPhongBumpTexCascaded{phongBump.get({"TEXTURED", "CASCADED"})},
 #ifndef __EMSCRIPTEN__
-    pPhongBump{GLProgram::createFromFile("res/phongBump.vert","res/phongBump.frag")},
-    pPhongBumpTex{GLProgram::createFromFile("res/phongBump.vert","res/phongBumpTex.frag")},
     pLight{GLProgram::createFromFile("res/light.vert","res/light.frag")},
 #else
-  pPhongBump{GLProgram::createFromFile("res/phongBump3.vert","res/phongBump3.frag")},
-  pPhongBumpTex{GLProgram::createFromFile("res/phongBump3.vert","res/phongBumpTex3.frag")},
   pLight{GLProgram::createFromFile("res/light3.vert","res/light3.frag")},
 #endif
     shadowProgram{GLProgram::createFromString(shadowVertexShader,shadowFragmentShader)}
-  {
-    shadowMap.setEmpty(2048,2048);
-  }
+  {}
 
   virtual void init() override {
     setupTextures();
@@ -159,12 +170,29 @@ public:
     lightPosition =  viewMatrix * lightModelMatrix * Vec4(0, 0, 0, 1);
 
     lightProjectionMatrix = Mat4::perspective(60.0f,
-                                        float(shadowMap.getWidth())/
-                                        float(shadowMap.getHeight()),
+                                        float(shadows.getShadowMap().getWidth())/
+                                        float(shadows.getShadowMap().getHeight()),
                                         1.0f, 400);
     lightViewMatrix = Mat4::lookAt(lightModelMatrix * Vec3{0,0,0}, {0,0,0}, {0,1,0});
 
     worldToShadowMatrix = cliptToTextureMatrix*lightProjectionMatrix*lightViewMatrix;
+
+    // the cascades treat the light as directional, shining towards the origin
+    if (cascaded)
+      cascades.fit(viewMatrix, 60.0f, aspectRatio, 0.1f, shadowDistance,
+                   Vec3{0,0,0} - lightModelMatrix * Vec3{0,0,0});
+  }
+
+  void setShadowUniforms(const GLProgram& program, GLenum unit) {
+    if (cascaded) {
+      program.setTexture("shadowMaps", cascades.getTexture(), unit);
+      program.setUniform(program.getUniformLocation("cascadeWorldToShadow"), cascades.getWorldToShadow());
+      program.setUniform("cascadeSplits", cascades.getSplits());
+      program.setUniform("cascadeCount", int(cascades.getCascadeCount()));
+    } else {
+      program.setUniform("worldToShadow", worldToShadowMatrix);
+      program.setTexture("shadowMap", shadows.getShadowMap(), unit);
+    }
   }
 
   void renderLightSource() {
@@ -183,20 +211,20 @@ public:
       const Mat4 modelViewProjection = projectionMatrix * modelView;
       const Mat4 modelViewIT = Mat4::transpose(Mat4::inverse(modelView));
 
-      pPhongBumpTex.enable();
-      pPhongBumpTex.setUniform("MVP", modelViewProjection);
-      pPhongBumpTex.setUniform("MV", modelView);
-      pPhongBumpTex.setUniform("M", modelMatrix);
-      pPhongBumpTex.setUniform("worldToShadow", worldToShadowMatrix);
-      pPhongBumpTex.setUniform("MVit", modelViewIT);
-      pPhongBumpTex.setUniform("lightPosition", lightPosition);
-      pPhongBumpTex.setTexture("td", stonesDiffuse,0);
-      pPhongBumpTex.setTexture("ts", stonesSpecular,1);
-      pPhongBumpTex.setTexture("tn", stonesNormals,2);
-      pPhongBumpTex.setTexture("shadowMap", shadowMap,3);
+      const GLProgram& program = cascaded ? pPhongBumpTexCascaded : pPhongBumpTex;
+      program.enable();
+      program.setUniform("MVP", modelViewProjection);
+      program.setUniform("MV", modelView);
+      program.setUniform("M", modelMatrix);
+      program.setUniform("MVit", modelViewIT);
+      program.setUniform("lightPosition", lightPosition);
+      program.setTexture("td", stonesDiffuse,0);
+      program.setTexture("ts", stonesSpecular,1);
+      program.setTexture("tn", stonesNormals,2);
+      setShadowUniforms(program, 3);
     } else {
       shadowProgram.enable();
-      shadowProgram.setUniform("MVP", lightProjectionMatrix*lightViewMatrix*modelMatrix);
+      shadowProgram.setUniform("MVP", casterViewProjection*modelMatrix);
     }
 
     planeArray.bind();
@@ -209,17 +237,17 @@ public:
       const Mat4 modelViewProjection = projectionMatrix * modelView;
       const Mat4 modelViewIT = Mat4::transpose(Mat4::inverse(modelView));
 
-      pPhongBump.enable();
-      pPhongBump.setUniform("MVP", modelViewProjection);
-      pPhongBump.setUniform("MV", modelView);
-      pPhongBump.setUniform("M", modelMatrix);
-      pPhongBumpTex.setUniform("worldToShadow", worldToShadowMatrix);
-      pPhongBump.setUniform("MVit", modelViewIT);
-      pPhongBump.setUniform("lightPosition", lightPosition);
-      pPhongBump.setTexture("tn", udeNormals,0);
-      pPhongBump.setTexture("shadowMap", shadowMap,1);
+      const GLProgram& program = cascaded ? pPhongBumpCascaded : pPhongBump;
+      program.enable();
+      program.setUniform("MVP", modelViewProjection);
+      program.setUniform("MV", modelView);
+      program.setUniform("M", modelMatrix);
+      program.setUniform("MVit", modelViewIT);
+      program.setUniform("lightPosition", lightPosition);
+      program.setTexture("tn", udeNormals,0);
+      setShadowUniforms(program, 1);
     } else {
-      shadowProgram.setUniform("MVP", lightProjectionMatrix*lightViewMatrix*modelMatrix);
+      shadowProgram.setUniform("MVP", casterViewProjection*modelMatrix);
     }
 
     teapotArray.bind();
@@ -229,13 +257,30 @@ public:
   virtual void draw() override {
     updateState();
 
-    framebuffer.bind(shadowMap);
-    GL(glViewport(0, 0, GLsizei(shadowMap.getWidth() ), GLsizei(shadowMap.getHeight())));
-    GL(glClear(GL_DEPTH_BUFFER_BIT));
-    renderScene(false);
-    framebuffer.unbind2D();
+    if (cascaded) {
+      // cascades follow the camera; each is re-rendered only when its snapped
+      // projection moved
+      PROFILE_GPU("shadow cascades");
+      // far cascades have large texels, so the bias has to follow the slope
+      GL(glEnable(GL_POLYGON_OFFSET_FILL));
+      GL(glPolygonOffset(2.0f, 4.0f));
+      cascades.render(sceneGeneration, [this](const Mat4& lightViewProjection, uint32_t) {
+        casterViewProjection = lightViewProjection;
+        renderScene(false);
+      });
+      GL(glDisable(GL_POLYGON_OFFSET_FILL));
+    } else {
+      // only re-rendered while the light moves
+      PROFILE_GPU("shadow pass");
+      casterViewProjection = lightProjectionMatrix*lightViewMatrix;
+      shadows.update(casterViewProjection, sceneGeneration,
+                     [this]() {renderScene(false);});
+    }
 
-    const Dimensions dim = glEnv.getFramebufferSize();
+    PROFILE_GPU("main pass");
+    // the shadow passes changed the viewport; with dynamic resolution the
+    // main pass renders at less than the framebuffer size
+    const Dimensions dim = getRenderSize();
     GL(glViewport(0, 0, GLsizei(dim.width), GLsizei(dim.height)));
     GL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
     renderLightSource();
@@ -243,8 +288,8 @@ public:
   }
 
   virtual void resize(int width, int height) override {
-    const float ratio = static_cast<float>(width) / static_cast<float>(height);
-    projectionMatrix = Mat4::perspective(60.0f, ratio, 0.1f, 10000.0f);
+    aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    projectionMatrix = Mat4::perspective(60.0f, aspectRatio, 0.1f, 10000.0f);
     GL(glViewport(0, 0, width, height));
   }
 
@@ -311,6 +356,13 @@ public:
         case GLENV_KEY_SPACE:
           setAnimation(!getAnimation());
           break;
+        case GLENV_KEY_C:
+          cascaded = !cascaded;
+          break;
+        case GLENV_KEY_D:
+          // keep the main pass within 8 ms of GPU time
+          setDynamicResolution(getDynamicResolution() ? 0.0 : 8.0);
+          break;
         case GLENV_KEY_R:
           resetAnimation();
           viewPosition = Vec3{ 0, 0, 100 };
@@ -376,6 +428,5 @@ public:
 
 int main(int argc, char** argv) {
   MyGLApp myApp;
-  myApp.run();
-  return EXIT_SUCCESS;
+  return myApp.run();
 }
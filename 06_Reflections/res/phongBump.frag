@@ -1,46 +1,75 @@
-#version 410 core
+// version header and feature defines are injected by GLProgramVariants
+#pragma features TEXTURED NORMAL_MAP_MASK CASCADED
 
 in vec3 posViewSpaceInterpolated;
 in vec3 normalViewSpaceInterpolated;
 in vec3 tangentViewSpaceInterpolated;
 in vec3 binormViewSpaceInterpolated;
 in vec2 texCoordsInterpolated;
+#ifdef CASCADED
+in vec3 worldPos;
+#else
 in vec4 shadowPos;
-
+#endif
+
+#ifdef TEXTURED
+uniform sampler2D td;
+uniform sampler2D ts;
+#else
+const vec3 kd = vec3(0.0, 0.0, 0.8); // material diffuse color
+const vec3 ks = vec3(1.0, 1.0, 1.0); // material specular color
+#endif
 uniform sampler2D tn;
+#ifdef CASCADED
+uniform sampler2DArrayShadow shadowMaps;
+uniform mat4 cascadeWorldToShadow[4];
+uniform vec4 cascadeSplits; // view-space far end of each cascade
+uniform int cascadeCount;
+#else
 uniform sampler2DShadow shadowMap;
+#endif
 
 uniform vec4 lightPosition;
 
-uniform float depthBias = 0.01;
+#ifdef CASCADED
+const float depthBias = 0.0005; // the cascades store linear depth
+#else
+const float depthBias = 0.01;
+#endif
 
-uniform vec3 ka = vec3(0.05f, 0.05f, 0.05f); // material ambient color
-uniform vec3 kd = vec3(0.0f, 0.0f, 0.8f); // material diffuse color
-uniform vec3 ks = vec3(1.0f, 1.0f, 1.0f); // material specular color
-uniform float shininess = 50.0f;
+const vec3 ka = vec3(0.05, 0.05, 0.05); // material ambient color
+const float shininess = 50.0;
 
-uniform vec3 la = vec3(0.9f, 0.9f, 0.9f); // light ambient color
-uniform vec3 ld = vec3(0.9f, 0.9f, 0.9f); // light diffuse color
-uniform vec3 ls = vec3(0.9f, 0.9f, 0.9f); // light specular color
+const vec3 la = vec3(0.9, 0.9, 0.9); // light ambient color
+const vec3 ld = vec3(0.9, 0.9, 0.9); // light diffuse color
+const vec3 ls = vec3(0.9, 0.9, 0.9); // light specular color
 
 out vec4 color;
 
 void main() {
+#ifdef TEXTURED
+  vec3 kd = texture(td, texCoordsInterpolated).rgb;
+  vec3 ks = texture(ts, texCoordsInterpolated).rgb;
+#endif
   vec3 normalMap = texture(tn, texCoordsInterpolated).xyz;
 
   vec3 N = normalize(normalViewSpaceInterpolated);
   vec3 T = normalize(tangentViewSpaceInterpolated);
   vec3 B = normalize(binormViewSpaceInterpolated);
 
+#ifdef NORMAL_MAP_MASK
+  // black texels mark regions that keep the interpolated normal
   if(normalMap != vec3(0, 0, 0)) {
-    normalMap = 2 * (normalMap - vec3(0.5)); // [0, 1] should map to [-1, 1]
+#endif
+    normalMap = 2.0 * (normalMap - vec3(0.5)); // [0, 1] should map to [-1, 1]
     normalMap = normalize(normalMap);
 
     mat3 tbnMatrix = mat3(T, B, N);
     N = tbnMatrix * normalMap;
     N = normalize(N);
+#ifdef NORMAL_MAP_MASK
   }
-
+#endif
 
   vec3 lightVec = normalize(lightPosition.xyz - posViewSpaceInterpolated);
 
@@ -48,25 +77,34 @@ void main() {
   vec3 ambient = ka * la;
 
   // diffuse color
-  float d = max(0, dot(N, lightVec));
+  float d = max(0.0, dot(N, lightVec));
   vec3 diffuse = d * kd * ld;
 
-  float s = 0;
-  if(d > 0) {
+  float s = 0.0;
+  if(d > 0.0) {
     vec3 viewVec =  normalize(-posViewSpaceInterpolated); // camera is placed in origin in view space, view vector == -posViewSpace
     vec3 reflected =  reflect(-lightVec, N); // reflect expects L pointing to surface
-    s = pow(max(0, dot(viewVec, reflected)), shininess);
+    s = pow(max(0.0, dot(viewVec, reflected)), shininess);
   }
 
   vec3 specular = s * ks * ls;
 
+#ifdef CASCADED
+  float viewDepth = -posViewSpaceInterpolated.z;
+  int cascade = 0;
+  while (cascade < cascadeCount-1 && viewDepth > cascadeSplits[cascade]) cascade++;
+  vec4 cascadePos = cascadeWorldToShadow[cascade] * vec4(worldPos, 1.0);
+  float shadowPercentage = 1.0; // beyond the shadow distance
+  if (viewDepth <= cascadeSplits[cascadeCount-1])
+    shadowPercentage = texture(shadowMaps, vec4(cascadePos.xy, float(cascade), cascadePos.z - depthBias));
+#else
   vec4 biasedShadow = shadowPos;
   biasedShadow.z -= depthBias;
   float shadowPercentage = textureProj(shadowMap,biasedShadow);
+#endif
 
   vec4 lightColor = vec4(ambient + diffuse + specular, 1);
   vec4 shadowColor = vec4(ambient, 1);
 
   color = mix(shadowColor, lightColor, shadowPercentage);
-
 }
@@ -1,4 +1,4 @@
-#version 410 core
+// version header is injected by GLProgramVariants
 
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec3 vertexNormal;
@@ -10,22 +10,32 @@ uniform mat4 MVP; // model-view-projection Matrix
 uniform mat4 MV; // model-view Matrix
 uniform mat4 M; // model matrix
 uniform mat4 MVit; // model-view inverse transpose Matrix
+#ifdef CASCADED
+out vec3 worldPos;
+#else
 uniform mat4 worldToShadow;
+#endif
 
 out vec3 posViewSpaceInterpolated;
 out vec3 normalViewSpaceInterpolated;
 out vec3 tangentViewSpaceInterpolated;
 out vec3 binormViewSpaceInterpolated;
 out vec2 texCoordsInterpolated;
+#ifndef CASCADED
 out vec4 shadowPos;
+#endif
 
 void main() {
-  gl_Position = MVP * vec4(vertexPosition, 1);
-  posViewSpaceInterpolated    = vec3(MV * vec4(vertexPosition, 1));
+  gl_Position = MVP * vec4(vertexPosition, 1.0);
+  posViewSpaceInterpolated    = vec3(MV * vec4(vertexPosition, 1.0));
 
-  normalViewSpaceInterpolated = normalize((MVit * vec4(vertexNormal, 0)).xyz);
-  tangentViewSpaceInterpolated = normalize((MVit * vec4(vertexTangent, 0)).xyz);;
-  binormViewSpaceInterpolated = normalize((MVit * vec4(vertexBinormal, 0)).xyz);;
+  normalViewSpaceInterpolated = normalize((MVit * vec4(vertexNormal, 0.0)).xyz);
+  tangentViewSpaceInterpolated = normalize((MVit * vec4(vertexTangent, 0.0)).xyz);;
+  binormViewSpaceInterpolated = normalize((MVit * vec4(vertexBinormal, 0.0)).xyz);;
   texCoordsInterpolated = vertexTexCoords;
-  shadowPos = worldToShadow * M * vec4(vertexPosition, 1);
+#ifdef CASCADED
+  worldPos = (M * vec4(vertexPosition, 1.0)).xyz;
+#else
+  shadowPos = worldToShadow * M * vec4(vertexPosition, 1.0);
+#endif
 }
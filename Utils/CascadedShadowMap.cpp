@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "CascadedShadowMap.h"
+#include "Trace.h"
+
+CascadedShadowMap::CascadedShadowMap(uint32_t resolution, uint32_t cascadeCount) :
+  resolution(resolution),
+  cascadeCount(std::clamp(cascadeCount, 2u, maxCascades)),
+  viewProjections(this->cascadeCount),
+  worldToShadow(this->cascadeCount),
+  renderedViewProjections(this->cascadeCount),
+  rendered(this->cascadeCount, false)
+{
+  texture.setEmpty(resolution, resolution, this->cascadeCount);
+  texture.setLabel("shadow cascades");
+}
+
+void CascadedShadowMap::fit(const Mat4& view, float fovY, float aspect, float zNear,
+                            float shadowDistance, const Vec3& lightDirection) {
+  const Mat4 clipToTexture {
+    0.5f, 0.0f, 0.0f, 0.5f,
+    0.0f, 0.5f, 0.0f, 0.5f,
+    0.0f, 0.0f, 0.5f, 0.5f,
+    0.0f, 0.0f, 0.0f, 1.0f
+  };
+
+  const float tanY = std::tan(fovY * 3.14159265f / 360.0f);
+  const float tanX = tanY * aspect;
+  const Mat4 viewToWorld = Mat4::inverse(view);
+
+  // the light view only rotates, so texel snapping in its xy plane is stable
+  const Vec3 direction = Vec3::normalize(lightDirection);
+  const Vec3 up = std::fabs(direction.y) > 0.99f ? Vec3{0,0,1} : Vec3{0,1,0};
+  const Mat4 lightView = Mat4::lookAt({0,0,0}, direction, up);
+
+  float sliceNear = zNear;
+  for (uint32_t c = 0;c<cascadeCount;++c) {
+    const float t = float(c+1) / float(cascadeCount);
+    const float uniform = zNear + (shadowDistance - zNear) * t;
+    const float logarithmic = zNear * std::pow(shadowDistance / zNear, t);
+    const float sliceFar = splitLambda * logarithmic + (1.0f - splitLambda) * uniform;
+    splits[c] = sliceFar;
+
+    // bounding sphere of the slice in view space; it is independent of the
+    // camera orientation, so the cascade does not change size while turning
+    const Vec3 corners[8] = {
+      {-tanX*sliceNear, -tanY*sliceNear, -sliceNear}, {tanX*sliceNear, -tanY*sliceNear, -sliceNear},
+      {-tanX*sliceNear,  tanY*sliceNear, -sliceNear}, {tanX*sliceNear,  tanY*sliceNear, -sliceNear},
+      {-tanX*sliceFar,   -tanY*sliceFar,  -sliceFar},  {tanX*sliceFar,   -tanY*sliceFar,  -sliceFar},
+      {-tanX*sliceFar,    tanY*sliceFar,  -sliceFar},  {tanX*sliceFar,    tanY*sliceFar,  -sliceFar}
+    };
+    Vec3 center{0,0,0};
+    for (const Vec3& corner : corners) center = center + corner;
+    center = center / 8.0f;
+    float radius = 0.0f;
+    for (const Vec3& corner : corners) radius = std::max(radius, (corner - center).length());
+    // quantize, so rounding noise does not change the texel size
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    Vec3 lightCenter = lightView * (viewToWorld * center);
+    const float texel = 2.0f * radius / float(resolution);
+    lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+    lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+
+    const Mat4 projection = Mat4::ortho(lightCenter.x - radius, lightCenter.x + radius,
+                                        lightCenter.y - radius, lightCenter.y + radius,
+                                        -lightCenter.z - radius - casterDistance,
+                                        -lightCenter.z + radius);
+    viewProjections[c] = projection * lightView;
+    worldToShadow[c] = clipToTexture * viewProjections[c];
+    sliceNear = sliceFar;
+  }
+}
+
+uint32_t CascadedShadowMap::render(uint64_t casterGeneration,
+                                   const std::function<void(const Mat4&, uint32_t)>& drawCasters) {
+  uint32_t renderCount{0};
+  for (uint32_t c = 0;c<cascadeCount;++c) {
+    if (rendered[c] && casterGeneration == renderedGeneration &&
+        std::memcmp(static_cast<const float*>(viewProjections[c]),
+                    static_cast<const float*>(renderedViewProjections[c]), 16*sizeof(float)) == 0) {
+      cascadeReuses++;
+      continue;
+    }
+
+    TRACE_SCOPE("shadow cascade");
+    framebuffer.bind(texture, c);
+    GL(glClear(GL_DEPTH_BUFFER_BIT));
+    drawCasters(viewProjections[c], c);
+    renderedViewProjections[c] = viewProjections[c];
+    rendered[c] = true;
+    cascadeRenders++;
+    renderCount++;
+  }
+  renderedGeneration = casterGeneration;
+  if (renderCount > 0) framebuffer.unbind2D();
+  return renderCount;
+}
+
+Vec4 CascadedShadowMap::getSplits() const {
+  Vec4 result;
+  for (uint32_t c = 0;c<maxCascades;++c) result.e[c] = splits[std::min(c, cascadeCount-1)];
+  return result;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "GLFramebuffer.h"
+#include "GLDepthTextureArray.h"
+#include "Mat4.h"
+#include "Vec3.h"
+#include "Vec4.h"
+
+/**
+ * @file CascadedShadowMap.h
+ * @brief Cascaded shadow maps for a directional light.
+ *
+ * The camera frustum is cut into 2–4 depth ranges ("cascades"), each covered
+ * by its own orthographic shadow map in one layer of a
+ * @ref GLDepthTextureArray. Near cascades cover a small area, so nearby
+ * geometry gets many texels, while far cascades spend the same texel count
+ * on a large area. Four 1024² cascades cost the same fill rate as one 2048²
+ * map but resolve close-up shadows several times finer.
+ *
+ * Split distances blend a logarithmic and a uniform distribution
+ * (@ref setSplitLambda()). Each cascade is fitted to the bounding sphere of
+ * its frustum slice, whose size does not change when the camera rotates,
+ * and the projection is snapped to whole shadow texels, so shadow edges do
+ * not shimmer while the camera moves. Like @ref ShadowMapCache, a cascade is
+ * only re-rendered when its projection or the caster generation changed.
+ *
+ * Shaders select the cascade by view-space depth:
+ * @code
+ * uniform sampler2DArrayShadow shadowMaps;
+ * uniform mat4 worldToShadow[4];   // getWorldToShadow()
+ * uniform vec4 cascadeSplits;      // getSplits(), unused entries are ignored
+ * uniform int cascadeCount;
+ *
+ * int c = 0;
+ * while (c < cascadeCount-1 && viewDepth > cascadeSplits[c]) c++;
+ * vec4 p = worldToShadow[c] * vec4(worldPos, 1.0);
+ * float lit = texture(shadowMaps, vec4(p.xy, float(c), p.z - bias));
+ * @endcode
+ */
+class CascadedShadowMap {
+public:
+  /** @brief Maximum number of cascades. */
+  static constexpr uint32_t maxCascades = 4;
+
+  /**
+   * @brief Allocate the cascade layers.
+   * @param resolution   Width and height of each cascade in texels.
+   * @param cascadeCount Number of cascades, clamped to 2..@ref maxCascades.
+   */
+  CascadedShadowMap(uint32_t resolution, uint32_t cascadeCount=4);
+
+  /**
+   * @brief Blend between uniform (0) and logarithmic (1) split distances.
+   *
+   * Logarithmic splits match the perspective distribution of screen pixels
+   * but give the near cascade a tiny range; the default of 0.75 is the usual
+   * compromise.
+   */
+  void setSplitLambda(float lambda) {splitLambda = lambda;}
+  float getSplitLambda() const {return splitLambda;}
+
+  /**
+   * @brief Extend every cascade towards the light by @p distance, so that
+   *        casters outside the camera frustum still cast into it.
+   */
+  void setCasterDistance(float distance) {casterDistance = distance;}
+  float getCasterDistance() const {return casterDistance;}
+
+  /**
+   * @brief Fit the cascades to the camera.
+   * @param view           World-to-view matrix of the camera.
+   * @param fovY           Vertical field of view in degrees.
+   * @param aspect         Aspect ratio of the camera.
+   * @param zNear          Camera near plane.
+   * @param shadowDistance Far end of the last cascade, usually much closer
+   *                       than the camera's far plane.
+   * @param lightDirection World-space direction the light travels in.
+   */
+  void fit(const Mat4& view, float fovY, float aspect, float zNear,
+           float shadowDistance, const Vec3& lightDirection);
+
+  /**
+   * @brief Render the cascades whose projection or casters changed.
+   *
+   * @p drawCasters is called once per cascade that needs an update, with the
+   * cascade's layer bound, cleared, and the viewport set; it issues the
+   * depth-only draw calls with the given light view-projection. Afterwards
+   * the default framebuffer is bound again; the viewport is left at the
+   * cascade size.
+   * @param casterGeneration Changes whenever a shadow caster changed.
+   * @param drawCasters      Draws the casters for one cascade.
+   * @return Number of cascades rendered.
+   */
+  uint32_t render(uint64_t casterGeneration,
+                  const std::function<void(const Mat4& lightViewProjection, uint32_t cascade)>& drawCasters);
+
+  /** @brief Depth texture array with one layer per cascade. */
+  const GLDepthTextureArray& getTexture() const {return texture;}
+  uint32_t getCascadeCount() const {return cascadeCount;}
+  /** @brief View-space distances of the cascades' far ends (positive, padded with the last). */
+  Vec4 getSplits() const;
+  /** @brief Light view-projection of each cascade. */
+  const std::vector<Mat4>& getViewProjections() const {return viewProjections;}
+  /** @brief World-to-shadow-texture matrices (xy: texture coordinates, z: depth in [0,1]). */
+  const std::vector<Mat4>& getWorldToShadow() const {return worldToShadow;}
+
+  /** @name Statistics */
+  ///@{
+  /** @brief Cascade renders since construction. */
+  uint64_t getCascadeRenders() const {return cascadeRenders;}
+  /** @brief Cascades reused because neither projection nor casters changed. */
+  uint64_t getCascadeReuses() const {return cascadeReuses;}
+  ///@}
+
+private:
+  uint32_t resolution;
+  uint32_t cascadeCount;
+  float splitLambda{0.75f};
+  float casterDistance{200.0f};
+
+  GLDepthTextureArray texture;
+  GLFramebuffer framebuffer;
+
+  std::array<float, maxCascades> splits{};
+  std::vector<Mat4> viewProjections;
+  std::vector<Mat4> worldToShadow;
+
+  std::vector<Mat4> renderedViewProjections;
+  std::vector<bool> rendered;
+  uint64_t renderedGeneration{0};
+
+  uint64_t cascadeRenders{0};
+  uint64_t cascadeReuses{0};
+};
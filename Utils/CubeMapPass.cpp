@@ -0,0 +1,142 @@
+#include <cmath>
+#include <sstream>
+
+#include "CubeMapPass.h"
+#include "Trace.h"
+
+CubeMapPass::CubeMapPass(float zNear, float zFar) :
+  zNear(zNear),
+  zFar(zFar),
+  center{0,0,0},
+  projection(Mat4::perspective(90.0f, 1.0f, zNear, zFar)),
+  faceViewProjections(6)
+{
+  setCenter(center);
+}
+
+void CubeMapPass::setCenter(const Vec3& center) {
+  this->center = center;
+  for (uint32_t face = 0;face<6;++face)
+    faceViewProjections[face] = projection * faceView(Face(face), center);
+}
+
+Mat4 CubeMapPass::faceView(Face face, const Vec3& center) {
+  // GL samples +X/-X/+Z/-Z with -Y as up and the Y faces with ±Z as up
+  switch (face) {
+    case Face::POSX: return Mat4::lookAt(center, center + Vec3{ 1, 0, 0}, {0,-1, 0});
+    case Face::NEGX: return Mat4::lookAt(center, center + Vec3{-1, 0, 0}, {0,-1, 0});
+    case Face::POSY: return Mat4::lookAt(center, center + Vec3{ 0, 1, 0}, {0, 0, 1});
+    case Face::NEGY: return Mat4::lookAt(center, center + Vec3{ 0,-1, 0}, {0, 0,-1});
+    case Face::POSZ: return Mat4::lookAt(center, center + Vec3{ 0, 0, 1}, {0,-1, 0});
+    case Face::NEGZ: return Mat4::lookAt(center, center + Vec3{ 0, 0,-1}, {0,-1, 0});
+  }
+  return {};
+}
+
+uint32_t CubeMapPass::getFaceMask(const Vec3& boundsCenter, float radius) const {
+  const Vec3 p = boundsCenter - center;
+  const float c[3] = {p.x, p.y, p.z};
+  // the side planes of a 90° frustum are tilted by 45°, so a sphere touches
+  // the face if depth - |lateral| >= -radius * sqrt(2) on both lateral axes
+  const float slack = radius * 1.41421356f;
+  uint32_t mask{0};
+  for (uint32_t face = 0;face<6;++face) {
+    const uint32_t axis = face / 2;
+    const float depth = (face % 2 == 0) ? c[axis] : -c[axis];
+    if (depth + radius < zNear || depth - radius > zFar) continue;
+    if (depth - std::fabs(c[(axis+1)%3]) < -slack) continue;
+    if (depth - std::fabs(c[(axis+2)%3]) < -slack) continue;
+    mask |= 1u << face;
+  }
+  return mask;
+}
+
+void CubeMapPass::setUniforms(const GLProgram& program) const {
+  program.setUniform(program.getUniformLocation("faceViewProjection"), faceViewProjections);
+  program.setUniform("faceMask", 0x3f);
+}
+
+std::string CubeMapPass::layeredGeometryShader(const std::vector<std::pair<std::string, std::string>>& varyings) {
+  std::stringstream s;
+  s << "#version 410 core\n"
+       "layout(triangles) in;\n"
+       "layout(triangle_strip, max_vertices=18) out;\n\n"
+       "uniform mat4 faceViewProjection[6];\n"
+       "uniform int faceMask;\n\n"
+       "in vec3 worldPositionVertex[];\n";
+  for (const auto& [type, name] : varyings) {
+    if (name != "worldPosition") s << "in " << type << " " << name << "Vertex[];\n";
+    s << "out " << type << " " << name << ";\n";
+  }
+  s << "\n"
+       "bool outside(vec3 a, vec3 w) {\n"
+       "  return all(greaterThan(a, w));\n"
+       "}\n\n"
+       "void main() {\n"
+       "  for (int face = 0; face < 6; ++face) {\n"
+       "    if ((faceMask & (1 << face)) == 0) continue;\n"
+       "    vec4 p0 = faceViewProjection[face] * vec4(worldPositionVertex[0], 1.0);\n"
+       "    vec4 p1 = faceViewProjection[face] * vec4(worldPositionVertex[1], 1.0);\n"
+       "    vec4 p2 = faceViewProjection[face] * vec4(worldPositionVertex[2], 1.0);\n"
+       "    vec3 w = vec3(p0.w, p1.w, p2.w);\n"
+       "    vec3 x = vec3(p0.x, p1.x, p2.x);\n"
+       "    vec3 y = vec3(p0.y, p1.y, p2.y);\n"
+       "    vec3 z = vec3(p0.z, p1.z, p2.z);\n"
+       "    // skip the face if all three vertices are beyond one of its clip planes\n"
+       "    if (outside(x, w) || outside(-x, w) || outside(y, w) || outside(-y, w) ||\n"
+       "        outside(z, w) || outside(-z, w)) continue;\n"
+       "    vec4 p[3] = vec4[3](p0, p1, p2);\n"
+       "    for (int i = 0; i < 3; ++i) {\n"
+       "      gl_Layer = face;\n"
+       "      gl_Position = p[i];\n";
+  for (const auto& [type, name] : varyings)
+    s << "      " << name << " = " << name << "Vertex[i];\n";
+  s << "      EmitVertex();\n"
+       "    }\n"
+       "    EndPrimitive();\n"
+       "  }\n"
+       "}\n";
+  return s.str();
+}
+
+#ifndef __EMSCRIPTEN__
+void CubeMapPass::renderLayered(GLFramebuffer& framebuffer, const GLTextureCube& color,
+                                const GLDepthTextureCube& depth, const std::function<void()>& draw) const {
+  TRACE_SCOPE("cube map (layered)");
+  framebuffer.bind(color, depth);
+  GL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+  draw();
+  framebuffer.unbind2D();
+}
+
+void CubeMapPass::renderLayered(GLFramebuffer& framebuffer, const GLDepthTextureCube& depth,
+                                const std::function<void()>& draw) const {
+  TRACE_SCOPE("cube depth (layered)");
+  framebuffer.bind(depth);
+  GL(glClear(GL_DEPTH_BUFFER_BIT));
+  draw();
+  framebuffer.unbind2D();
+}
+#endif
+
+void CubeMapPass::renderFaces(GLFramebuffer& framebuffer, const GLTextureCube& color, const GLDepthBuffer& depth,
+                              const std::function<void(Face face, const Mat4& viewProjection)>& draw) const {
+  TRACE_SCOPE("cube map (per face)");
+  for (uint32_t face = 0;face<6;++face) {
+    framebuffer.bind(color, Face(face), depth);
+    GL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+    draw(Face(face), faceViewProjections[face]);
+  }
+  framebuffer.unbind2D();
+}
+
+void CubeMapPass::renderFaces(GLFramebuffer& framebuffer, const GLDepthTextureCube& depth,
+                              const std::function<void(Face face, const Mat4& viewProjection)>& draw) const {
+  TRACE_SCOPE("cube depth (per face)");
+  for (uint32_t face = 0;face<6;++face) {
+    framebuffer.bind(depth, Face(face));
+    GL(glClear(GL_DEPTH_BUFFER_BIT));
+    draw(Face(face), faceViewProjections[face]);
+  }
+  framebuffer.unbind2D();
+}
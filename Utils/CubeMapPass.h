@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "GLFramebuffer.h"
+#include "GLProgram.h"
+#include "GLTextureCube.h"
+#include "GLDepthTextureCube.h"
+#include "GLDepthBuffer.h"
+#include "Mat4.h"
+#include "Vec3.h"
+
+/**
+ * @file CubeMapPass.h
+ * @brief Render a scene into all six faces of a cube map, e.g. for dynamic
+ *        reflection probes and omnidirectional shadows.
+ *
+ * The pass holds the six 90° face cameras around a center. On desktop GL the
+ * faces are filled in one layered pass (@ref renderLayered()): the whole cube
+ * is attached once and every object is drawn once; a geometry shader
+ * (@ref layeredGeometryShader()) emits each triangle to the faces it can
+ * touch by writing \c gl_Layer. Culling happens twice: per object on the CPU
+ * with @ref getFaceMask(), which is passed to the shader as \c faceMask, and
+ * per triangle in the geometry shader against the face's clip volume. An
+ * object near the center of a probe is thus submitted once instead of six
+ * times, and the GPU only rasterizes the faces its triangles overlap.
+ *
+ * WebGL has no geometry shaders, so under Emscripten only the per-face
+ * fallback (@ref renderFaces()) is available; it re-attaches one face at a
+ * time and expects the caller to skip objects whose face mask lacks the face.
+ *
+ * A layered vertex shader writes the world-space position and the varyings;
+ * the fragment shader is the same as for a regular pass:
+ * @code
+ * // vertex shader                         // geometry shader (generated)
+ * out vec3 worldPositionVertex;            //   in  vec3 normalVertex[];
+ * out vec3 normalVertex;                   //   out vec3 normal;
+ * void main() {
+ *   worldPositionVertex = (M * vec4(vPos, 1.0)).xyz;
+ *   normalVertex = mat3(M) * vNormal;
+ * }
+ *
+ * auto program = GLProgram::createFromString(vs, fs,
+ *   CubeMapPass::layeredGeometryShader({{"vec3", "normal"}}));
+ * probe.renderLayered(framebuffer, cube, depthCube, [&]() {
+ *   probe.setUniforms(program);
+ *   for (auto& o : objects) {
+ *     program.setUniform("faceMask", int(probe.getFaceMask(o.center, o.radius)));
+ *     o.draw();
+ *   }
+ * });
+ * @endcode
+ */
+class CubeMapPass {
+public:
+  /**
+   * @brief Set up the face cameras at the origin.
+   * @param zNear Near plane distance of the face cameras.
+   * @param zFar  Far plane distance of the face cameras.
+   */
+  CubeMapPass(float zNear=0.1f, float zFar=1000.0f);
+
+  /** @brief Move the face cameras to @p center (the probe or light position). */
+  void setCenter(const Vec3& center);
+  const Vec3& getCenter() const {return center;}
+  float getNear() const {return zNear;}
+  float getFar() const {return zFar;}
+
+  /** @brief View matrix of @p face for a cube centered at @p center (GL cube map orientation). */
+  static Mat4 faceView(Face face, const Vec3& center);
+  /** @brief 90° projection shared by all faces. */
+  const Mat4& getProjection() const {return projection;}
+  /** @brief View-projection of each face, indexed by ::Face. */
+  const std::vector<Mat4>& getFaceViewProjections() const {return faceViewProjections;}
+
+  /**
+   * @brief Faces a bounding sphere can touch.
+   * @param boundsCenter World-space center of the object's bounding sphere.
+   * @param radius       Radius of the bounding sphere.
+   * @return Bit i is set if the sphere may overlap the frustum of ::Face i.
+   */
+  uint32_t getFaceMask(const Vec3& boundsCenter, float radius) const;
+
+  /** @brief Upload \c faceViewProjection[6] and a full \c faceMask to a layered program. */
+  void setUniforms(const GLProgram& program) const;
+
+  /**
+   * @brief Geometry shader routing triangles to cube faces.
+   *
+   * Reads \c worldPositionVertex and \c <name>Vertex for each of
+   * @p varyings (GLSL type, name) from the vertex shader and writes
+   * \c <name> to the fragment shader, once per face that is enabled in the
+   * \c faceMask uniform and whose clip volume the triangle overlaps.
+   */
+  static std::string layeredGeometryShader(const std::vector<std::pair<std::string, std::string>>& varyings={});
+
+#ifndef __EMSCRIPTEN__
+  /**
+   * @brief Render color and depth of all faces in one layered pass.
+   *
+   * Binds all faces of @p color and @p depth (same size), clears them, and
+   * calls @p draw once. Afterwards the default framebuffer is bound again.
+   */
+  void renderLayered(GLFramebuffer& framebuffer, const GLTextureCube& color,
+                     const GLDepthTextureCube& depth, const std::function<void()>& draw) const;
+  /** @brief Render the depth of all faces in one layered pass (omnidirectional shadows). */
+  void renderLayered(GLFramebuffer& framebuffer, const GLDepthTextureCube& depth,
+                     const std::function<void()>& draw) const;
+#endif
+
+  /**
+   * @brief Render the faces one at a time.
+   *
+   * For each face, binds it together with @p depth (a renderbuffer of the
+   * face size), clears both, and calls @p draw with the face and its
+   * view-projection. Afterwards the default framebuffer is bound again.
+   */
+  void renderFaces(GLFramebuffer& framebuffer, const GLTextureCube& color, const GLDepthBuffer& depth,
+                   const std::function<void(Face face, const Mat4& viewProjection)>& draw) const;
+  /** @brief Render the depth of the faces one at a time. */
+  void renderFaces(GLFramebuffer& framebuffer, const GLDepthTextureCube& depth,
+                   const std::function<void(Face face, const Mat4& viewProjection)>& draw) const;
+
+private:
+  float zNear;
+  float zFar;
+  Vec3 center;
+  Mat4 projection;
+  std::vector<Mat4> faceViewProjections;
+};
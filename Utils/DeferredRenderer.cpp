@@ -0,0 +1,280 @@
+#include <array>
+#include <algorithm>
+#include <cmath>
+
+#include "DeferredRenderer.h"
+#include "GLProgramVariants.h"
+#include "Trace.h"
+
+/** Width of the 2D texture holding the concatenated tile light lists. */
+static const uint32_t indexTextureWidth = 2048;
+
+static const std::string octahedralFunctions = R"(
+vec2 signNotZero(vec2 v) {
+  return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 octEncode(vec3 n) {
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+  return e * 0.5 + 0.5;
+}
+
+vec3 octDecode(vec2 e) {
+  e = e * 2.0 - 1.0;
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+  return normalize(n);
+}
+
+// two 12 bit values in three 8 bit channels
+vec3 packOct12(vec2 e) {
+  uvec2 q = uvec2(clamp(e, 0.0, 1.0) * 4095.0 + 0.5);
+  return vec3(float(q.x >> 4u), float(((q.x & 15u) << 4u) | (q.y >> 8u)), float(q.y & 255u)) / 255.0;
+}
+
+vec2 unpackOct12(vec3 p) {
+  uvec3 b = uvec3(p * 255.0 + 0.5);
+  return vec2(float((b.x << 4u) | (b.y >> 4u)), float(((b.y & 15u) << 8u) | b.z)) / 4095.0;
+}
+)";
+
+static const std::string lightingVertexShader = R"(
+void main() {
+  // one triangle covering the screen
+  vec2 p = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID >> 1) * 4 - 1));
+  gl_Position = vec4(p, 0.0, 1.0);
+}
+)";
+
+static const std::string lightingFragmentShader = R"(
+uniform sampler2D albedoSpecular;
+uniform sampler2D normalShininess;
+uniform sampler2D depthTexture;
+uniform sampler2D lightData;
+uniform sampler2D tileHeaders;
+uniform sampler2D lightIndices;
+uniform mat4 inverseProjection;
+uniform vec3 ambient;
+uniform int tileSize;
+uniform int indexWidth;
+
+out vec4 fragColor;
+
+void main() {
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  float depth = texelFetch(depthTexture, pixel, 0).r;
+  if (depth >= 1.0) discard;
+
+  vec4 albedoSpec = texelFetch(albedoSpecular, pixel, 0);
+  vec4 normalShin = texelFetch(normalShininess, pixel, 0);
+  vec3 n = octDecode(unpackOct12(normalShin.rgb));
+  float shininess = exp2(normalShin.a * 10.0);
+
+  vec2 ndc = (vec2(pixel) + 0.5) / vec2(textureSize(depthTexture, 0)) * 2.0 - 1.0;
+  vec4 p = inverseProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+  vec3 position = p.xyz / p.w;
+  vec3 v = normalize(-position);
+
+  vec3 color = ambient * albedoSpec.rgb;
+  vec2 header = texelFetch(tileHeaders, pixel / tileSize, 0).rg;
+  int first = int(header.x);
+  int count = int(header.y);
+  for (int i = first; i < first + count; ++i) {
+    int light = int(texelFetch(lightIndices, ivec2(i % indexWidth, i / indexWidth), 0).r);
+    vec4 positionRadius = texelFetch(lightData, ivec2(0, light), 0);
+    vec3 lightColor = texelFetch(lightData, ivec2(1, light), 0).rgb;
+
+    vec3 l = positionRadius.xyz - position;
+    float distance2 = dot(l, l);
+    float radius2 = positionRadius.w * positionRadius.w;
+    if (distance2 >= radius2) continue;
+    l *= inversesqrt(distance2);
+
+    float falloff = 1.0 - distance2 / radius2;
+    falloff *= falloff;
+    float diffuse = max(dot(n, l), 0.0);
+    float specular = diffuse > 0.0 ? pow(max(dot(n, normalize(l + v)), 0.0), shininess) : 0.0;
+    color += falloff * lightColor * (diffuse * albedoSpec.rgb + specular * albedoSpec.a);
+  }
+  fragColor = vec4(color, 1.0);
+}
+)";
+
+DeferredRenderer::DeferredRenderer(uint32_t width, uint32_t height) :
+  width(0),
+  height(0),
+  depth(GL_NEAREST, GL_NEAREST),
+  lightingProgram(GLProgram::createFromStrings(
+    {GLProgramVariants::versionHeader(), lightingVertexShader},
+    {GLProgramVariants::versionHeader(), octahedralFunctions, lightingFragmentShader}))
+{
+  depth.setCompare(false);
+  albedoSpecular.setLabel("G-buffer albedo/specular");
+  normalShininess.setLabel("G-buffer normal/shininess");
+  depth.setLabel("G-buffer depth");
+  framebuffer.setLabel("G-buffer");
+  resize(width, height);
+}
+
+void DeferredRenderer::resize(uint32_t width, uint32_t height) {
+  if (width == this->width && height == this->height) return;
+  this->width = width;
+  this->height = height;
+  tilesX = (width + tileSize - 1) / tileSize;
+  tilesY = (height + tileSize - 1) / tileSize;
+
+  albedoSpecular.setEmpty(width, height, 4);
+  normalShininess.setEmpty(width, height, 4);
+  depth.setEmpty(width, height, GLDepthDataType::DEPTH24);
+}
+
+std::string DeferredRenderer::gBufferShaderFunctions() {
+  return octahedralFunctions + R"(
+layout(location = 0) out vec4 gAlbedoSpecular;
+layout(location = 1) out vec4 gNormalShininess;
+
+void writeGBuffer(vec3 albedo, float specular, vec3 viewNormal, float shininess) {
+  gAlbedoSpecular = vec4(albedo, specular);
+  gNormalShininess = vec4(packOct12(octEncode(viewNormal)), clamp(log2(shininess) / 10.0, 0.0, 1.0));
+}
+)";
+}
+
+void DeferredRenderer::beginGeometryPass() {
+  framebuffer.bind(albedoSpecular, normalShininess, depth);
+  const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  const GLfloat farDepth[1] = {1.0f};
+  GL(glClearBufferfv(GL_COLOR, 0, zero));
+  GL(glClearBufferfv(GL_COLOR, 1, zero));
+  GL(glClearBufferfv(GL_DEPTH, 0, farDepth));
+  GL(glEnable(GL_DEPTH_TEST));
+}
+
+void DeferredRenderer::endGeometryPass() {
+  framebuffer.unbind2D();
+}
+
+void DeferredRenderer::setLights(const std::vector<PointLight>& lights) {
+  this->lights.assign(lights.begin(), lights.begin() + std::min<size_t>(lights.size(), maxLights));
+}
+
+void DeferredRenderer::cullLights(const Mat4& view, const Mat4& projection) {
+  TRACE_SCOPE("DeferredRenderer::cullLights");
+  const uint32_t tileCount = tilesX * tilesY;
+  std::vector<std::array<uint32_t, 4>> lightTiles;
+  lightTiles.reserve(lights.size());
+  lightDataBuffer.assign(std::max<size_t>(lights.size(), 1) * 8, 0.0f);
+  tileLightCounts.assign(tileCount, 0);
+  visibleLights = 0;
+
+  for (size_t i = 0;i<lights.size();++i) {
+    const PointLight& light = lights[i];
+    const Vec3 center = view * light.position;
+    const float r = light.radius;
+    lightDataBuffer[i*8+0] = center.x;
+    lightDataBuffer[i*8+1] = center.y;
+    lightDataBuffer[i*8+2] = center.z;
+    lightDataBuffer[i*8+3] = r;
+    lightDataBuffer[i*8+4] = light.color.r;
+    lightDataBuffer[i*8+5] = light.color.g;
+    lightDataBuffer[i*8+6] = light.color.b;
+
+    // screen rectangle of the sphere's view-space bounding box
+    Vec3 minNDC{1.0f, 1.0f, 1.0f};
+    Vec3 maxNDC{-1.0f, -1.0f, -1.0f};
+    bool crossesEye = false;
+    bool outside[6] = {true, true, true, true, true, true};
+    for (uint32_t c = 0;c<8;++c) {
+      const Vec4 corner{center.x + ((c & 1) ? r : -r), center.y + ((c & 2) ? r : -r),
+                        center.z + ((c & 4) ? r : -r), 1.0f};
+      const Vec4 clip = projection * corner;
+      outside[0] = outside[0] && clip.x < -clip.w;
+      outside[1] = outside[1] && clip.x >  clip.w;
+      outside[2] = outside[2] && clip.y < -clip.w;
+      outside[3] = outside[3] && clip.y >  clip.w;
+      outside[4] = outside[4] && clip.z < -clip.w;
+      outside[5] = outside[5] && clip.z >  clip.w;
+      if (clip.w <= 1e-5f) {
+        crossesEye = true;
+        continue;
+      }
+      const Vec3 ndc{clip.x / clip.w, clip.y / clip.w, clip.z / clip.w};
+      minNDC = Vec3::minV(minNDC, ndc);
+      maxNDC = Vec3::maxV(maxNDC, ndc);
+    }
+    if (std::find(std::begin(outside), std::end(outside), true) != std::end(outside)) {
+      // outside the frustum: an empty tile rectangle
+      lightTiles.push_back({1, 0, 1, 0});
+      continue;
+    }
+    if (crossesEye) {
+      minNDC = Vec3{-1.0f, -1.0f, -1.0f};
+      maxNDC = Vec3{1.0f, 1.0f, 1.0f};
+    }
+
+    const auto toTile = [](float ndc, uint32_t pixels, uint32_t tiles) {
+      const float pixel = (std::clamp(ndc, -1.0f, 1.0f) * 0.5f + 0.5f) * float(pixels);
+      return std::min(uint32_t(pixel) / tileSize, tiles - 1);
+    };
+    const std::array<uint32_t, 4> rect{toTile(minNDC.x, width, tilesX), toTile(maxNDC.x, width, tilesX),
+                                       toTile(minNDC.y, height, tilesY), toTile(maxNDC.y, height, tilesY)};
+    lightTiles.push_back(rect);
+    for (uint32_t y = rect[2];y<=rect[3];++y)
+      for (uint32_t x = rect[0];x<=rect[1];++x)
+        tileLightCounts[y*tilesX + x]++;
+    visibleLights++;
+  }
+
+  // counts to offsets, then scatter the light indices into their tiles
+  tileHeaderBuffer.resize(tileCount * 2);
+  uint32_t total = 0;
+  maxLightsPerTile = 0;
+  for (uint32_t t = 0;t<tileCount;++t) {
+    tileHeaderBuffer[t*2+0] = float(total);
+    tileHeaderBuffer[t*2+1] = float(tileLightCounts[t]);
+    maxLightsPerTile = std::max(maxLightsPerTile, tileLightCounts[t]);
+    total += tileLightCounts[t];
+    tileLightCounts[t] = 0;
+  }
+  const uint32_t rows = std::max<uint32_t>((total + indexTextureWidth - 1) / indexTextureWidth, 1);
+  tileLightIndices.assign(size_t(rows) * indexTextureWidth, 0.0f);
+  for (uint32_t i = 0;i<lightTiles.size();++i) {
+    const std::array<uint32_t, 4>& rect = lightTiles[i];
+    for (uint32_t y = rect[2];y<=rect[3];++y) {
+      for (uint32_t x = rect[0];x<=rect[1];++x) {
+        const uint32_t t = y*tilesX + x;
+        tileLightIndices[uint32_t(tileHeaderBuffer[t*2]) + tileLightCounts[t]++] = float(i);
+      }
+    }
+  }
+
+  lightData.setData(lightDataBuffer, 2, uint32_t(lightDataBuffer.size() / 8), 4);
+  tileHeaders.setData(tileHeaderBuffer, tilesX, tilesY, 2);
+  lightIndices.setData(tileLightIndices, indexTextureWidth, rows, 1);
+  tileLightIndices.resize(total);
+}
+
+void DeferredRenderer::shade(const Mat4& view, const Mat4& projection) {
+  TRACE_SCOPE("DeferredRenderer::shade");
+  cullLights(view, projection);
+
+  const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  GL(glDisable(GL_DEPTH_TEST));
+
+  lightingProgram.enable();
+  lightingProgram.setTexture("albedoSpecular", albedoSpecular, 0);
+  lightingProgram.setTexture("normalShininess", normalShininess, 1);
+  lightingProgram.setTexture("depthTexture", depth, 2);
+  lightingProgram.setTexture("lightData", lightData, 3);
+  lightingProgram.setTexture("tileHeaders", tileHeaders, 4);
+  lightingProgram.setTexture("lightIndices", lightIndices, 5);
+  lightingProgram.setUniform("inverseProjection", Mat4::inverse(projection));
+  lightingProgram.setUniform("ambient", ambient);
+  lightingProgram.setUniform("tileSize", int(tileSize));
+  lightingProgram.setUniform("indexWidth", int(indexTextureWidth));
+  emptyArray.bind();
+  GL(glDrawArrays(GL_TRIANGLES, 0, 3));
+
+  if (depthTest) GL(glEnable(GL_DEPTH_TEST));
+}
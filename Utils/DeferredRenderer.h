@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GLArray.h"
+#include "GLFramebuffer.h"
+#include "GLProgram.h"
+#include "GLTexture2D.h"
+#include "GLDepthTexture.h"
+#include "Mat4.h"
+#include "Vec3.h"
+
+/**
+ * @file DeferredRenderer.h
+ * @brief Deferred shading with tiled light culling for many point lights.
+ *
+ * Forward shading evaluates every light for every fragment of every object,
+ * including fragments that are later overdrawn. The deferred path splits
+ * the frame in two:
+ *
+ * 1. **Geometry pass** – objects write their surface attributes into a
+ *    packed G-buffer (two RGBA8 targets plus depth):
+ *    - albedo (rgb) and specular intensity (a),
+ *    - the view-space normal, octahedron-encoded into 2×12 bits (rgb), and
+ *      the log2 of the shininess (a).
+ *    Positions are not stored but reconstructed from depth.
+ * 2. **Lighting pass** – one full-screen triangle shades each pixel once.
+ *    The screen is cut into @ref tileSize² pixel tiles; on the CPU each
+ *    light's bounding sphere is projected to the screen and the light is
+ *    appended to the lists of the tiles it covers. A pixel only evaluates
+ *    the lights in its tile's list.
+ *
+ * Lighting cost thus depends on the number of pixels and lights per tile,
+ * not on the scene's object count or overdraw, and hundreds of small lights
+ * are affordable.
+ *
+ * Geometry-pass fragment shaders include @ref gBufferShaderFunctions()
+ * after the version header and call \c writeGBuffer():
+ * @code
+ * auto program = GLProgram::createFromStrings({vs},
+ *   {GLProgramVariants::versionHeader(), DeferredRenderer::gBufferShaderFunctions(), fs});
+ * // fs: void main() { writeGBuffer(albedo, 0.5, normalize(viewNormal), 64.0); }
+ *
+ * deferred.beginGeometryPass();
+ * scene.draw();
+ * deferred.endGeometryPass();
+ * deferred.setLights(lights);
+ * deferred.shade(view, projection);   // into the currently bound framebuffer
+ * @endcode
+ */
+class DeferredRenderer {
+public:
+  /** @brief Edge length of a light-culling tile in pixels. */
+  static const uint32_t tileSize = 16;
+  /** @brief Maximum number of lights passed to @ref setLights(). */
+  static const uint32_t maxLights = 1024;
+
+  /** @brief A point light with a finite range. */
+  struct PointLight {
+    Vec3 position;  ///< World-space position.
+    float radius;   ///< Distance at which the light's contribution reaches zero.
+    Vec3 color;     ///< Color times intensity.
+  };
+
+  /** @brief Allocate a G-buffer of the given size. */
+  DeferredRenderer(uint32_t width, uint32_t height);
+
+  /** @brief Re-allocate the G-buffer, e.g. after the window was resized. */
+  void resize(uint32_t width, uint32_t height);
+  uint32_t getWidth() const {return width;}
+  uint32_t getHeight() const {return height;}
+
+  /**
+   * @brief GLSL declaring the G-buffer outputs and \c writeGBuffer().
+   *
+   * \c void writeGBuffer(vec3 albedo, float specular, vec3 viewNormal, float shininess)
+   * stores one fragment; \c viewNormal must be normalized, \c shininess is
+   * the Blinn-Phong exponent in [1, 1024].
+   */
+  static std::string gBufferShaderFunctions();
+
+  /** @brief Bind and clear the G-buffer and enable depth testing. */
+  void beginGeometryPass();
+  /** @brief Bind the default framebuffer again. */
+  void endGeometryPass();
+
+  /** @brief Set the lights for @ref shade(); at most @ref maxLights are used. */
+  void setLights(const std::vector<PointLight>& lights);
+  const std::vector<PointLight>& getLights() const {return lights;}
+  /** @brief Light added to every pixel, scaled by its albedo. */
+  void setAmbient(const Vec3& ambient) {this->ambient = ambient;}
+  const Vec3& getAmbient() const {return ambient;}
+
+  /**
+   * @brief Cull the lights into tiles and run the lighting pass.
+   *
+   * Shades the G-buffer into the currently bound framebuffer, whose
+   * viewport must match the G-buffer size. Depth testing is disabled during
+   * the pass and restored afterwards.
+   * @param view       World-to-view matrix used in the geometry pass.
+   * @param projection Projection matrix used in the geometry pass.
+   */
+  void shade(const Mat4& view, const Mat4& projection);
+
+  /** @name G-buffer */
+  ///@{
+  const GLTexture2D& getAlbedoSpecular() const {return albedoSpecular;}
+  const GLTexture2D& getNormalShininess() const {return normalShininess;}
+  const GLDepthTexture& getDepth() const {return depth;}
+  ///@}
+
+  /** @name Statistics of the last @ref shade() */
+  ///@{
+  /** @brief Lights that overlapped the view frustum. */
+  uint32_t getVisibleLights() const {return visibleLights;}
+  /** @brief Sum of all tile light list lengths. */
+  uint32_t getTileLightEntries() const {return uint32_t(tileLightIndices.size());}
+  /** @brief Length of the longest tile light list. */
+  uint32_t getMaxLightsPerTile() const {return maxLightsPerTile;}
+  ///@}
+
+private:
+  uint32_t width;
+  uint32_t height;
+  uint32_t tilesX{0};
+  uint32_t tilesY{0};
+
+  GLTexture2D albedoSpecular;
+  GLTexture2D normalShininess;
+  GLDepthTexture depth;
+  GLFramebuffer framebuffer;
+
+  std::vector<PointLight> lights;
+  Vec3 ambient{0.05f, 0.05f, 0.05f};
+
+  GLProgram lightingProgram;
+  GLArray emptyArray;
+  GLTexture2D lightData;
+  GLTexture2D tileHeaders;
+  GLTexture2D lightIndices;
+
+  std::vector<GLfloat> lightDataBuffer;
+  std::vector<GLfloat> tileHeaderBuffer;
+  std::vector<uint32_t> tileLightCounts;
+  std::vector<GLfloat> tileLightIndices;
+
+  uint32_t visibleLights{0};
+  uint32_t maxLightsPerTile{0};
+
+  /** @brief Build the per-tile light lists and upload them. */
+  void cullLights(const Mat4& view, const Mat4& projection);
+};
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cmath>
+
+#include "DynamicResolution.h"
+#include "GLApp.h"
+#include "GLProgramVariants.h"
+#include "Trace.h"
+
+/** Fraction of the budget a scale change aims for. */
+static const double targetLoad = 0.9;
+/** The scale only rises while the time is below this fraction of the budget... */
+static const double raiseThreshold = 0.8;
+/** ...for this many consecutive measurements. */
+static const uint32_t raiseDelay = 30;
+/** Largest increase of the scale per step. */
+static const float maxRaiseStep = 0.1f;
+/** Measurements at a new scale before the controller reacts again. */
+static const uint32_t minSamples = 3;
+/** Weight of a new measurement in the smoothed time. */
+static const double smoothing = 0.25;
+/** Scales are multiples of 1/scaleSteps. */
+static const float scaleSteps = 64.0f;
+
+static const std::string upscaleVertexShader = R"(
+void main() {
+  // one triangle covering the screen
+  vec2 p = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID >> 1) * 4 - 1));
+  gl_Position = vec4(p, 0.0, 1.0);
+}
+)";
+
+static const std::string upscaleFragmentShader = R"(
+uniform sampler2D source;
+uniform vec2 sourceSize;
+uniform vec2 renderSize;
+uniform vec2 outputSize;
+uniform int catmullRom;
+out vec4 fragColor;
+
+// p in texels of the rendered corner, pixel centers at +0.5
+vec4 fetch(vec2 p) {
+  return texture(source, clamp(p, vec2(0.5), renderSize - 0.5) / sourceSize);
+}
+
+// 4x4 Catmull-Rom; the two inner taps per axis have positive weights and
+// are merged into one bilinear tap, leaving 3x3 taps
+vec4 fetchCatmullRom(vec2 p) {
+  vec2 center = floor(p - 0.5) + 0.5;
+  vec2 f = p - center;
+  vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+  vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+  vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+  vec2 w3 = f * f * (-0.5 + 0.5 * f);
+  vec2 w12 = w1 + w2;
+  vec2 p0 = center - 1.0;
+  vec2 p12 = center + w2 / w12;
+  vec2 p3 = center + 2.0;
+
+  vec4 c = (fetch(vec2(p0.x,  p0.y)) * w0.x + fetch(vec2(p12.x, p0.y)) * w12.x +
+            fetch(vec2(p3.x,  p0.y)) * w3.x) * w0.y +
+           (fetch(vec2(p0.x, p12.y)) * w0.x + fetch(vec2(p12.x, p12.y)) * w12.x +
+            fetch(vec2(p3.x, p12.y)) * w3.x) * w12.y +
+           (fetch(vec2(p0.x,  p3.y)) * w0.x + fetch(vec2(p12.x, p3.y)) * w12.x +
+            fetch(vec2(p3.x,  p3.y)) * w3.x) * w3.y;
+  // the negative lobes can overshoot at edges
+  return clamp(c, 0.0, 1.0);
+}
+
+void main() {
+  vec2 p = gl_FragCoord.xy * renderSize / outputSize;
+  fragColor = catmullRom != 0 ? fetchCatmullRom(p) : fetch(p);
+}
+)";
+
+DynamicResolution::DynamicResolution(double budgetMs, float minScale, float maxScale,
+                                     Filter filter) :
+  budget(budgetMs),
+  minScale(minScale),
+  maxScale(maxScale),
+  filter(filter),
+  scale(maxScale),
+  color(GL_LINEAR, GL_LINEAR),
+  upscaleProgram(GLProgram::createFromStrings(
+    {GLProgramVariants::versionHeader(), upscaleVertexShader},
+    {GLProgramVariants::versionHeader(), upscaleFragmentShader}))
+{
+  setScaleRange(minScale, maxScale);
+  color.setLabel("dynamic resolution color");
+  depth.setLabel("dynamic resolution depth");
+  framebuffer.setLabel("dynamic resolution");
+
+#ifndef __EMSCRIPTEN__
+  // WebGL does not expose timestamp queries
+  timerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+  if (timerQueries) {
+    for (Measurement& m : measurements) {
+      GL(glGenQueries(1, &m.start));
+      GL(glGenQueries(1, &m.end));
+    }
+  }
+#endif
+}
+
+DynamicResolution::~DynamicResolution() {
+  if (!timerQueries) return;
+  for (Measurement& m : measurements) {
+    GL(glDeleteQueries(1, &m.start));
+    GL(glDeleteQueries(1, &m.end));
+  }
+}
+
+void DynamicResolution::setScaleRange(float minScale, float maxScale) {
+  this->minScale = std::clamp(minScale, 1.0f/scaleSteps, 1.0f);
+  this->maxScale = std::clamp(maxScale, this->minScale, 1.0f);
+  applyScale(scale);
+}
+
+void DynamicResolution::setScale(float scale) {
+  underBudgetFrames = 0;
+  applyScale(scale);
+}
+
+void DynamicResolution::applyScale(float s) {
+  s = std::floor(s * scaleSteps + 0.5f) / scaleSteps;
+  s = std::clamp(s, minScale, maxScale);
+  if (s == scale) return;
+  scale = s;
+  // older measurements describe a different pixel count
+  frameTime = 0;
+  samples = 0;
+}
+
+void DynamicResolution::update(double ms, float measuredScale) {
+  if (measuredScale != scale || budget <= 0) return;
+  frameTime = samples == 0 ? ms : frameTime + smoothing * (ms - frameTime);
+  if (++samples < minSamples || frameTime <= 0) return;
+
+  // the pass is assumed to be fill-rate bound, i.e. cost grows with scale²
+  const float fit = scale * float(std::sqrt(targetLoad * budget / frameTime));
+  if (frameTime > budget) {
+    underBudgetFrames = 0;
+    applyScale(std::min(fit, scale - 1.0f/scaleSteps));
+  } else if (frameTime < raiseThreshold * budget && scale < maxScale) {
+    if (++underBudgetFrames >= raiseDelay) {
+      underBudgetFrames = 0;
+      applyScale(std::min(fit, scale + maxRaiseStep));
+    }
+  } else {
+    underBudgetFrames = 0;
+  }
+}
+
+void DynamicResolution::collectMeasurements() {
+#ifndef __EMSCRIPTEN__
+  // oldest first, so the smoothed time sees them in order
+  for (size_t i = 0;i<measurements.size();++i) {
+    Measurement& m = measurements[(nextMeasurement + i) % measurements.size()];
+    if (!m.pending) continue;
+    GLuint available{GL_FALSE};
+    GL(glGetQueryObjectuiv(m.end, GL_QUERY_RESULT_AVAILABLE, &available));
+    if (!available) break;
+    GLuint64 start{0}, end{0};
+    GL(glGetQueryObjectui64v(m.start, GL_QUERY_RESULT, &start));
+    GL(glGetQueryObjectui64v(m.end, GL_QUERY_RESULT, &end));
+    m.pending = false;
+    update(double(end - start) * 1e-6, m.scale);
+  }
+#endif
+}
+
+void DynamicResolution::begin(const Dimensions& outputSize) {
+  TRACE_SCOPE("DynamicResolution::begin");
+  if (timerQueries) collectMeasurements();
+
+  if (!allocated || outputSize.width != this->outputSize.width ||
+      outputSize.height != this->outputSize.height) {
+    this->outputSize = outputSize;
+    color.setEmpty(outputSize.width, outputSize.height, 4);
+    depth.setSize(outputSize.width, outputSize.height);
+    allocated = true;
+  }
+  renderSize = Dimensions{
+    std::max<uint32_t>(1, uint32_t(std::lround(float(outputSize.width) * scale))),
+    std::max<uint32_t>(1, uint32_t(std::lround(float(outputSize.height) * scale)))
+  };
+
+  framebuffer.bind(color, depth);
+  GL(glViewport(0, 0, GLsizei(renderSize.width), GLsizei(renderSize.height)));
+  GLEnv::redirectDefaultFramebuffer(framebuffer.getId());
+
+#ifndef __EMSCRIPTEN__
+  // with all queries in flight this frame goes unmeasured
+  Measurement& m = measurements[nextMeasurement];
+  measuring = timerQueries && !m.pending;
+  if (measuring) {
+    GL(glQueryCounter(m.start, GL_TIMESTAMP));
+    m.scale = scale;
+  }
+#endif
+  cpuBegin = std::chrono::steady_clock::now();
+}
+
+void DynamicResolution::end() {
+  TRACE_SCOPE("DynamicResolution::end");
+  // the pass only, since the interval between frames includes the wait for vsync
+  if (!timerQueries)
+    update(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuBegin).count(), scale);
+#ifndef __EMSCRIPTEN__
+  if (measuring) {
+    Measurement& m = measurements[nextMeasurement];
+    GL(glQueryCounter(m.end, GL_TIMESTAMP));
+    m.pending = true;
+    nextMeasurement = (nextMeasurement + 1) % measurements.size();
+    measuring = false;
+  }
+#endif
+
+  GLEnv::redirectDefaultFramebuffer(0);
+  GL(glBindFramebuffer(GL_FRAMEBUFFER, GLEnv::defaultFramebuffer()));
+  GL(glViewport(0, 0, GLsizei(outputSize.width), GLsizei(outputSize.height)));
+
+  const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  const GLboolean blend = glIsEnabled(GL_BLEND);
+  GL(glDisable(GL_DEPTH_TEST));
+  GL(glDisable(GL_BLEND));
+
+  upscaleProgram.enable();
+  upscaleProgram.setTexture("source", color, 0);
+  upscaleProgram.setUniform("sourceSize", Vec2{float(outputSize.width), float(outputSize.height)});
+  upscaleProgram.setUniform("renderSize", Vec2{float(renderSize.width), float(renderSize.height)});
+  upscaleProgram.setUniform("outputSize", Vec2{float(outputSize.width), float(outputSize.height)});
+  upscaleProgram.setUniform("catmullRom", filter == Filter::CATMULL_ROM ? 1 : 0);
+  emptyArray.bind();
+  GL(glDrawArrays(GL_TRIANGLES, 0, 3));
+  GL(glClear(GL_DEPTH_BUFFER_BIT));
+
+  if (depthTest) GL(glEnable(GL_DEPTH_TEST));
+  if (blend) GL(glEnable(GL_BLEND));
+}
+
+// defined here rather than in GLApp.cpp, so that only apps enabling dynamic
+// resolution link this file and its framebuffer objects
+void GLApp::setDynamicResolution(double budgetMs, float minScale, float maxScale) {
+  if (budgetMs <= 0) {
+    drawTarget.reset();
+    return;
+  }
+  DynamicResolution* dynamicResolution = getDynamicResolution();
+  if (!dynamicResolution) {
+    drawTarget = std::make_unique<DynamicResolution>(budgetMs, minScale, maxScale);
+    return;
+  }
+  dynamicResolution->setBudget(budgetMs);
+  dynamicResolution->setScaleRange(minScale, maxScale);
+}
+
+DynamicResolution* GLApp::getDynamicResolution() const {
+  return dynamic_cast<DynamicResolution*>(drawTarget.get());
+}
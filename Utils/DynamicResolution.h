@@ -0,0 +1,164 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+
+#include "GLArray.h"
+#include "GLDepthBuffer.h"
+#include "GLDrawTarget.h"
+#include "GLFramebuffer.h"
+#include "GLProgram.h"
+#include "GLTexture2D.h"
+
+/**
+ * @file DynamicResolution.h
+ * @brief Render the 3D pass at a resolution that follows the GPU load.
+ *
+ * Fill-rate bound scenes get slower with every pixel of the window. Instead
+ * of a fixed resolution, the frame is rendered into an offscreen color and
+ * depth target whose size is the window size times a scale factor, and then
+ * upscaled into the window. The scale is adjusted from the measured GPU
+ * time of the scaled pass:
+ *
+ * - Above the budget, the scale drops at once to the value whose pixel
+ *   count is predicted to fit (cost ∝ scale²) with some headroom.
+ * - Only after the time stayed below a lower threshold for a while does the
+ *   scale rise again, and by a limited step. The gap between the two
+ *   thresholds keeps the scale from oscillating.
+ * - The scale is quantized and clamped to [minScale, maxScale].
+ *
+ * GPU times come from \c GL_TIMESTAMP queries in a small ring that is read
+ * only when results are available, so measuring never stalls; unlike
+ * elapsed-time queries they can be used inside @ref GLProfiler scopes.
+ * Without timer queries (WebGL, or drivers lacking ARB_timer_query) the CPU
+ * time between @ref begin() and @ref end() is used instead. It never includes
+ * the wait for vsync, but only follows the GPU load where submitting the
+ * pass blocks on it.
+ *
+ * The target is allocated at the full window size and only a corner of it
+ * is rendered into, so changing the scale never reallocates. While the pass
+ * runs, @ref GLEnv::defaultFramebuffer() points at the target, so passes
+ * that render to textures in between return to it; they have to restore the
+ * viewport to @ref getRenderSize(), not to the window size.
+ *
+ * Typically driven by @ref GLApp::setDynamicResolution(); standalone:
+ * @code
+ * dynamicResolution.begin(glEnv.getFramebufferSize());
+ * renderScene();        // viewport is getRenderSize()
+ * dynamicResolution.end();
+ * renderUI();           // full resolution, on top of the upscaled image
+ * @endcode
+ */
+class DynamicResolution : public GLDrawTarget {
+public:
+  /** @brief Filter used to upscale the target into the window. */
+  enum class Filter {
+    BILINEAR,   ///< One bilinear tap; soft.
+    CATMULL_ROM ///< Bicubic Catmull-Rom in 9 bilinear taps; sharper.
+  };
+
+  /**
+   * @brief Set up the controller and its GL objects; the target is sized on
+   *        the first @ref begin(). Requires a current context.
+   * @param budgetMs GPU time per frame the scaled pass should stay within.
+   * @param minScale Lowest scale per axis.
+   * @param maxScale Highest scale per axis (1 = window resolution).
+   * @param filter   Upscaling filter.
+   */
+  DynamicResolution(double budgetMs=16.0, float minScale=0.5f, float maxScale=1.0f,
+                    Filter filter=Filter::CATMULL_ROM);
+  /** @brief Release the timer queries. */
+  ~DynamicResolution() override;
+
+  DynamicResolution(const DynamicResolution&) = delete;
+  DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+  /** @name Settings */
+  ///@{
+  void setBudget(double budgetMs) {budget = budgetMs;}
+  double getBudget() const {return budget;}
+  /** @brief Set the scale range; the current scale is clamped into it. */
+  void setScaleRange(float minScale, float maxScale);
+  float getMinScale() const {return minScale;}
+  float getMaxScale() const {return maxScale;}
+  void setFilter(Filter filter) {this->filter = filter;}
+  Filter getFilter() const {return filter;}
+  /** @brief Override the controller's scale (clamped and quantized). */
+  void setScale(float scale);
+  ///@}
+
+  /** @name State */
+  ///@{
+  /** @brief Current scale per axis. */
+  float getScale() const {return scale;}
+  /** @brief Size of the scaled pass in pixels. */
+  Dimensions getRenderSize() const override {return renderSize;}
+  /** @brief Smoothed time of the scaled pass at the current scale in ms (0 until measured). */
+  double getFrameTime() const {return frameTime;}
+  /** @brief True if GPU timer queries are used, false for the CPU fallback. */
+  bool hasGPUTimer() const {return timerQueries;}
+  /** @brief The upscaled color target; valid between @ref begin() and the next resize. */
+  const GLTexture2D& getColor() const {return color;}
+  ///@}
+
+  /**
+   * @brief Start the scaled pass.
+   *
+   * Applies the measurements that became available, binds the target,
+   * sets the viewport to @ref getRenderSize(), and redirects
+   * @ref GLEnv::defaultFramebuffer() to the target.
+   * @param outputSize Size of the window's framebuffer.
+   */
+  void begin(const Dimensions& outputSize) override;
+
+  /**
+   * @brief End the scaled pass and upscale it into the window.
+   *
+   * Restores @ref GLEnv::defaultFramebuffer(), draws the target into it
+   * with the full-window viewport, and clears the window's depth buffer so
+   * that UI drawn afterwards starts from an empty depth buffer. Depth
+   * testing and blending are disabled for the copy and restored afterwards.
+   */
+  void end() override;
+
+private:
+  /** A pair of timestamp queries around one scaled pass. */
+  struct Measurement {
+    GLuint start{0};
+    GLuint end{0};
+    float scale{0};
+    bool pending{false};
+  };
+
+  double budget;
+  float minScale;
+  float maxScale;
+  Filter filter;
+  float scale;
+  double frameTime{0};
+  uint32_t samples{0};
+  uint32_t underBudgetFrames{0};
+
+  Dimensions outputSize{0, 0};
+  Dimensions renderSize{0, 0};
+  bool allocated{false};
+  GLTexture2D color;
+  GLDepthBuffer depth;
+  GLFramebuffer framebuffer;
+  GLProgram upscaleProgram;
+  GLArray emptyArray;
+
+  bool timerQueries{false};
+  std::array<Measurement, 4> measurements;
+  size_t nextMeasurement{0};
+  bool measuring{false};
+  std::chrono::steady_clock::time_point cpuBegin; ///< Start of the pass for the CPU fallback.
+
+  /** @brief Read finished timer queries, oldest first, and feed them to @ref update(). */
+  void collectMeasurements();
+  /** @brief Feed one time measured at @p measuredScale to the controller. */
+  void update(double ms, float measuredScale);
+  /** @brief Clamp and quantize @p s and make it current; resets the statistics if it changed. */
+  void applyScale(float s);
+};
@@ -0,0 +1,199 @@
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "FontAtlas.h"
+#include "Trace.h"
+
+namespace {
+  const uint32_t magic   = 0x46534941; // "AISF"
+  const uint32_t version = 1;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t glyphCount;
+    uint32_t reserved;
+  };
+
+  struct GlyphRecord {
+    uint8_t c;
+    uint8_t pad[3];
+    float uvMin[2];
+    float uvMax[2];
+    float width;
+    float height;
+  };
+
+  static_assert(sizeof(Header) == 32, "unexpected padding in the atlas header");
+  static_assert(sizeof(GlyphRecord) == 28, "unexpected padding in the glyph records");
+
+  /**
+   * Read-only view of a whole file, memory mapped where the platform
+   * supports it and read into memory otherwise.
+   */
+  class MappedFile {
+  public:
+    explicit MappedFile(const std::string& filename) {
+#if defined(_WIN32)
+      file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (file == INVALID_HANDLE_VALUE) return;
+      LARGE_INTEGER fileSize;
+      if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+      mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (!mapping) return;
+      data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      if (data) size = size_t(fileSize.QuadPart);
+#elif !defined(__EMSCRIPTEN__)
+      const int fd = open(filename.c_str(), O_RDONLY);
+      if (fd < 0) return;
+      struct stat info;
+      if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* p = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+          data = static_cast<const uint8_t*>(p);
+          size = size_t(info.st_size);
+        }
+      }
+      close(fd);
+#else
+      std::ifstream file{filename, std::ios::binary};
+      if (!file) return;
+      buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+      data = buffer.data();
+      size = buffer.size();
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(_WIN32)
+      if (data) UnmapViewOfFile(data);
+      if (mapping) CloseHandle(mapping);
+      if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#elif !defined(__EMSCRIPTEN__)
+      if (data) munmap(const_cast<uint8_t*>(data), size);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data{nullptr};
+    size_t size{0};
+
+  private:
+#if defined(_WIN32)
+    HANDLE file{INVALID_HANDLE_VALUE};
+    HANDLE mapping{nullptr};
+#elif defined(__EMSCRIPTEN__)
+    std::vector<uint8_t> buffer;
+#endif
+  };
+}
+
+uint64_t FontAtlas::hash(const void* data, size_t size, uint64_t hash) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0;i<size;++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool FontAtlas::save(const std::string& filename, uint64_t sourceHash) const {
+  TRACE_SCOPE("FontAtlas::save");
+  if (bitmap.componentCount != 4 ||
+      bitmap.data.size() != size_t(bitmap.width)*bitmap.height*4 ||
+      distance.size() != size_t(bitmap.width)*bitmap.height) return false;
+
+  const Header header{magic, version, sourceHash, bitmap.width, bitmap.height,
+                      uint32_t(glyphs.size()), 0};
+  std::vector<GlyphRecord> records;
+  records.reserve(glyphs.size());
+  for (const auto& g : glyphs) {
+    records.push_back({uint8_t(g.first), {0,0,0},
+                       {g.second.uvMin.x, g.second.uvMin.y},
+                       {g.second.uvMax.x, g.second.uvMax.y},
+                       g.second.width, g.second.height});
+  }
+
+  // write next to the target and rename, so that a concurrent reader or an
+  // interrupted run never sees a partial file
+  const std::string tempFilename = filename + ".tmp";
+  {
+    std::ofstream file{tempFilename, std::ios::binary | std::ios::trunc};
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(records.data()), std::streamsize(records.size()*sizeof(GlyphRecord)));
+    file.write(reinterpret_cast<const char*>(bitmap.data.data()), std::streamsize(bitmap.data.size()));
+    file.write(reinterpret_cast<const char*>(distance.data()), std::streamsize(distance.size()*sizeof(float)));
+    if (!file) {
+      file.close();
+      std::filesystem::remove(tempFilename);
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tempFilename, filename, error);
+  if (error) {
+    std::filesystem::remove(tempFilename, error);
+    return false;
+  }
+  return true;
+}
+
+FontAtlas FontAtlas::load(const std::string& filename, uint64_t sourceHash) {
+  TRACE_SCOPE("FontAtlas::load");
+  const MappedFile file{filename};
+  if (!file.data) throw FontAtlasException{"Unable to read font atlas " + filename};
+
+  Header header;
+  if (file.size < sizeof(header)) throw FontAtlasException{"Font atlas " + filename + " is truncated"};
+  std::memcpy(&header, file.data, sizeof(header));
+  if (header.magic != magic || header.version != version) {
+    throw FontAtlasException{"Font atlas " + filename + " has an unsupported format"};
+  }
+  if (header.sourceHash != sourceHash) {
+    throw FontAtlasException{"Font atlas " + filename + " was built from a different font"};
+  }
+
+  const size_t texels = size_t(header.width)*header.height;
+  const size_t recordOffset   = sizeof(header);
+  const size_t bitmapOffset   = recordOffset + size_t(header.glyphCount)*sizeof(GlyphRecord);
+  const size_t distanceOffset = bitmapOffset + texels*4;
+  if (header.glyphCount > 256 || file.size != distanceOffset + texels*sizeof(float)) {
+    throw FontAtlasException{"Font atlas " + filename + " is truncated"};
+  }
+
+  FontAtlas atlas{Image{header.width, header.height, 4,
+                        std::vector<uint8_t>(file.data+bitmapOffset, file.data+distanceOffset)},
+                  std::vector<float>(texels), {}};
+  std::memcpy(atlas.distance.data(), file.data+distanceOffset, texels*sizeof(float));
+
+  atlas.glyphs.reserve(header.glyphCount);
+  for (uint32_t i = 0;i<header.glyphCount;++i) {
+    GlyphRecord r;
+    std::memcpy(&r, file.data + recordOffset + i*sizeof(GlyphRecord), sizeof(r));
+    atlas.glyphs.push_back({char(r.c), Glyph{Vec2{r.uvMin[0], r.uvMin[1]}, Vec2{r.uvMax[0], r.uvMax[1]},
+                                              r.width, r.height}});
+  }
+  return atlas;
+}
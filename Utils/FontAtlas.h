@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <exception>
+
+#include "Image.h"
+#include "Vec2.h"
+
+/**
+ * @file FontAtlas.h
+ * @brief Glyph atlas of a @ref FontEngine and its binary cache file.
+ *
+ * Building an atlas renders every glyph and computes its signed distance
+ * field, which dominates font startup. @ref FontAtlas::save writes the
+ * finished atlas (bitmap, distance field, and glyph metrics) into one binary
+ * blob, and @ref FontAtlas::load maps it back in without any glyph
+ * processing. The file records a hash of the source font, so a cache built
+ * from a different bitmap or position file is rejected and rebuilt.
+ *
+ * File layout (native byte order, checked through the magic number):
+ * @code
+ * uint32 magic 'AISF', uint32 version, uint64 source hash,
+ * uint32 width, uint32 height, uint32 glyph count, uint32 reserved
+ * glyph count x {uint8 char, uint8 pad[3], float uvMin[2], uvMax[2], width, height}
+ * width*height*4 bytes RGBA bitmap
+ * width*height floats signed distance field
+ * @endcode
+ */
+
+/**
+ * @brief Exception type thrown for unreadable or malformed atlas files.
+ */
+class FontAtlasException : public std::exception {
+public:
+  /** @brief Construct with an explanatory message. */
+  FontAtlasException(const std::string& whatStr) : whatStr(whatStr) {}
+  /** @brief Retrieve the explanatory C-string. */
+  virtual const char* what() const throw() {
+    return whatStr.c_str();
+  }
+private:
+  std::string whatStr; ///< Stored message.
+};
+
+/**
+ * @brief Location and size of one glyph in the atlas of a @ref FontEngine.
+ */
+struct Glyph {
+  Vec2 uvMin;   ///< Texture coordinates of the glyph's lower left corner.
+  Vec2 uvMax;   ///< Texture coordinates of the glyph's upper right corner.
+  float width;  ///< Glyph width normalized by the maximum glyph width in the set.
+  float height; ///< Glyph height normalized by the maximum glyph height in the set.
+};
+
+/**
+ * @brief CPU-side glyph atlas: bitmap, signed distance field, and metrics.
+ */
+struct FontAtlas {
+  Image bitmap;                ///< RGBA glyph bitmaps.
+  std::vector<float> distance; ///< Signed distances of the same layout, one float per texel.
+  std::vector<std::pair<char, Glyph>> glyphs; ///< Characters and their atlas rectangles.
+
+  /**
+   * @brief Write the atlas to a cache file.
+   * @param filename   Target file (replaced atomically through a temporary file).
+   * @param sourceHash Hash of the font the atlas was built from.
+   * @return False if the file cannot be written.
+   */
+  bool save(const std::string& filename, uint64_t sourceHash) const;
+
+  /**
+   * @brief Map a cache file into memory and read the atlas from it.
+   * @param filename   Cache file written by @ref save().
+   * @param sourceHash Expected hash of the source font.
+   * @throw FontAtlasException If the file is missing, truncated, from another
+   *        version, or was built from a different source font.
+   */
+  static FontAtlas load(const std::string& filename, uint64_t sourceHash);
+
+  /**
+   * @brief 64-bit FNV-1a hash of @p size bytes, continuing from @p hash.
+   */
+  static uint64_t hash(const void* data, size_t size, uint64_t hash=14695981039346656037ull);
+};
@@ -1,14 +1,14 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
 
 #include "FontRenderer.h"
+#include "Trace.h"
 
 const CharPosition& FontRenderer::findElement(char c) const {
-  for (size_t i = 0;i<positions.size();++i) {
-    if (positions[i].c == c) return positions[i];
-  }
-  return positions[0];
+  return positions[lookup[uint8_t(c)]];
 }
 
 const std::vector<CharPosition> FontRenderer::loadPositions(const std::string& positionFilename) {
@@ -54,9 +54,15 @@ FontRenderer::FontRenderer(const Image& fontImage,
 FontRenderer::FontRenderer(const Image& fontImage,
                            const std::vector<CharPosition>& positions) :
 fontImage(fontImage),
-positions(positions)
+positions(positions),
+lookup{},
+imageCache{4*1024*1024}
 {
   if (fontImage.componentCount == 3) this->fontImage.generateAlphaFromLuminance();
+  // first entry wins, as with a front-to-back search; absent characters map to 0
+  for (size_t i = positions.size();i>0;--i) {
+    lookup[uint8_t(positions[i-1].c)] = uint16_t(i-1);
+  }
 }
 
 Image FontRenderer::render(uint32_t number) const {
@@ -86,6 +92,13 @@ Image FontRenderer::render(const std::string& text) const {
   return result;
 }
 
+const Image& FontRenderer::renderCached(const std::string& text) const {
+  if (const Image* image = imageCache.find(text)) return *image;
+  Image image = render(text);
+  const size_t bytes = image.data.size();
+  return imageCache.insert(text, std::move(image), bytes);
+}
+
 std::string FontRenderer::toCode(const std::string& varName) const {
   std::stringstream ss;
   ss << fontImage.toCode(varName+"Image") << "\nstd::vector<CharPosition> " << varName << "Pos{";
@@ -103,31 +116,137 @@ std::string FontRenderer::toCode(const std::string& varName) const {
   return ss.str();
 }
 
-std::shared_ptr<FontEngine> FontRenderer::generateFontEngine() const {
-  std::shared_ptr<FontEngine> fe = std::make_shared<FontEngine>();
-  
+// texels around each glyph copied from its border, so that linear filtering
+// at the quad edges never reaches a neighbour
+static const uint32_t atlasPadding = 2;
+// coverage treated as inside the glyph for the signed distance field
+static const float distanceThreshold = 0.9f;
+
+FontAtlas FontRenderer::generateAtlas() const {
+  TRACE_SCOPE("FontRenderer::generateAtlas");
+
+  struct Entry {
+    char c;
+    Image bitmap;
+    Grid2D distance;
+    Vec2ui offset;
+  };
+  std::vector<Entry> entries;
+  std::array<bool, 256> seen{};
+  for (const CharPosition& c : positions) {
+    if (seen[uint8_t(c.c)]) continue;
+    seen[uint8_t(c.c)] = true;
+    entries.push_back({c.c, Image{0,0,4}, Grid2D{0,0}, {}});
+  }
+  if (entries.empty()) return FontAtlas{Image{0,0,4}, {}, {}};
+
+  // the distance transform dominates, and glyphs are independent
+  #pragma omp parallel for schedule(dynamic)
+  for (int64_t i = 0;i<int64_t(entries.size());++i) {
+    Entry& e = entries[size_t(i)];
+    e.bitmap = render(std::string(1,e.c));
+    e.distance = Grid2D(e.bitmap).toSignedDistance(distanceThreshold);
+  }
+
   uint32_t maxWidth  = 0;
   uint32_t maxHeight = 0;
-  
-  for (const CharPosition& c : positions) {
-    const uint32_t width  = c.bottomRight.x-c.topLeft.x;
-    const uint32_t height = c.bottomRight.y-c.topLeft.y;
-    maxWidth = std::max(maxWidth, width);
-    maxHeight = std::max(maxHeight, height);
+  for (const Entry& e : entries) {
+    maxWidth  = std::max(maxWidth, e.bitmap.width);
+    maxHeight = std::max(maxHeight, e.bitmap.height);
   }
-  
-  for (const CharPosition& c : positions) {
-    const Image i = render(std::string(1,c.c));
-    const float w=i.width/float(maxWidth);
-    const float h=i.height/float(maxHeight);
-    
-    const Mat4 s = Mat4::scaling(w,h,1.0f);
-    const Mat4 t = Mat4::translation(w,h,0.0f);
-    fe->chars[c.c] = CharTex{GLTexture2D(i),s,t,w,h};
-    fe->chars[c.c].tex.setFilter(GL_LINEAR, GL_LINEAR);
 
-    fe->sdChars[c.c] = CharTex{Grid2D(i).toSignedDistance(0.9f).toTexture(),s,t,w,h};
-    fe->sdChars[c.c].tex.setFilter(GL_LINEAR, GL_LINEAR);
+  // shelf packing: tallest glyphs first, rows of a roughly square atlas
+  std::vector<size_t> order(entries.size());
+  for (size_t i = 0;i<order.size();++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&entries](size_t a, size_t b) {
+    return entries[a].bitmap.height > entries[b].bitmap.height;
+  });
+  double area = 0;
+  for (const Entry& e : entries) {
+    area += double(e.bitmap.width+2*atlasPadding) * double(e.bitmap.height+2*atlasPadding);
+  }
+  const uint32_t atlasWidth = std::max(maxWidth+2*atlasPadding, uint32_t(std::ceil(std::sqrt(area))));
+  Vec2ui cursor{0,0};
+  uint32_t shelfHeight = 0;
+  for (size_t i : order) {
+    Entry& e = entries[i];
+    const uint32_t w = e.bitmap.width+2*atlasPadding;
+    const uint32_t h = e.bitmap.height+2*atlasPadding;
+    if (cursor.x + w > atlasWidth) {
+      cursor = Vec2ui{0, cursor.y+shelfHeight};
+      shelfHeight = 0;
+    }
+    e.offset = Vec2ui{cursor.x+atlasPadding, cursor.y+atlasPadding};
+    cursor.x += w;
+    shelfHeight = std::max(shelfHeight, h);
+  }
+  const uint32_t atlasHeight = cursor.y+shelfHeight;
+
+  FontAtlas atlas{Image{atlasWidth, atlasHeight, 4, std::vector<uint8_t>(size_t(atlasWidth)*atlasHeight*4)},
+                  std::vector<float>(size_t(atlasWidth)*atlasHeight),
+                  std::vector<std::pair<char, Glyph>>(entries.size())};
+
+  // glyph rectangles (including their padding) do not overlap
+  #pragma omp parallel for
+  for (int64_t i = 0;i<int64_t(entries.size());++i) {
+    const Entry& e = entries[size_t(i)];
+    const int64_t w = e.bitmap.width;
+    const int64_t h = e.bitmap.height;
+    const int64_t p = atlasPadding;
+    for (int64_t y = -p;y<h+p;++y) {
+      for (int64_t x = -p;x<w+p;++x) {
+        const uint32_t sx = uint32_t(std::clamp<int64_t>(x, 0, w-1));
+        const uint32_t sy = uint32_t(std::clamp<int64_t>(y, 0, h-1));
+        const uint32_t tx = uint32_t(int64_t(e.offset.x)+x);
+        const uint32_t ty = uint32_t(int64_t(e.offset.y)+y);
+        for (uint8_t comp = 0;comp<4;++comp) {
+          const uint8_t v = comp < e.bitmap.componentCount ? e.bitmap.getValue(sx, sy, comp) : 255;
+          atlas.bitmap.setValue(tx, ty, comp, v);
+        }
+        atlas.distance[tx + size_t(ty)*atlasWidth] = e.distance.getValue(sx, sy);
+      }
+    }
+
+    const Glyph g{
+      Vec2{float(e.offset.x)/atlasWidth, float(e.offset.y)/atlasHeight},
+      Vec2{float(e.offset.x+e.bitmap.width)/atlasWidth, float(e.offset.y+e.bitmap.height)/atlasHeight},
+      e.bitmap.width/float(maxWidth),
+      e.bitmap.height/float(maxHeight)
+    };
+    atlas.glyphs[size_t(i)] = {e.c, g};
+  }
+  return atlas;
+}
+
+uint64_t FontRenderer::getSourceHash() const {
+  const uint32_t parameters[] = {fontImage.width, fontImage.height, fontImage.componentCount,
+                                 atlasPadding, uint32_t(distanceThreshold*1000.0f)};
+  uint64_t hash = FontAtlas::hash(parameters, sizeof(parameters));
+  hash = FontAtlas::hash(fontImage.data.data(), fontImage.data.size(), hash);
+  for (const CharPosition& p : positions) {
+    const uint32_t box[] = {uint32_t(uint8_t(p.c)), p.topLeft.x, p.topLeft.y, p.bottomRight.x, p.bottomRight.y};
+    hash = FontAtlas::hash(box, sizeof(box), hash);
+  }
+  return hash;
+}
+
+std::shared_ptr<FontEngine> FontRenderer::generateFontEngine() const {
+  TRACE_SCOPE("FontRenderer::generateFontEngine");
+  std::shared_ptr<FontEngine> fe = std::make_shared<FontEngine>();
+  fe->setAtlas(generateAtlas());
+  return fe;
+}
+
+std::shared_ptr<FontEngine> FontRenderer::generateFontEngine(const std::string& cacheFile) const {
+  TRACE_SCOPE("FontRenderer::generateFontEngine");
+  const uint64_t sourceHash = getSourceHash();
+  std::shared_ptr<FontEngine> fe = std::make_shared<FontEngine>();
+  try {
+    fe->setAtlas(FontAtlas::load(cacheFile, sourceHash));
+  } catch (const FontAtlasException&) {
+    const FontAtlas atlas = generateAtlas();
+    atlas.save(cacheFile, sourceHash);
+    fe->setAtlas(atlas);
   }
   return fe;
 }
@@ -136,160 +255,241 @@ std::shared_ptr<FontEngine> FontRenderer::generateFontEngine() const {
 FontEngine::FontEngine() :
 #ifdef __EMSCRIPTEN__
 simpleProg{GLProgram::createFromString(R"(#version 300 es
-uniform mat4 MVP;
-in vec3 vPos;
+in vec2 vPos;
 in vec2 vTexCoords;
+in vec4 vColor;
 out vec4 color;
 out vec2 texCoords;
 void main() {
-    gl_Position = MVP * vec4(vPos, 1.0);
+    gl_Position = vec4(vPos, 0.0, 1.0);
     texCoords = vTexCoords;
+    color = vColor;
 })",R"(#version 300 es
 precision mediump float;
 uniform sampler2D raster;
-uniform vec4 globalColor;
+in vec4 color;
 in vec2 texCoords;
 out vec4 FragColor;
 void main() {
-    FragColor = globalColor*texture(raster, texCoords);
+    FragColor = color*texture(raster, texCoords);
 })")},
 simpleDistProg{GLProgram::createFromString(R"(#version 300 es
-uniform mat4 MVP;
-in vec3 vPos;
+in vec2 vPos;
 in vec2 vTexCoords;
+in vec4 vColor;
 out vec4 color;
 out vec2 texCoords;
 void main() {
-    gl_Position = MVP * vec4(vPos, 1.0);
+    gl_Position = vec4(vPos, 0.0, 1.0);
     texCoords = vTexCoords;
+    color = vColor;
 })",R"(#version 300 es
 precision mediump float;
 uniform sampler2D raster;
-uniform vec4 globalColor;
+in vec4 color;
 in vec2 texCoords;
 out vec4 FragColor;
 void main() {
     float dist = texture(raster, texCoords).r;
     float val  = smoothstep(-3.0,1.0,dist);
-    FragColor  = globalColor*val;
+    FragColor  = color*val;
 })")},
 #else
   simpleProg{GLProgram::createFromString(
    "#version 410\n"
-   "uniform mat4 MVP;\n"
-   "layout (location = 0) in vec3 vPos;\n"
+   "layout (location = 0) in vec2 vPos;\n"
    "layout (location = 1) in vec2 vTexCoords;\n"
+   "layout (location = 2) in vec4 vColor;\n"
    "out vec4 color;\n"
    "out vec2 texCoords;\n"
    "void main() {\n"
-   "    gl_Position = MVP * vec4(vPos, 1.0);\n"
+   "    gl_Position = vec4(vPos, 0.0, 1.0);\n"
    "    texCoords = vTexCoords;\n"
+   "    color = vColor;\n"
    "}\n",
    "#version 410\n"
    "uniform sampler2D raster;\n"
-   "uniform vec4 globalColor;\n"
+   "in vec4 color;\n"
    "in vec2 texCoords;\n"
    "out vec4 FragColor;\n"
    "void main() {\n"
-   "    FragColor = globalColor*texture(raster, texCoords);\n"
+   "    FragColor = color*texture(raster, texCoords);\n"
    "}\n")},
   simpleDistProg{GLProgram::createFromString(
    "#version 410\n"
-   "uniform mat4 MVP;\n"
-   "layout (location = 0) in vec3 vPos;\n"
+   "layout (location = 0) in vec2 vPos;\n"
    "layout (location = 1) in vec2 vTexCoords;\n"
+   "layout (location = 2) in vec4 vColor;\n"
    "out vec4 color;\n"
    "out vec2 texCoords;\n"
    "void main() {\n"
-   "    gl_Position = MVP * vec4(vPos, 1.0);\n"
+   "    gl_Position = vec4(vPos, 0.0, 1.0);\n"
    "    texCoords = vTexCoords;\n"
+   "    color = vColor;\n"
    "}\n",
    "#version 410\n"
    "uniform sampler2D raster;\n"
-   "uniform vec4 globalColor;\n"
+   "in vec4 color;\n"
    "in vec2 texCoords;\n"
    "out vec4 FragColor;\n"
    "void main() {\n"
    "    float dist = texture(raster, texCoords).r;\n"
    "    float val  = smoothstep(-3.0,1.0,dist);\n"
-   "    FragColor  = globalColor*val;\n"
+   "    FragColor  = color*val;\n"
    "}\n")},
 #endif
   simpleArray{},
   simpleVb{GL_ARRAY_BUFFER},
+  atlas{GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE},
+  distanceAtlas{GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE},
+  glyphs{},
+  available{},
+  vertices{},
+  layoutCache{1024*1024},
+  layoutKey{},
+  batching{false},
   renderAsSignedDistanceField{false}
 {
-  simpleArray.bind();
-  std::vector<float> data = {
-    -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-     1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-     1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-
-    -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-    -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-     1.0f, -1.0f, 0.0f, 1.0f, 0.0f
-  };
-  simpleVb.setData(data,5,GL_STATIC_DRAW);
+  simpleProg.setLabel("FontEngine bitmap");
+  simpleDistProg.setLabel("FontEngine distance field");
 }
 
-void FontEngine::render(const std::string& text, float winAspect,
-                        float height, const Vec2& pos, Alignment a, const Vec4& color) {
+void FontEngine::setAtlas(const FontAtlas& atlas) {
+  layoutCache.clear();
+  available.fill(false);
+  if (atlas.glyphs.empty()) return;
 
-  GL(glEnable(GL_BLEND));
-  GL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-  GL(glBlendEquation(GL_FUNC_ADD));
+  this->atlas.setData(atlas.bitmap);
+  this->atlas.setLabel("FontEngine atlas");
+  distanceAtlas.setData(atlas.distance, atlas.bitmap.width, atlas.bitmap.height, 1);
+  distanceAtlas.setLabel("FontEngine distance atlas");
 
-  GLProgram& activeShader = (renderAsSignedDistanceField) ? simpleDistProg : simpleProg;
-  std::map<char,CharTex>& activeFontMap = (renderAsSignedDistanceField) ? sdChars : chars;
-  
-  activeShader.enable();
-  activeShader.setUniform("globalColor", color);
-  simpleArray.bind();
-  simpleArray.connectVertexAttrib(simpleVb, activeShader, "vPos", 3);
-  simpleArray.connectVertexAttrib(simpleVb, activeShader, "vTexCoords", 2, 3);
-  
+  Glyph fallback = atlas.glyphs.front().second;
+  for (const auto& g : atlas.glyphs) {
+    if (g.first == '_') fallback = g.second;
+  }
+  glyphs.fill(fallback);
+  for (const auto& g : atlas.glyphs) {
+    glyphs[uint8_t(g.first)] = g.second;
+    available[uint8_t(g.first)] = true;
+  }
+}
+
+float FontEngine::totalWidth(const std::string& text) const {
   float totalWidth = 0;
-  for (char c : text) {
-    if (activeFontMap.find(c) == activeFontMap.end()) c = '_';
-    totalWidth += activeFontMap.at(c).width;
+  for (char c : text) totalWidth += glyphs[uint8_t(c)].width;
+  return totalWidth;
+}
+
+const std::vector<float>& FontEngine::layout(const std::string& text, float winAspect, float size,
+                                             bool fixedWidth, Alignment a) {
+  // fixed-size parameter suffix, so distinct keys cannot collide
+  const float parameters[] = {winAspect, size, fixedWidth ? 1.0f : 0.0f, float(a)};
+  layoutKey.assign(text);
+  layoutKey.append(reinterpret_cast<const char*>(parameters), sizeof(parameters));
+  if (const std::vector<float>* quads = layoutCache.find(layoutKey)) return *quads;
+
+  float unitX, unitY, width, y;
+  if (fixedWidth) {
+    // the string spans 2*size in NDC, vertically centered on the anchor
+    unitX = 2.0f*size/totalWidth(text);
+    unitY = unitX*winAspect;
+    width = 2.0f*size;
+    y = -unitY/2.0f;
+  } else {
+    // each glyph spans 2*size*height in NDC, with its bottom one size below the anchor
+    unitX = 2.0f*size/winAspect;
+    unitY = 2.0f*size;
+    width = unitX*totalWidth(text);
+    y = -size;
   }
-  
-  Mat4 scale = Mat4::scaling(height/winAspect, height, 1.0f);
-  Mat4 trans;
+  float x = 0;
   switch (a) {
     case Alignment::Center :
-      trans = Mat4::translation(pos.x-height*totalWidth/winAspect, pos.y, 0.0f);
+      x -= width/2.0f;
       break;
     case Alignment::Right :
-      trans = Mat4::translation(pos.x-2.0f*height*totalWidth/winAspect, pos.y, 0.0f);
+      x -= width;
       break;
     default :
-      trans = Mat4::translation(pos.x, pos.y, 0.0f);
       break;
   }
-  
+
+  std::vector<float> quads;
+  quads.reserve(text.size()*6*4);
   for (char c : text) {
-    if (activeFontMap.find(c) == activeFontMap.end()) c = '_';
-    activeShader.setUniform("MVP",
-                            trans *
-                            Mat4::translation(height*activeFontMap[c].width/winAspect,height*(activeFontMap[c].height-1.0f),0.0f) *
-                            activeFontMap[c].scale *
-                            scale);
-    activeShader.setTexture("raster",activeFontMap[c].tex,0);
-    GL(glDrawArrays(GL_TRIANGLES, 0, GLsizei(6)));
-    trans = Mat4::translation(2.0f*height*activeFontMap[c].width/winAspect,0.0f,0.0f) * trans;
+    const Glyph& g = glyphs[uint8_t(c)];
+    const float x1 = x + unitX*g.width;
+    const float y1 = y + unitY*g.height;
+    quads.insert(quads.end(), {
+      x,  y1, g.uvMin.x, g.uvMax.y,
+      x1, y,  g.uvMax.x, g.uvMin.y,
+      x1, y1, g.uvMax.x, g.uvMax.y,
+      x,  y1, g.uvMin.x, g.uvMax.y,
+      x,  y,  g.uvMin.x, g.uvMin.y,
+      x1, y,  g.uvMax.x, g.uvMin.y
+    });
+    x = x1;
   }
+  const size_t bytes = quads.capacity()*sizeof(float);
+  return layoutCache.insert(layoutKey, std::move(quads), bytes);
 }
 
-Vec2 FontEngine::getSize(const std::string& text, float winAspect, float height) const {
-  float totalWidth = 0;
-  for (char c : text) {
-    if (chars.find(c) == chars.end()) c = '_';
-    totalWidth += chars.at(c).width;
+void FontEngine::appendQuads(const std::vector<float>& quads, const Vec2& pos, const Vec4& color) {
+  const size_t start = vertices.size();
+  vertices.resize(start + quads.size()*2);
+  float* v = vertices.data() + start;
+  for (size_t i = 0;i<quads.size();i+=4) {
+    v[0] = pos.x + quads[i];
+    v[1] = pos.y + quads[i+1];
+    v[2] = quads[i+2];
+    v[3] = quads[i+3];
+    v[4] = color.r;
+    v[5] = color.g;
+    v[6] = color.b;
+    v[7] = color.a;
+    v += 8;
   }
-  return {height*totalWidth/winAspect, height};
 }
 
+void FontEngine::beginBatch() {
+  batching = true;
+}
+
+void FontEngine::endBatch() {
+  batching = false;
+  flush();
+}
+
+void FontEngine::flush() {
+  if (batching || vertices.empty()) return;
+
+  GL(glEnable(GL_BLEND));
+  GL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+  GL(glBlendEquation(GL_FUNC_ADD));
+
+  GLProgram& activeShader = (renderAsSignedDistanceField) ? simpleDistProg : simpleProg;
+  activeShader.enable();
+  activeShader.setTexture("raster", renderAsSignedDistanceField ? distanceAtlas : atlas, 0);
+
+  simpleArray.bind();
+  simpleVb.setData(vertices, 8, GL_DYNAMIC_DRAW);
+  simpleArray.connectVertexAttrib(simpleVb, activeShader, "vPos", 2);
+  simpleArray.connectVertexAttrib(simpleVb, activeShader, "vTexCoords", 2, 2);
+  simpleArray.connectVertexAttrib(simpleVb, activeShader, "vColor", 4, 4);
+  GL(glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size()/8)));
+  vertices.clear();
+}
+
+void FontEngine::render(const std::string& text, float winAspect,
+                        float height, const Vec2& pos, Alignment a, const Vec4& color) {
+  appendQuads(layout(text, winAspect, height, false, a), pos, color);
+  flush();
+}
+
+Vec2 FontEngine::getSize(const std::string& text, float winAspect, float height) const {
+  return {height*totalWidth(text)/winAspect, height};
+}
 void FontEngine::render(uint32_t number, float winAspect, float height, const Vec2& pos,
                         Alignment a, const Vec4& color) {
   render(std::to_string(number), winAspect, height, pos, a, color);
@@ -309,60 +509,20 @@ Vec2 FontEngine::getSizeFixedWidth(uint32_t number, float winAspect, float width
 }
 
 Vec2 FontEngine::getSizeFixedWidth(const std::string& text, float winAspect, float width) const {
-  float totalWidth = 0;
-  for (char c : text) {
-    if (chars.find(c) == chars.end()) c = '_';
-    totalWidth += chars.at(c).width;
-  }
-  return {width, width*winAspect/totalWidth};
+  return {width, width*winAspect/totalWidth(text)};
 }
 
 
 void FontEngine::renderFixedWidth(const std::string& text, float winAspect, float width, const Vec2& pos, Alignment a, const Vec4& color) {
-  simpleProg.enable();
-  simpleProg.setUniform("globalColor", color);
-  simpleArray.bind();
-  simpleArray.connectVertexAttrib(simpleVb, simpleProg, "vPos", 3);
-  simpleArray.connectVertexAttrib(simpleVb, simpleProg, "vTexCoords", 2, 3);
-  
-  float totalWidth = 0;
-  for (char c : text) {
-    if (chars.find(c) == chars.end()) c = '_';
-    totalWidth += chars.at(c).width;
-  }
-  
-  Mat4 scale = Mat4::scaling(width/totalWidth, width/totalWidth*winAspect, 1.0f);
-  Mat4 trans;
-  switch (a) {
-    case Alignment::Center :
-      trans = Mat4::translation(pos.x-width, pos.y, 0.0f);
-      break;
-    case Alignment::Right :
-      trans = Mat4::translation(pos.x-2.0f*width, pos.y, 0.0f);
-      break;
-    default :
-      trans = Mat4::translation(pos.x, pos.y, 0.0f);
-      break;
-  }
-  
-  for (char c : text) {
-    if (chars.find(c) == chars.end()) c = '_';
-    simpleProg.setUniform("MVP", trans *
-                          Mat4::translation(width*chars[c].width/totalWidth, width/totalWidth*winAspect*(chars[c].height-1.0f),0.0f) *
-                          chars[c].scale *
-                          scale);
-
-    simpleProg.setTexture("raster",chars[c].tex,0);
-    GL(glDrawArrays(GL_TRIANGLES, 0, GLsizei(6)));
-    trans = Mat4::translation(2.0f* width*chars[c].width/totalWidth,0.0f,0.0f) * trans;
-  }
+  appendQuads(layout(text, winAspect, width, true, a), pos, color);
+  flush();
 }
 
 
 std::string FontEngine::getAllCharsString() const {
   std::stringstream ss;
-  for (const auto& c : chars) {
-    ss << c.first;
+  for (size_t c = 0;c<available.size();++c) {
+    if (available[c]) ss << char(c);
   }
   return ss.str();
 }
@@ -2,7 +2,7 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <array>
 #include <utility>
 #include <memory>
 
@@ -12,6 +12,8 @@
 #include "GLArray.h"
 #include "GLBuffer.h"
 #include "Grid2D.h"
+#include "FontAtlas.h"
+#include "LRUCache.h"
 
 /**
  * @file FontRenderer.h
@@ -20,8 +22,9 @@
  * Declares two related components:
  *  - @ref FontRenderer: CPU-only blitter that composes strings into an @ref Image
  *    using a bitmap atlas and character box positions read from a text file.
- *  - @ref FontEngine: runtime OpenGL renderer that draws strings as quads using
- *    per-character textures; optionally renders from a signed-distance field.
+ *  - @ref FontEngine: runtime OpenGL renderer that draws strings as quads from
+ *    a single glyph atlas texture; optionally renders from a signed-distance
+ *    field atlas.
  */
 
 /**
@@ -37,17 +40,6 @@ struct CharPosition {
   Vec2ui bottomRight; ///< Bottom-right corner (exclusive) of the glyph box in the atlas.
 };
 
-/**
- * @brief Texture + transform bundle for a single glyph used by @ref FontEngine.
- */
-struct CharTex {
-  GLTexture2D tex; ///< Glyph texture (RGBA or single-channel).
-  Mat4 scale;      ///< Per-glyph scale to normalize to [0,1] quad space.
-  Mat4 trans;      ///< Per-glyph translation used by the renderer.
-  float width;     ///< Glyph width normalized by the maximum glyph width in the set.
-  float height;    ///< Glyph height normalized by the maximum glyph height in the set.
-};
-
 /**
  * @brief Text alignment modes used by the OpenGL renderer.
  */
@@ -58,18 +50,36 @@ enum class Alignment {
 };
 
 /**
- * @brief OpenGL-based text drawer using per-character textures (or SDFs).
+ * @brief OpenGL-based text drawer using a glyph atlas (or an SDF atlas).
  *
- * Builds a simple pipeline to render strings as textured quads. The map
- * @ref chars holds per-glyph textures; @ref sdChars stores signed-distance
- * variants for crisp scaling when @ref renderAsSignedDistanceField is enabled.
+ * All glyphs live in one atlas texture (@ref renderAsSignedDistanceField
+ * selects a second atlas holding their signed distance fields), and a
+ * 256-entry table maps each character to its atlas rectangle. A string is
+ * turned into one vertex buffer of colored quads in NDC and drawn with a
+ * single call. Between @ref beginBatch() and @ref endBatch(), all strings
+ * are collected and drawn together:
+ * @code
+ * font->beginBatch();
+ * for (const std::string& line : lines) font->render(line, aspect, 0.03f, pos);
+ * font->endBatch(); // one draw call
+ * @endcode
+ *
+ * The quads of each (string, size, aspect, alignment, fixed-width mode) are kept
+ * relative to the anchor in an LRU cache, so redrawing the same overlay
+ * text every frame only translates and colors cached vertices.
  */
 class FontEngine {
 public:
-  /** @brief Create an empty engine and initialize shaders, quad geometry, and VBOs. */
+  /** @brief Create an empty engine and initialize shaders and buffers. */
   FontEngine();
   virtual ~FontEngine() {}
 
+  /**
+   * @brief Upload a glyph atlas. Characters without an entry are drawn as
+   *        '_' (or the first glyph).
+   */
+  void setAtlas(const FontAtlas& atlas);
+
   /**
    * @name Draw text
    */
@@ -94,6 +104,11 @@ public:
               const Vec2& pos, Alignment a = Alignment::Center, const Vec4& color=Vec4{1.0f,1.0f,1.0f,1.0f});
   void renderFixedWidth(uint32_t number, float winAspect, float width,
                         const Vec2& pos, Alignment a = Alignment::Center, const Vec4& color=Vec4{1.0f,1.0f,1.0f,1.0f});
+
+  /** @brief Collect the following render calls instead of drawing each string. */
+  void beginBatch();
+  /** @brief Draw all strings collected since @ref beginBatch() in one call. */
+  void endBatch();
   ///@}
 
   /** @name Layout helpers */
@@ -110,8 +125,13 @@ public:
   /** @brief Return the available characters as a single concatenated string. */
   std::string getAllCharsString() const;
 
-  std::map<char,CharTex> chars;  ///< Per-character textures + transforms.
-  std::map<char,CharTex> sdChars;///< Per-character SDF textures + transforms.
+  /** @brief Atlas rectangle and size of @p c (the fallback glyph if unavailable). */
+  const Glyph& getGlyph(char c) const {return glyphs[uint8_t(c)];}
+
+  /** @brief Memory budget of the layout cache in bytes (default 1 MiB). */
+  void setLayoutCacheBudget(size_t bytes) {layoutCache.setBudget(bytes);}
+  /** @brief Layout cache, e.g. for its hit/miss counters. */
+  const LRUCache<std::vector<float>>& getLayoutCache() const {return layoutCache;}
 
   /** @brief Enable/disable signed distance field rendering. */
   void setRenderAsSignedDistanceField(bool renderAsSignedDistanceField) {
@@ -126,9 +146,31 @@ public:
 private:
   GLProgram simpleProg;   ///< Shader for alpha-blended bitmap glyphs.
   GLProgram simpleDistProg; ///< Shader for signed-distance glyph rendering.
-  GLArray   simpleArray;  ///< VAO for a unit quad.
-  GLBuffer  simpleVb;     ///< VBO with quad positions/UVs.
-  bool renderAsSignedDistanceField; ///< If true, use @ref sdChars and distance shader.
+  GLArray   simpleArray;  ///< VAO for the glyph quads.
+  GLBuffer  simpleVb;     ///< Streamed quads: NDC position, atlas UV, color.
+  GLTexture2D atlas;      ///< All glyph bitmaps.
+  GLTexture2D distanceAtlas; ///< All glyph signed distance fields.
+  std::array<Glyph, 256> glyphs; ///< Glyph of each character (fallback for missing ones).
+  std::array<bool, 256> available; ///< Characters present in the atlas.
+  std::vector<float> vertices;     ///< Quads of the current string or batch.
+  LRUCache<std::vector<float>> layoutCache; ///< Anchor-relative quads (x, y, u, v) per string.
+  std::string layoutKey;           ///< Reused key buffer for @ref layoutCache lookups.
+  bool batching;          ///< Inside beginBatch()/endBatch().
+  bool renderAsSignedDistanceField; ///< If true, use @ref distanceAtlas and the distance shader.
+
+  /** @brief Sum of the normalized widths of the glyphs of @p text. */
+  float totalWidth(const std::string& text) const;
+  /**
+   * @brief Quads of @p text relative to its anchor, from the layout cache or
+   *        freshly laid out.
+   * @param size       Line height, or total width if @p fixedWidth.
+   */
+  const std::vector<float>& layout(const std::string& text, float winAspect, float size,
+                                   bool fixedWidth, Alignment a);
+  /** @brief Append laid-out @p quads moved to @p pos with @p color. */
+  void appendQuads(const std::vector<float>& quads, const Vec2& pos, const Vec4& color);
+  /** @brief Draw the collected quads unless batching. */
+  void flush();
 };
 
 /**
@@ -167,6 +209,16 @@ public:
   /** @brief Compose a new image containing the decimal representation of @p number. */
   Image render(uint32_t number) const;
 
+  /**
+   * @brief Like @ref render(), but repeated strings are served from an LRU
+   *        cache of rendered images instead of being blitted again.
+   * @return Reference valid until the next call (not thread-safe).
+   */
+  const Image& renderCached(const std::string& text) const;
+
+  /** @brief Memory budget of the @ref renderCached() images in bytes (default 4 MiB). */
+  void setCacheBudget(size_t bytes) {imageCache.setBudget(bytes);}
+
   /**
    * @brief Load character rectangles from a text file.
    * @param positionFilename Path to the positions file.
@@ -180,18 +232,44 @@ public:
    */
   std::string toCode(const std::string& varName) const;
 
+  /**
+   * @brief Pack all glyphs and their signed distance fields into one atlas.
+   *
+   * Glyphs are rendered and converted in parallel (OpenMP). CPU only, so it
+   * can also run offline to produce a cache file for @ref generateFontEngine.
+   */
+  FontAtlas generateAtlas() const;
+
+  /**
+   * @brief Hash of the font image, character boxes, and atlas parameters;
+   *        identifies the atlas produced by @ref generateAtlas().
+   */
+  uint64_t getSourceHash() const;
+
   /**
    * @brief Create a GPU font engine initialized from this bitmap font.
-   * @return Shared pointer to a @ref FontEngine with per-character textures.
+   * @return Shared pointer to a @ref FontEngine whose atlases hold all glyphs
+   *         and their signed distance fields.
    */
   std::shared_ptr<FontEngine> generateFontEngine() const;
 
+  /**
+   * @brief Create a GPU font engine, loading the atlas from @p cacheFile.
+   *
+   * If the file is missing or does not match this font (see
+   * @ref getSourceHash()), the atlas is generated and written to
+   * @p cacheFile for the next start. Failing to write it is not an error.
+   */
+  std::shared_ptr<FontEngine> generateFontEngine(const std::string& cacheFile) const;
+
 private:
   Image fontImage;                         ///< Atlas image containing all glyphs.
   std::vector<CharPosition> positions;     ///< Character rectangles in @ref fontImage.
+  std::array<uint16_t, 256> lookup;        ///< Index into @ref positions per character.
+  mutable LRUCache<Image> imageCache;      ///< Images returned by @ref renderCached().
 
   /**
-   * @brief Find the atlas rectangle for character @p c.
+   * @brief Find the atlas rectangle for character @p c (table lookup).
    * @return Reference to the matching @ref CharPosition; defaults to the first entry if absent.
    */
   const CharPosition& findElement(char c) const;
@@ -0,0 +1,74 @@
+#include "FramePipeline.h"
+#include "Trace.h"
+
+FramePipeline::FramePipeline(std::function<void()> stage) :
+  stage(stage),
+  pending(),
+  batch(),
+  busy(false),
+  quit(false),
+  error(),
+  thread()
+{
+  thread = std::thread(&FramePipeline::run, this);
+}
+
+FramePipeline::~FramePipeline() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]() {return !busy;});
+    quit = true;
+  }
+  kicked.notify_one();
+  thread.join();
+}
+
+void FramePipeline::post(std::function<void()> task) {
+  std::lock_guard<std::mutex> lock(mutex);
+  pending.push_back(std::move(task));
+}
+
+void FramePipeline::kick() {
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    batch.swap(pending);
+    busy = true;
+  }
+  kicked.notify_one();
+}
+
+void FramePipeline::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [this]() {return !busy;});
+  if (error) {
+    std::exception_ptr e = error;
+    error = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+void FramePipeline::run() {
+  TRACE_THREAD_NAME("simulation");
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    kicked.wait(lock, [this]() {return busy || quit;});
+    if (quit) return;
+
+    // the GL thread only touches the batch and the stage between stages
+    lock.unlock();
+    try {
+      for (const std::function<void()>& task : batch) task();
+      stage();
+    } catch (...) {
+      lock.lock();
+      error = std::current_exception();
+      lock.unlock();
+    }
+    batch.clear();
+
+    lock.lock();
+    busy = false;
+    finished.notify_all();
+  }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @file FramePipeline.h
+ * @brief Two-stage frame pipeline: a simulation thread prepares frame N+1
+ *        while the GL thread submits frame N.
+ *
+ * @ref FramePipeline owns the simulation thread and the handoff; the GL
+ * thread alternates @ref FramePipeline::wait() and @ref FramePipeline::kick()
+ * once per frame, so the two threads never work on the same frame and the
+ * simulation is at most one frame ahead. @ref FramePackets is the matching
+ * double buffer for the data handed from one stage to the other. See
+ * @ref GLApp::setPipelined() for the integration into the render loop.
+ */
+
+/**
+ * @brief Simulation thread running one stage per kick, plus a queue of tasks
+ *        (e.g. input events) executed on that thread before the next stage.
+ */
+class FramePipeline {
+public:
+  /**
+   * @brief Start the simulation thread.
+   * @param stage Work of one frame, run on the simulation thread per @ref kick().
+   */
+  explicit FramePipeline(std::function<void()> stage);
+  /** @brief Wait for a running stage and join the thread. */
+  ~FramePipeline();
+
+  FramePipeline(const FramePipeline&) = delete;
+  FramePipeline& operator=(const FramePipeline&) = delete;
+
+  /** @brief Queue @p task to run on the simulation thread before the next stage. */
+  void post(std::function<void()> task);
+
+  /**
+   * @brief Run the queued tasks and then the stage on the simulation thread.
+   *        Waits for the previous stage first if it is still running.
+   */
+  void kick();
+
+  /**
+   * @brief Block until the stage started by the last @ref kick() finished.
+   * @throw Any exception thrown by the stage or a task (rethrown here).
+   */
+  void wait();
+
+private:
+  std::function<void()> stage;
+  std::mutex mutex;
+  std::condition_variable kicked;
+  std::condition_variable finished;
+  std::vector<std::function<void()>> pending; ///< Tasks posted since the last kick.
+  std::vector<std::function<void()>> batch;   ///< Tasks of the running stage.
+  bool busy;
+  bool quit;
+  std::exception_ptr error;
+  std::thread thread;
+
+  void run();
+};
+
+/**
+ * @brief Double buffer of per-frame packets between the two pipeline stages.
+ *
+ * The simulation stage fills @ref back(); once it finished, the GL thread
+ * calls @ref swap() (in @ref GLApp::publishFrame()) and reads the now
+ * immutable @ref front() while the next packet is being written.
+ */
+template <typename Packet>
+class FramePackets {
+public:
+  /** @brief Packet being prepared (simulation thread). */
+  Packet& back() {return packets[1-frontIndex];}
+  /** @brief Packet being drawn (GL thread). */
+  const Packet& front() const {return packets[frontIndex];}
+  /** @brief Make the prepared packet the one being drawn. */
+  void swap() {frontIndex = 1-frontIndex;}
+
+private:
+  Packet packets[2]{};
+  int frontIndex{0};
+};
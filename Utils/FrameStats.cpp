@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "FrameStats.h"
+
+FrameStats::FrameStats(size_t capacity, double hitchThreshold) :
+  ring(std::max<size_t>(capacity, 1)),
+  next(0),
+  count(0),
+  frameCount(0),
+  hitchCount(0),
+  hitchThreshold(hitchThreshold),
+  averageFrameMs(0),
+  lastHitch(false)
+{
+}
+
+void FrameStats::record(const FrameSample& sample) {
+  // compare against the average before this frame is folded in,
+  // and let the average settle for a few frames after startup
+  lastHitch = frameCount > 8 && sample.frameMs > hitchThreshold * averageFrameMs;
+  if (lastHitch) hitchCount++;
+  averageFrameMs = (frameCount == 0) ? sample.frameMs
+                                     : 0.95 * averageFrameMs + 0.05 * sample.frameMs;
+
+  ring[next] = sample;
+  next = (next + 1) % ring.size();
+  count = std::min(count + 1, ring.size());
+  frameCount++;
+}
+
+void FrameStats::clear() {
+  next = 0;
+  count = 0;
+  frameCount = 0;
+  hitchCount = 0;
+  averageFrameMs = 0;
+  lastHitch = false;
+}
+
+std::vector<FrameSample> FrameStats::samples() const {
+  std::vector<FrameSample> result;
+  result.reserve(count);
+  const size_t first = (next + ring.size() - count) % ring.size();
+  for (size_t i = 0;i<count;++i) {
+    result.push_back(ring[(first + i) % ring.size()]);
+  }
+  return result;
+}
+
+static double metricValue(const FrameSample& s, FrameMetric metric) {
+  switch (metric) {
+    case FrameMetric::CPU :              return s.cpuMs;
+    case FrameMetric::SWAP :             return s.swapMs;
+    case FrameMetric::INPUT_TO_PRESENT : return s.inputToPresentMs;
+    default :                            return s.frameMs;
+  }
+}
+
+std::vector<double> FrameStats::sortedValues(FrameMetric metric) const {
+  std::vector<double> values;
+  values.reserve(count);
+  for (size_t i = 0;i<count;++i) {
+    const double v = metricValue(ring[i], metric);
+    if (v >= 0.0) values.push_back(v);
+  }
+  std::sort(values.begin(), values.end());
+  return values;
+}
+
+double FrameStats::percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0.0;
+  const double rank = std::ceil(p / 100.0 * double(sorted.size()));
+  const size_t index = size_t(std::clamp(rank, 1.0, double(sorted.size()))) - 1;
+  return sorted[index];
+}
+
+double FrameStats::percentile(double p, FrameMetric metric) const {
+  return percentile(sortedValues(metric), p);
+}
+
+FrameStats::Summary FrameStats::summary(FrameMetric metric) const {
+  const std::vector<double> sorted = sortedValues(metric);
+  return {percentile(sorted, 50.0), percentile(sorted, 95.0), percentile(sorted, 99.0),
+          sorted.empty() ? 0.0 : sorted.back(), sorted.size()};
+}
+
+std::vector<uint32_t> FrameStats::histogram(double binMs, size_t binCount, FrameMetric metric) const {
+  std::vector<uint32_t> bins(std::max<size_t>(binCount, 1), 0);
+  for (size_t i = 0;i<count;++i) {
+    const double v = metricValue(ring[i], metric);
+    if (v < 0.0) continue;
+    const size_t bin = std::min(size_t(v / binMs), bins.size()-1);
+    bins[bin]++;
+  }
+  return bins;
+}
+
+void FrameStats::writeCSV(std::ostream& out) const {
+  out << "frame,frame_ms,cpu_ms,swap_ms,input_to_present_ms\n";
+  const std::vector<FrameSample> s = samples();
+  const uint64_t firstFrame = frameCount - s.size();
+  for (size_t i = 0;i<s.size();++i) {
+    out << firstFrame + i << "," << s[i].frameMs << "," << s[i].cpuMs << ","
+        << s[i].swapMs << ",";
+    if (s[i].inputToPresentMs >= 0.0) out << s[i].inputToPresentMs;
+    out << "\n";
+  }
+}
+
+static void writeSummaryJSON(std::ostream& out, const FrameStats::Summary& s) {
+  out << "{\"p50\": " << s.p50 << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99
+      << ", \"max\": " << s.max << ", \"count\": " << s.count << "}";
+}
+
+void FrameStats::writeJSON(std::ostream& out) const {
+  out << "{\n";
+  out << "  \"frames\": " << frameCount << ",\n";
+  out << "  \"hitches\": " << hitchCount << ",\n";
+  out << "  \"hitch_threshold\": " << hitchThreshold << ",\n";
+  out << "  \"frame_ms\": ";         writeSummaryJSON(out, summary(FrameMetric::FRAME));            out << ",\n";
+  out << "  \"cpu_ms\": ";           writeSummaryJSON(out, summary(FrameMetric::CPU));              out << ",\n";
+  out << "  \"swap_ms\": ";          writeSummaryJSON(out, summary(FrameMetric::SWAP));             out << ",\n";
+  out << "  \"input_to_present_ms\": "; writeSummaryJSON(out, summary(FrameMetric::INPUT_TO_PRESENT)); out << ",\n";
+
+  out << "  \"histogram\": {\"bin_ms\": 1, \"counts\": [";
+  const std::vector<uint32_t> bins = histogram();
+  for (size_t i = 0;i<bins.size();++i) out << (i ? ", " : "") << bins[i];
+  out << "]},\n";
+
+  out << "  \"samples\": [\n";
+  const std::vector<FrameSample> s = samples();
+  for (size_t i = 0;i<s.size();++i) {
+    out << "    [" << s[i].frameMs << ", " << s[i].cpuMs << ", " << s[i].swapMs << ", ";
+    if (s[i].inputToPresentMs >= 0.0) out << s[i].inputToPresentMs; else out << "null";
+    out << "]" << (i+1 < s.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+}
+
+bool FrameStats::save(const std::string& filename) const {
+  if (filename == "-") {
+    writeJSON(std::cout);
+    return true;
+  }
+
+  std::ofstream file{filename};
+  if (!file) return false;
+  const bool json = filename.size() >= 5 && filename.compare(filename.size()-5, 5, ".json") == 0;
+  if (json)
+    writeJSON(file);
+  else
+    writeCSV(file);
+  return bool(file);
+}
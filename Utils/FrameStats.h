@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @file FrameStats.h
+ * @brief Ring buffer of per-frame timings with percentile, histogram, and hitch analysis.
+ *
+ * @ref GLEnv records one @ref FrameSample per presented frame. All queries
+ * operate on the samples currently held in the ring (the last
+ * @ref FrameStats::getCapacity() frames), so they describe a rolling window
+ * rather than the whole run. Hitches are counted over the whole run.
+ */
+
+/**
+ * @brief Timings of one frame in milliseconds.
+ */
+struct FrameSample {
+  double frameMs;          ///< Present-to-present interval.
+  double cpuMs;            ///< Time the application spent between frame start and present.
+  double swapMs;           ///< Time spent presenting (buffer swap + event polling / browser wait).
+  double inputToPresentMs; ///< Oldest unprocessed input event to present; negative if there was none.
+};
+
+/**
+ * @brief Selects one field of @ref FrameSample for the statistics queries.
+ */
+enum class FrameMetric {FRAME, CPU, SWAP, INPUT_TO_PRESENT};
+
+/**
+ * @brief Rolling frame-time statistics.
+ */
+class FrameStats {
+public:
+  /**
+   * @brief Summary of one metric over the rolling window.
+   */
+  struct Summary {
+    double p50; ///< Median.
+    double p95; ///< 95th percentile.
+    double p99; ///< 99th percentile.
+    double max; ///< Maximum.
+    size_t count; ///< Samples that contributed (input latency skips frames without input).
+  };
+
+  /**
+   * @brief Create an empty ring.
+   * @param capacity       Number of frames kept for the rolling statistics.
+   * @param hitchThreshold A frame is a hitch if it takes longer than this
+   *                       factor times the running average frame time.
+   */
+  FrameStats(size_t capacity=1024, double hitchThreshold=2.0);
+
+  /** @brief Append a frame, overwriting the oldest one when the ring is full. */
+  void record(const FrameSample& sample);
+  /** @brief Drop all samples and counters. */
+  void clear();
+
+  /** @brief Percentiles and maximum of @p metric. */
+  Summary summary(FrameMetric metric=FrameMetric::FRAME) const;
+  /** @brief Nearest-rank percentile @p p (0..100) of @p metric; 0 if empty. */
+  double percentile(double p, FrameMetric metric=FrameMetric::FRAME) const;
+
+  /**
+   * @brief Histogram of @p metric.
+   * @param binMs    Width of each bin in milliseconds.
+   * @param binCount Number of bins; the last bin also collects all larger values.
+   */
+  std::vector<uint32_t> histogram(double binMs=1.0, size_t binCount=50,
+                                  FrameMetric metric=FrameMetric::FRAME) const;
+
+  /** @brief Samples in chronological order (oldest first). */
+  std::vector<FrameSample> samples() const;
+
+  /** @name Hitch detection */
+  ///@{
+  /** @brief Number of hitches since the last @ref clear(). */
+  uint64_t getHitchCount() const {return hitchCount;}
+  /** @brief True if the most recent frame was a hitch. */
+  bool lastFrameWasHitch() const {return lastHitch;}
+  /** @brief Set the hitch factor relative to the running average frame time. */
+  void setHitchThreshold(double factor) {hitchThreshold = factor;}
+  double getHitchThreshold() const {return hitchThreshold;}
+  ///@}
+
+  /** @brief Total frames recorded since the last @ref clear(). */
+  uint64_t getFrameCount() const {return frameCount;}
+  /** @brief Ring size. */
+  size_t getCapacity() const {return ring.size();}
+
+  /** @name Export */
+  ///@{
+  /** @brief One CSV row per buffered frame. */
+  void writeCSV(std::ostream& out) const;
+  /** @brief Summaries, histogram, hitch count, and all buffered frames as JSON. */
+  void writeJSON(std::ostream& out) const;
+  /**
+   * @brief Write to @p filename as JSON (".json" suffix) or CSV (otherwise).
+   *
+   * The filename "-" writes JSON to stdout, which is the only useful target
+   * in Emscripten builds (it ends up in the browser console).
+   * @return False if the file could not be written.
+   */
+  bool save(const std::string& filename) const;
+  ///@}
+
+private:
+  std::vector<FrameSample> ring; ///< Sample storage (capacity entries).
+  size_t next;                   ///< Next write position in @ref ring.
+  size_t count;                  ///< Valid samples in @ref ring.
+  uint64_t frameCount;           ///< Frames recorded in total.
+  uint64_t hitchCount;           ///< Hitches detected in total.
+  double hitchThreshold;         ///< Hitch factor.
+  double averageFrameMs;         ///< Exponential moving average of frameMs.
+  bool lastHitch;                ///< Whether the latest frame was a hitch.
+
+  /** @brief Sorted values of @p metric (skipping frames without input for latency). */
+  std::vector<double> sortedValues(FrameMetric metric) const;
+  /** @brief Nearest-rank percentile of pre-sorted values. */
+  static double percentile(const std::vector<double>& sorted, double p);
+};
@@ -1,4 +1,8 @@
+#include <cstdlib>
+#include <algorithm>
+
 #include "GLApp.h"
+#include "Trace.h"
 
 #ifndef __EMSCRIPTEN__
 GLApp* GLApp::staticAppPtr = nullptr;
@@ -12,6 +16,7 @@ GLApp::GLApp(uint32_t w, uint32_t h, uint32_t s,
 #else
   glEnv{w,h,s,title,fpsCounter,sync,4,1,true},
 #endif
+  programBatch{},
   p{},
   mv{},
 #ifdef __EMSCRIPTEN__
@@ -259,7 +264,20 @@ GLApp::GLApp(uint32_t w, uint32_t h, uint32_t s,
   pointSprite{GL_LINEAR, GL_LINEAR,GL_CLAMP_TO_EDGE,GL_CLAMP_TO_EDGE},
   pointSpriteHighlight{GL_LINEAR, GL_LINEAR,GL_CLAMP_TO_EDGE,GL_CLAMP_TO_EDGE},
   resumeTime{0},
-  animationActive{true}
+  animationActive{true},
+  tickDuration{0},
+  maxTicksPerFrame{8},
+  lastAnimationTime{0},
+  tickAccumulator{0},
+  tickCount{0},
+  droppedTicks{0},
+  interpolationAlpha{1},
+  benchmark{GLBenchmark::fromEnvironment()},
+  benchmarkPassed{true},
+  pipelined{false},
+  pipeline{},
+  frameTime{0},
+  drawScale{1.0f}
 {
 #ifdef __EMSCRIPTEN__
   glEnv.setMouseCallbacks(cursorPositionCallback, mouseButtonCallback,
@@ -279,11 +297,21 @@ GLApp::GLApp(uint32_t w, uint32_t h, uint32_t s,
   // setup a minimal shader and buffer
   shaderUpdate();
 
+  if (benchmark) {
+    // scripted events replace user input, and frames run as fast as possible
 #ifdef __EMSCRIPTEN__
-  startTime = emscripten_performance_now()/1000.0;
+    glEnv.setMouseCallbacks(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+    glEnv.setKeyCallback(nullptr, nullptr);
 #else
-  startTime = glfwGetTime();
+    glEnv.setMouseCallbacks(nullptr, nullptr, nullptr);
+    glEnv.setKeyCallbacks(nullptr, nullptr);
 #endif
+    glEnv.setSync(false);
+    glEnv.setFrameLimit(benchmark->getTotalFrames());
+    benchmark->getReport().name = title;
+  }
+
+  startTime = getTime();
   Dimensions dim{ glEnv.getFramebufferSize() };
   glViewport(0, 0, GLsizei(dim.width), GLsizei(dim.height));
 }
@@ -327,24 +355,183 @@ void GLApp::resetPointHighlightTexture() {
 
 void GLApp::mainLoop() {
 #ifdef __EMSCRIPTEN__
-  if (animationActive) {
-    animate(emscripten_performance_now()/1000.0-startTime);
+  TRACE_SCOPE("frame");
+  glEnv.beginOfFrame();
+  GLProfiler::beginFrame();
+  beginBenchmarkFrame();
+  simulateFrame();
+  {
+    PROFILE_GPU("draw");
+    TRACE_SCOPE("draw");
+    drawFrame();
   }
-  draw();
-  glEnv.endOfFrame();
+  if (GLProfiler::isEnabled()) GLProfiler::drawHUD(getAspect());
+  captureBenchmarkFrame();
+  {
+    PROFILE_CPU("endOfFrame");
+    TRACE_SCOPE("endOfFrame");
+    glEnv.endOfFrame();
+  }
+  GLProfiler::endFrame();
+  endBenchmarkFrame();
 #else
   do {
-    if (animationActive) {
-      animate(glfwGetTime()-startTime);
+    TRACE_SCOPE("frame");
+    glEnv.beginOfFrame();
+    GLProfiler::beginFrame();
+    beginBenchmarkFrame();
+    simulateFrame();
+    {
+      PROFILE_GPU("draw");
+      TRACE_SCOPE("draw");
+      drawFrame();
     }
-    draw();
-    glEnv.endOfFrame();
+    if (GLProfiler::isEnabled()) GLProfiler::drawHUD(getAspect());
+    captureBenchmarkFrame();
+    {
+      PROFILE_CPU("endOfFrame");
+      TRACE_SCOPE("endOfFrame");
+      glEnv.endOfFrame();
+    }
+    GLProfiler::endFrame();
+    endBenchmarkFrame();
   } while (!glEnv.shouldClose());
+  // the stage may still be running and calls into the subclass
+  if (pipeline) pipeline->wait();
 #endif
 }
 
-void GLApp::run() {
-  init();
+void GLApp::drawFrame() {
+  if (drawTarget) {
+    const Dimensions full{ glEnv.getFramebufferSize() };
+    drawTarget->begin(full);
+    drawScale = float(drawTarget->getRenderSize().width) / float(std::max(full.width, 1u));
+    draw();
+    drawTarget->end();
+    drawScale = 1.0f;
+  } else {
+    draw();
+  }
+  drawUI();
+}
+
+void GLApp::setFixedTimestep(double ticksPerSecond, uint32_t maxTicksPerFrame) {
+  tickDuration = ticksPerSecond > 0 ? 1.0/ticksPerSecond : 0;
+  this->maxTicksPerFrame = std::max<uint32_t>(maxTicksPerFrame, 1);
+  // continue from the current animation time instead of catching up from 0
+  lastAnimationTime = getTime()-startTime;
+  tickAccumulator = 0;
+  tickCount = tickDuration > 0 ? uint64_t(lastAnimationTime/tickDuration) : 0;
+  interpolationAlpha = 1;
+}
+
+void GLApp::simulateFrame() {
+  if (!pipeline) {
+    PROFILE_CPU("animate");
+    TRACE_SCOPE("animate");
+    animateFrame();
+    return;
+  }
+  {
+    PROFILE_CPU("wait for simulation");
+    TRACE_SCOPE("wait for simulation");
+    pipeline->wait();
+  }
+  publishFrame();
+  frameTime = clockTime();
+  pipeline->kick();
+}
+
+void GLApp::dispatchInput(std::function<void()> event) {
+  if (pipeline) {
+    pipeline->post(std::move(event));
+  } else {
+    event();
+  }
+}
+
+void GLApp::animateFrame() {
+  if (!animationActive) return;
+  const double animationTime = getTime()-startTime;
+  if (tickDuration <= 0) {
+    animate(animationTime);
+    return;
+  }
+
+  tickAccumulator += std::max(0.0, animationTime-lastAnimationTime);
+  lastAnimationTime = animationTime;
+  uint64_t ticks = uint64_t(tickAccumulator/tickDuration);
+  if (ticks > maxTicksPerFrame) {
+    droppedTicks += ticks-maxTicksPerFrame;
+    tickAccumulator -= double(ticks-maxTicksPerFrame)*tickDuration;
+    ticks = maxTicksPerFrame;
+  }
+  for (uint64_t i = 0;i<ticks;++i) {
+    tickAccumulator -= tickDuration;
+    tickCount++;
+    animate(double(tickCount)*tickDuration);
+  }
+  interpolationAlpha = std::clamp(tickAccumulator/tickDuration, 0.0, 1.0);
+}
+
+void GLApp::beginBenchmarkFrame() {
+  if (!benchmark) return;
+  if (benchmark->isMeasurementStart()) {
+    glEnv.getFrameStats() = FrameStats(size_t(benchmark->getMeasuredFrames()));
+    benchmark->beginMeasurement();
+  }
+
+  for (const GLBenchmark::Event& e : benchmark->takeEvents()) {
+    glEnv.markInput();
+    switch (e.type) {
+      case GLBenchmark::Event::Type::KEY :
+        dispatchInput([=]() {keyboard(e.code, 0, e.action, 0);});
+        break;
+      case GLBenchmark::Event::Type::CHAR :
+        dispatchInput([=]() {keyboardChar(static_cast<unsigned int>(e.code));});
+        break;
+      case GLBenchmark::Event::Type::MOUSE_MOVE :
+        dispatchInput([=]() {mouseMove(e.x, e.y);});
+        break;
+      case GLBenchmark::Event::Type::MOUSE_BUTTON :
+        dispatchInput([=]() {mouseButton(e.code, e.action, 0, e.x, e.y);});
+        break;
+      case GLBenchmark::Event::Type::WHEEL :
+        dispatchInput([=]() {mouseWheel(e.x, e.y, 0, 0);});
+        break;
+    }
+  }
+}
+
+void GLApp::captureBenchmarkFrame() {
+  if (!benchmark || !benchmark->isLastFrame()) return;
+  benchmark->endMeasurement(glEnv.readFramebuffer().data);
+}
+
+void GLApp::endBenchmarkFrame() {
+  if (!benchmark) return;
+  if (benchmark->isLastFrame()) {
+    GLBenchmark::Report& report = benchmark->getReport();
+    const GLubyte* renderer = glGetString(GL_RENDERER);
+    report.renderer = renderer ? reinterpret_cast<const char*>(renderer) : "unknown";
+    report.backend  = glEnv.getBackend() == GLEnvBackend::HEADLESS ? "headless" : "window";
+    report.frameMs  = glEnv.getFrameStats().summary(FrameMetric::FRAME);
+    report.cpuMs    = glEnv.getFrameStats().summary(FrameMetric::CPU);
+    report.hitches  = glEnv.getFrameStats().getHitchCount();
+    benchmarkPassed = benchmark->finish();
+  }
+  benchmark->advance();
+}
+
+int GLApp::run() {
+  {
+    TRACE_SCOPE("init");
+    init();
+  }
+  {
+    TRACE_SCOPE("finish program batch");
+    programBatch.finish();
+  }
   const Dimensions dim{ glEnv.getFramebufferSize() };
   resize(GLsizei(dim.width), GLsizei(dim.height));
 
@@ -352,8 +539,20 @@ void GLApp::run() {
   emscripten_set_main_loop_arg(mainLoopWrapper, this, 0, 1);
   glEnv.setSync(glEnv.getSync());
 #else
+  if (pipelined) {
+    pipeline = std::make_unique<FramePipeline>([this]() {
+      TRACE_SCOPE("simulate");
+      animateFrame();
+      prepareFrame();
+    });
+    // the first frame draws a packet prepared before the loop
+    frameTime = clockTime();
+    pipeline->kick();
+  }
   mainLoop();
+  pipeline.reset();
 #endif
+  return benchmarkPassed ? EXIT_SUCCESS : EXIT_FAILURE;
 }
  
 void GLApp::resize(int width, int height) {
@@ -367,10 +566,10 @@ void GLApp::triangulate(const Vec3& p0,
                         const Vec3& p2, const Vec4& c2,
                         const Vec3& p3,
                         float lineThickness,
+                        const Dimensions& viewport,
                         std::vector<float>& trisData) {
 
-  const Dimensions dim{ glEnv.getFramebufferSize() };
-  const Vec3 scale{Vec3{2.0f/float(dim.width), 2.0f/float(dim.height), 1.0} * lineThickness};
+  const Vec3 scale{Vec3{2.0f/float(viewport.width), 2.0f/float(viewport.height), 1.0} * lineThickness};
 
   const Vec3 pDir = Vec3::normalize(p1-p0);
   const Vec3 cDir = Vec3::normalize(p2-p1);
@@ -415,6 +614,12 @@ void GLApp::drawLines(const std::vector<float>& data, LineDrawType t, float line
   simpleArray.bind();
 
   if (lineThickness > 1.0f) {
+    // offsets are relative to the viewport in use (the scaled target in
+    // draw(), the window in drawUI()); the thickness is in window pixels
+    GLint v[4];
+    GL(glGetIntegerv(GL_VIEWPORT, v));
+    const Dimensions viewport{uint32_t(std::max(v[2], 1)), uint32_t(std::max(v[3], 1))};
+    lineThickness *= drawScale;
     std::vector<float> trisData;
     
     switch (t) {
@@ -442,7 +647,7 @@ void GLApp::drawLines(const std::vector<float>& data, LineDrawType t, float line
             p3 = Vec3{data[i3*7+0],data[i3*7+1],data[i3*7+2]};
           }
 
-          triangulate(p0, p1, c1, p2, c2, p3, lineThickness, trisData);
+          triangulate(p0, p1, c1, p2, c2, p3, lineThickness, viewport, trisData);
         }
         break;
       case LineDrawType::STRIP :
@@ -460,7 +665,7 @@ void GLApp::drawLines(const std::vector<float>& data, LineDrawType t, float line
           const Vec4 c2{data[i2*7+3],data[i2*7+4],data[i2*7+5],data[i2*7+6]};
           const Vec3 p3{data[i3*7+0],data[i3*7+1],data[i3*7+2]};
 
-          triangulate(p0, p1, c1, p2, c2, p3, lineThickness, trisData);
+          triangulate(p0, p1, c1, p2, c2, p3, lineThickness, viewport, trisData);
         }
         break;
       case LineDrawType::LOOP :
@@ -478,7 +683,7 @@ void GLApp::drawLines(const std::vector<float>& data, LineDrawType t, float line
           const Vec4 c2{data[i2*7+3],data[i2*7+4],data[i2*7+5],data[i2*7+6]};
           const Vec3 p3{data[i3*7+0],data[i3*7+1],data[i3*7+2]};
 
-          triangulate(p0, p1, c1, p2, c2, p3, lineThickness, trisData);
+          triangulate(p0, p1, c1, p2, c2, p3, lineThickness, viewport, trisData);
         }
         break;
     }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
 
 #include "GLEnv.h"
@@ -7,6 +9,10 @@
 #include "GLArray.h"
 #include "GLBuffer.h"
 #include "GLTexture2D.h"
+#include "GLProfiler.h"
+#include "GLBenchmark.h"
+#include "FramePipeline.h"
+#include "GLDrawTarget.h"
 #include "Image.h"
 #include "GLAppKeyTranslation.h"
 
@@ -22,8 +28,18 @@
  *
  * The class also exposes helpers to compute pixel‑correct transforms for images
  * and to upload point‑sprite textures used by @ref drawPoints().
+ *
+ * Pressing F3 toggles the @ref GLProfiler HUD, which breaks the frame down
+ * into animate/draw/endOfFrame plus any PROFILE_CPU/PROFILE_GPU scopes
+ * placed in the subclass.
+ *
+ * With @ref setDynamicResolution(), @ref draw() renders into a target whose
+ * resolution follows the GPU load and is upscaled into the window;
+ * @ref drawUI() then draws on top at full resolution.
  */
 
+class DynamicResolution;
+
 /**
  * @brief Line primitive topology for @ref drawLines().
  */
@@ -75,11 +91,21 @@ public:
   /**
    * @brief Create the context/window and enter the render loop.
    *
-   * Calls @ref init(), then @ref resize() with the framebuffer size, and
+   * Calls @ref init(), waits for all programs submitted through
+   * @ref programBatch (reporting compile/link errors), then calls
+   * @ref resize() with the framebuffer size, and
    * finally enters the platform‑specific main loop that repeatedly calls
    * @ref animate() and @ref draw() until the window closes.
+   *
+   * If the environment variable \c GLAPP_BENCHMARK names a script (see
+   * @ref GLBenchmark.h), the run is a benchmark instead: vsync is off,
+   * animation time advances by a fixed timestep per frame, the script's input
+   * events replace user input, and after the warm-up and measured frames the
+   * report is written and compared against the baseline.
+   * @return \c EXIT_FAILURE if a benchmark regressed against its baseline,
+   *         \c EXIT_SUCCESS otherwise.
    */
-  void run();
+  int run();
 
   /**
    * @brief Enable/disable the animation step inside the main loop.
@@ -89,26 +115,14 @@ public:
    */
   void setAnimation(bool animationActive) {
     if (this->animationActive && !animationActive) {
-#ifdef __EMSCRIPTEN__
-      resumeTime = emscripten_performance_now()/1000.0;
-#else
-      resumeTime = glfwGetTime();
-#endif
+      resumeTime = getTime();
     }
 
     if (!this->animationActive && animationActive) {
       if (resumeTime == 0) {
-#ifdef __EMSCRIPTEN__
-        startTime = emscripten_performance_now()/1000.0;
-#else
-        startTime = glfwGetTime();
-#endif
+        startTime = getTime();
       } else {
-#ifdef __EMSCRIPTEN__
-        startTime += emscripten_performance_now()/1000.0-resumeTime;
-#else
-        startTime += glfwGetTime()-resumeTime;
-#endif
+        startTime += getTime()-resumeTime;
       }
     }
 
@@ -120,15 +134,104 @@ public:
   }
   /** @brief Reset the animation timer and invoke @ref animate(0). */
   void resetAnimation() {
-#ifdef __EMSCRIPTEN__
-    startTime = emscripten_performance_now()/1000.0;
-#else
-    startTime = glfwGetTime();
-#endif
+    startTime = getTime();
     resumeTime = 0;
+    lastAnimationTime = 0;
+    tickAccumulator = 0;
+    tickCount = 0;
     animate(0);
   }
 
+  /**
+   * @brief Run @ref animate() as a fixed-timestep simulation.
+   *
+   * Instead of once per frame with the current animation time,
+   * @ref animate() is then called once per tick of 1/@p ticksPerSecond
+   * seconds with that tick's simulation time, as often as needed to catch
+   * up with the animation clock (zero or more times per frame). A frame
+   * never runs more than @p maxTicksPerFrame ticks; time beyond that is
+   * dropped (see @ref getDroppedTicks()), so a simulation slower than real
+   * time runs in slow motion instead of falling further behind every frame.
+   *
+   * The rendered state lags the animation clock by up to one tick. For
+   * smooth motion at any frame rate, @ref draw() blends the previous and
+   * the current simulation state:
+   * @code
+   * void animate(double t) override {previous = current; current = simulate(current, getTickDuration());}
+   * void draw() override {render(lerp(previous, current, getInterpolationAlpha()));}
+   * @endcode
+   * @param ticksPerSecond   Simulation rate; 0 restores one call per frame.
+   * @param maxTicksPerFrame Catch-up limit per frame (at least 1).
+   */
+  void setFixedTimestep(double ticksPerSecond, uint32_t maxTicksPerFrame=8);
+  /** @brief True if @ref animate() runs at a fixed rate. */
+  bool hasFixedTimestep() const {return tickDuration > 0;}
+  /** @brief Seconds per simulation tick (0 without a fixed timestep). */
+  double getTickDuration() const {return tickDuration;}
+  /** @brief Ticks simulated since the start (or the last reset). */
+  uint64_t getTickCount() const {return tickCount;}
+  /** @brief Ticks skipped because a frame exceeded its catch-up limit. */
+  uint64_t getDroppedTicks() const {return droppedTicks;}
+  /**
+   * @brief Time elapsed since the last tick as a fraction of a tick, in [0,1].
+   *        Always 1 without a fixed timestep.
+   */
+  double getInterpolationAlpha() const {return interpolationAlpha;}
+
+  /**
+   * @brief Run input handling and @ref animate() on a simulation thread,
+   *        one frame ahead of @ref draw() on the GL thread.
+   *
+   * While the GL thread draws and presents frame N, the simulation thread
+   * processes the input events and runs @ref animate() for frame N+1. This
+   * adds one frame of latency and overlaps the two stages on multi-core
+   * machines. The stages exchange data only through @ref prepareFrame() and
+   * @ref publishFrame(), typically with a @ref FramePackets buffer:
+   * @code
+   * struct Packet {Mat4 view; std::vector<Mat4> transforms;};
+   * FramePackets<Packet> packets;
+   * void animate(double t) override {  update the simulation  }
+   * void prepareFrame() override {packets.back() = {camera.view(), transforms};}
+   * void publishFrame() override {packets.swap();}
+   * void draw() override {const Packet& p = packets.front();  draw p  }
+   * @endcode
+   * In this mode, the input hooks, @ref animate(), and @ref prepareFrame()
+   * must not call OpenGL or touch state read by @ref draw(); @ref resize()
+   * still runs on the GL thread. @ref getTime() returns the time of the
+   * current frame on both threads. Call before @ref run(), e.g. in the
+   * constructor. Ignored on Emscripten, where the browser drives the loop.
+   */
+  void setPipelined(bool pipelined) {this->pipelined = pipelined;}
+  /** @brief True if @ref setPipelined() was requested. */
+  bool isPipelined() const {return pipelined;}
+
+  /**
+   * @brief Render @ref draw() at a resolution that keeps its GPU time
+   *        within a budget (see @ref DynamicResolution).
+   *
+   * The scaled image is upscaled into the window before @ref drawUI() and
+   * the profiler HUD. Code in @ref draw() that sets the viewport itself,
+   * e.g. after rendering to a texture, must use @ref getRenderSize().
+   * Call after the context exists, e.g. in @ref init(). The upscaling
+   * filter and other settings are changed through @ref getDynamicResolution().
+   * Both are defined in DynamicResolution.cpp, so only demos using them need
+   * to build it.
+   * @param budgetMs GPU time allowed for @ref draw() per frame; 0 renders at
+   *                 window resolution again.
+   * @param minScale Lowest resolution scale per axis.
+   * @param maxScale Highest resolution scale per axis.
+   */
+  void setDynamicResolution(double budgetMs, float minScale=0.5f, float maxScale=1.0f);
+  /** @brief The dynamic resolution controller, or nullptr if disabled. */
+  DynamicResolution* getDynamicResolution() const;
+  /**
+   * @brief Size @ref draw() renders at: the scaled size with dynamic
+   *        resolution, the framebuffer size otherwise.
+   */
+  Dimensions getRenderSize() const {
+    return drawTarget ? drawTarget->getRenderSize() : glEnv.getFramebufferSize();
+  }
+
   /**
    * @brief Current window aspect ratio (width/height).
    */
@@ -187,7 +290,8 @@ public:
    * @brief Draw colored lines using the given topology.
    * @param data           Interleaved vertices (x,y,z,r,g,b,a) → 7 floats.
    * @param t              Topology: LIST/STRIP/LOOP.
-   * @param lineThickness  If >1, thick lines are triangulated in screen space.
+   * @param lineThickness  If >1, thick lines are triangulated in screen space;
+   *                       in window pixels, also with dynamic resolution.
    */
   void drawLines(const std::vector<float>& data, LineDrawType t, float lineThickness=1.0f);
 
@@ -251,10 +355,28 @@ public:
   virtual void init() {}
   /** @brief Per‑frame draw hook. */
   virtual void draw() {}
-  /** @brief Per‑frame animation/update hook; parameter is seconds since start. */
+  /**
+   * @brief Per‑frame hook after @ref draw() for overlays (text, HUDs);
+   *        always at full window resolution.
+   */
+  virtual void drawUI() {}
+  /**
+   * @brief Per‑frame animation/update hook; parameter is seconds since start.
+   *        With @ref setFixedTimestep() it runs once per tick instead.
+   */
   virtual void animate(double animationTime) {}
   /** @brief Resize notification; override to update projection, etc. */
   virtual void resize(int width, int height);
+  /**
+   * @brief Pipelined mode: capture what @ref draw() needs from the
+   *        simulation (simulation thread, after @ref animate()).
+   */
+  virtual void prepareFrame() {}
+  /**
+   * @brief Pipelined mode: make the prepared frame the one @ref draw() reads
+   *        (GL thread, while the simulation thread is idle).
+   */
+  virtual void publishFrame() {}
 
   // ===== Input hooks (override in subclasses) =====
   /** @brief Keyboard event; parameters mirror backend callbacks. */
@@ -270,6 +392,7 @@ public:
 
 protected:
   GLEnv glEnv;                 ///< Window/context + platform utilities.
+  GLProgramBatch programBatch; ///< Compiles stock and demo programs in parallel until @ref init() returns.
   Mat4 p;                      ///< Projection matrix used by stock shaders.
   Mat4 mv;                     ///< Model‑view matrix used by stock shaders.
   Mat4 mvi;                    ///< Inverse of @ref mv (for lighting helpers).
@@ -296,16 +419,60 @@ protected:
   /** @brief Request closing the window. */
   void closeWindow() { glEnv.setClose(); }
 
+  /**
+   * @brief Application time in seconds: wall clock, or frame index times the
+   *        fixed timestep in benchmark runs. Use this instead of a system
+   *        timer to keep benchmarks deterministic. When pipelined, the time
+   *        at the start of the current frame.
+   */
+  double getTime() const {
+    return pipeline ? frameTime : clockTime();
+  }
+
 private:
   bool animationActive;   ///< Whether @ref animate() runs each frame.
   TrisDrawType lastTrisType; ///< Cached last triangle topology.
   GLsizei lastTrisCount;  ///< Cached last vertex count for triangles.
   bool lastLighting;      ///< Cached last lighting flag.
   double startTime;       ///< Start timestamp for animation.
+  double tickDuration;    ///< Fixed timestep in seconds, 0 for one animate() per frame.
+  uint32_t maxTicksPerFrame; ///< Catch-up limit of the fixed timestep.
+  double lastAnimationTime;  ///< Animation time of the previous frame.
+  double tickAccumulator;    ///< Animation time not yet simulated.
+  uint64_t tickCount;        ///< Ticks simulated so far.
+  uint64_t droppedTicks;     ///< Ticks skipped by the catch-up limit.
+  double interpolationAlpha; ///< See @ref getInterpolationAlpha().
+  std::unique_ptr<GLBenchmark> benchmark; ///< Active benchmark run (nullptr otherwise).
+  bool benchmarkPassed;   ///< Result of the baseline comparison.
+  bool pipelined;         ///< Requested through @ref setPipelined().
+  std::unique_ptr<FramePipeline> pipeline; ///< Simulation thread while running pipelined.
+  double frameTime;       ///< @ref getTime() of the current frame when pipelined.
+  std::unique_ptr<GLDrawTarget> drawTarget; ///< Set by @ref setDynamicResolution().
+  float drawScale;         ///< Render scale per axis while @ref draw() runs scaled, 1 otherwise.
 
   /** @brief Platform‑specific main loop implementation. */
   void mainLoop();
 
+  /** @brief Call @ref animate() once, or once per due tick with a fixed timestep. */
+  void animateFrame();
+  /** @brief Draw stage: @ref draw() (scaled with dynamic resolution), then @ref drawUI(). */
+  void drawFrame();
+  /** @brief Simulation stage (animate, or hand over to the simulation thread). */
+  void simulateFrame();
+  /** @brief Run an input hook now, or queue it for the simulation thread. */
+  void dispatchInput(std::function<void()> event);
+  /** @brief Wall clock or benchmark time. */
+  double clockTime() const {
+    return benchmark ? benchmark->getTime() : glEnv.getTime();
+  }
+
+  /** @brief Benchmark: start measuring and replay the script's events for this frame. */
+  void beginBenchmarkFrame();
+  /** @brief Benchmark: capture the final frame (before it is presented). */
+  void captureBenchmarkFrame();
+  /** @brief Benchmark: advance the frame clock and report after the last frame. */
+  void endBenchmarkFrame();
+
 #ifdef __EMSCRIPTEN__
   /** @brief Wrapper for Emscripten's C‑style main loop callback. */
   static void mainLoopWrapper(void* arg) {
@@ -397,7 +564,10 @@ private:
     // TODO: handle modifiers properly
     GLApp* glApp = static_cast<GLApp*>(userData);
     if (!glApp) return EM_FALSE;
+    glApp->glEnv.markInput();
     const int keyCode = map_key_string_to_code(keyEvent->code);
+    if (eventType == EMSCRIPTEN_EVENT_KEYDOWN && keyCode == GLENV_KEY_F3)
+      GLProfiler::setEnabled(!GLProfiler::isEnabled());
     if (eventType == EMSCRIPTEN_EVENT_KEYDOWN)
       glApp->keyboardChar(keyCode);
     glApp->keyboard(keyCode, keyCode, eventType, map_modifiers_to_bitfield(keyEvent));
@@ -408,6 +578,7 @@ private:
   static bool cursorPositionCallback(int eventType, const EmscriptenMouseEvent *mouseEvent, void *userData) {
     GLApp* glApp = static_cast<GLApp*>(userData);
     if (!glApp) return EM_FALSE;
+    glApp->glEnv.markInput();
 
     glApp->xMousePos = mouseEvent->targetX;
     glApp->yMousePos = mouseEvent->targetY;
@@ -419,6 +590,7 @@ private:
   static bool mouseButtonUpCallback(int eventType, const EmscriptenMouseEvent *mouseEvent, void *userData) {
     GLApp* glApp = static_cast<GLApp*>(userData);
     if (!glApp) return EM_FALSE;
+    glApp->glEnv.markInput();
 
     glApp->mouseButton(mouseEvent->button, GLFW_RELEASE, 0, glApp->xMousePos, glApp->yMousePos);
     return EM_TRUE;
@@ -427,6 +599,7 @@ private:
   static bool mouseButtonDownCallback(int eventType, const EmscriptenMouseEvent *mouseEvent, void *userData) {
     GLApp* glApp = static_cast<GLApp*>(userData);
     if (!glApp) return EM_FALSE;
+    glApp->glEnv.markInput();
 
     glApp->mouseButton(mouseEvent->button, GLFW_PRESS, 0, glApp->xMousePos, glApp->yMousePos);
     return EM_TRUE;
@@ -435,6 +608,7 @@ private:
   static bool mouseButtonCallback(int eventType, const EmscriptenMouseEvent *mouseEvent, void *userData) {
     GLApp* glApp = static_cast<GLApp*>(userData);
     if (!glApp) return EM_FALSE;
+    glApp->glEnv.markInput();
 
     glApp->mouseButton(mouseEvent->button, 0, 0, glApp->xMousePos, glApp->yMousePos);
     return EM_TRUE;
@@ -443,6 +617,7 @@ private:
   static bool scrollCallback(int eventType, const EmscriptenWheelEvent *wheelEvent, void *userData) {
     GLApp* glApp = static_cast<GLApp*>(userData);
     if (!glApp) return EM_FALSE;
+    glApp->glEnv.markInput();
 
     // TODO
 
@@ -457,22 +632,29 @@ private:
   }
   /** @brief Key action callback (GLFW). */
   static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    if (staticAppPtr) staticAppPtr->keyboard(key, scancode, action, mods);
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+      GLProfiler::setEnabled(!GLProfiler::isEnabled());
+    if (!staticAppPtr) return;
+    staticAppPtr->glEnv.markInput();
+    staticAppPtr->dispatchInput([=]() {staticAppPtr->keyboard(key, scancode, action, mods);});
   }
   /** @brief Unicode character callback (GLFW). */
   static void keyCharCallback(GLFWwindow* window, unsigned int codepoint) {
-    if (staticAppPtr) staticAppPtr->keyboardChar(codepoint);
+    if (staticAppPtr) staticAppPtr->dispatchInput([=]() {staticAppPtr->keyboardChar(codepoint);});
   }
   /** @brief Mouse move callback (GLFW). */
   static void cursorPositionCallback(GLFWwindow* window, double xPosition, double yPosition) {
-    if (staticAppPtr) staticAppPtr->mouseMove(xPosition, yPosition);
+    if (!staticAppPtr) return;
+    staticAppPtr->glEnv.markInput();
+    staticAppPtr->dispatchInput([=]() {staticAppPtr->mouseMove(xPosition, yPosition);});
   }
   /** @brief Mouse button callback (GLFW). */
   static void mouseButtonCallback(GLFWwindow* window, int button, int state, int mods) {
     if (staticAppPtr) {
       double xpos, ypos;
       glfwGetCursorPos(window, &xpos, &ypos);
-      staticAppPtr->mouseButton(button, state, mods, xpos, ypos);
+      staticAppPtr->glEnv.markInput();
+      staticAppPtr->dispatchInput([=]() {staticAppPtr->mouseButton(button, state, mods, xpos, ypos);});
     }
   }
   /** @brief Scroll callback (GLFW). */
@@ -480,7 +662,8 @@ private:
     if (staticAppPtr) {
       double xpos, ypos;
       glfwGetCursorPos(window, &xpos, &ypos);
-      staticAppPtr->mouseWheel(x_offset, y_offset, xpos, ypos);
+      staticAppPtr->glEnv.markInput();
+      staticAppPtr->dispatchInput([=]() {staticAppPtr->mouseWheel(x_offset, y_offset, xpos, ypos);});
     }
   }
 #endif
@@ -494,6 +677,7 @@ private:
    * @param c2 Next color.
    * @param p3 Next point (for correct joins).
    * @param lineThickness Thickness in pixels.
+   * @param viewport Size of the current viewport the pixels refer to.
    * @param trisData Output buffer appended with interleaved vertices (pos+color).
    */
   void triangulate(const Vec3& p0,
@@ -501,5 +685,6 @@ private:
                    const Vec3& p2, const Vec4& c2,
                    const Vec3& p3,
                    float lineThickness,
+                   const Dimensions& viewport,
                    std::vector<float>& trisData);
 };
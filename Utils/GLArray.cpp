@@ -13,6 +13,10 @@ void GLArray::bind() const {
 	GL(glBindVertexArray(glId));
 }
 
+void GLArray::setLabel(const std::string& label) const {
+	GLDebugOutput::label(GL_VERTEX_ARRAY, glId, label);
+}
+
 void GLArray::connectVertexAttrib(const GLBuffer& buffer,
                                   const GLProgram& program,
                                   const std::string& variable,
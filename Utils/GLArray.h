@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include <GL/glew.h>
@@ -33,6 +34,12 @@ public:
    */
   void bind() const;
 
+  /**
+   * @brief Name the vertex array in driver debug messages and GPU debuggers.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label) const;
+
   /**
    * @brief Connect a vertex attribute from a buffer to a program input.
    * @param buffer    Source buffer holding interleaved attribute data.
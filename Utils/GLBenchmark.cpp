@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "GLEnv.h"
+#include "GLAppKeyTranslation.h"
+#include "GLBenchmark.h"
+
+GLBenchmark::GLBenchmark(const std::string& scriptFile) :
+  scriptFile(scriptFile),
+  warmupFrames(60),
+  measuredFrames(600),
+  timestep(1.0/60.0),
+  events(),
+  nextEvent(0),
+  frame(0),
+  reportFile("-"),
+  baselineFile(),
+  tolerance(0.1),
+  measureStart(),
+  report()
+{
+  std::ifstream file{scriptFile};
+  if (!file) throw BenchmarkException{"Unable to open benchmark script " + scriptFile};
+  parse(file);
+
+  report.script       = scriptFile;
+  report.warmupFrames = warmupFrames;
+  report.frames       = measuredFrames;
+  report.timestep     = timestep;
+}
+
+std::unique_ptr<GLBenchmark> GLBenchmark::fromEnvironment() {
+  const char* script = std::getenv("GLAPP_BENCHMARK");
+  if (!script || !*script) return nullptr;
+
+  std::unique_ptr<GLBenchmark> benchmark = std::make_unique<GLBenchmark>(script);
+  if (const char* report = std::getenv("GLAPP_BENCHMARK_REPORT"))
+    benchmark->setReportFile(report);
+  if (const char* baseline = std::getenv("GLAPP_BENCHMARK_BASELINE"))
+    benchmark->setBaselineFile(baseline);
+  if (const char* tolerance = std::getenv("GLAPP_BENCHMARK_TOLERANCE"))
+    benchmark->setTolerance(std::atof(tolerance));
+  return benchmark;
+}
+
+static int parseKey(const std::string& name) {
+  if (name.size() == 1 && name[0] >= 'A' && name[0] <= 'Z') return GLENV_KEY_A + (name[0]-'A');
+  if (name.size() == 1 && name[0] >= 'a' && name[0] <= 'z') return GLENV_KEY_A + (name[0]-'a');
+  if (name.size() == 1 && name[0] >= '0' && name[0] <= '9') return GLENV_KEY_0 + (name[0]-'0');
+  if (name.size() >= 2 && name[0] == 'F' && isdigit(name[1])) {
+    const int n = std::atoi(name.c_str()+1);
+    if (n >= 1 && n <= 12) return GLENV_KEY_F1 + (n-1);
+  }
+  if (name == "SPACE")  return GLENV_KEY_SPACE;
+  if (name == "ESCAPE") return GLENV_KEY_ESCAPE;
+  if (name == "ENTER")  return GLENV_KEY_ENTER;
+  if (name == "LEFT")   return GLENV_KEY_LEFT;
+  if (name == "RIGHT")  return GLENV_KEY_RIGHT;
+  if (name == "UP")     return GLENV_KEY_UP;
+  if (name == "DOWN")   return GLENV_KEY_DOWN;
+
+  char* end{nullptr};
+  const long code = std::strtol(name.c_str(), &end, 10);
+  if (end == name.c_str() || *end != 0) return -1;
+  return int(code);
+}
+
+static int parseButton(const std::string& name) {
+  if (name == "left")   return GLENV_MOUSE_BUTTON_LEFT;
+  if (name == "right")  return GLENV_MOUSE_BUTTON_RIGHT;
+  if (name == "middle") return GLENV_MOUSE_BUTTON_MIDDLE;
+  return -1;
+}
+
+void GLBenchmark::parse(std::istream& in) {
+  std::string line;
+  size_t lineNumber = 0;
+  while (std::getline(in, line)) {
+    lineNumber++;
+    line = line.substr(0, line.find('#'));
+    std::stringstream s{line};
+    std::string first;
+    if (!(s >> first)) continue;
+
+    auto error = [&](const std::string& what) {
+      std::stringstream msg;
+      msg << scriptFile << ":" << lineNumber << ": " << what;
+      throw BenchmarkException{msg.str()};
+    };
+
+    if (first == "warmup") {
+      if (!(s >> warmupFrames)) error("expected a frame count");
+      continue;
+    }
+    if (first == "frames") {
+      if (!(s >> measuredFrames) || measuredFrames == 0) error("expected a positive frame count");
+      continue;
+    }
+    if (first == "timestep") {
+      if (!(s >> timestep) || timestep <= 0) error("expected a positive timestep");
+      continue;
+    }
+
+    Event e{};
+    char* end{nullptr};
+    e.frame = std::strtoull(first.c_str(), &end, 10);
+    if (end == first.c_str() || *end != 0) error("unknown setting " + first);
+
+    std::string command;
+    s >> command;
+    if (command == "key") {
+      std::string key, action;
+      if (!(s >> key >> action)) error("expected: key <name> press|release");
+      e.type   = Event::Type::KEY;
+      e.code   = parseKey(key);
+      e.action = action == "press" ? GLENV_PRESS : GLENV_RELEASE;
+      if (e.code < 0) error("unknown key " + key);
+      if (action != "press" && action != "release") error("unknown key action " + action);
+      events.push_back(e);
+    } else if (command == "char") {
+      e.type = Event::Type::CHAR;
+      if (!(s >> e.code)) error("expected: char <codepoint>");
+      events.push_back(e);
+    } else if (command == "move") {
+      e.type = Event::Type::MOUSE_MOVE;
+      if (!(s >> e.x >> e.y)) error("expected: move <x> <y>");
+      events.push_back(e);
+    } else if (command == "button") {
+      std::string button, action;
+      if (!(s >> button >> action >> e.x >> e.y)) error("expected: button <left|right|middle> press|release <x> <y>");
+      e.type   = Event::Type::MOUSE_BUTTON;
+      e.code   = parseButton(button);
+      e.action = action == "press" ? GLENV_MOUSE_PRESS : GLENV_MOUSE_RELEASE;
+      if (e.code < 0) error("unknown mouse button " + button);
+      events.push_back(e);
+    } else if (command == "wheel") {
+      e.type = Event::Type::WHEEL;
+      if (!(s >> e.x >> e.y)) error("expected: wheel <dx> <dy>");
+      events.push_back(e);
+    } else if (command == "drag") {
+      std::string button;
+      double x0, y0, x1, y1;
+      uint64_t duration;
+      if (!(s >> button >> x0 >> y0 >> x1 >> y1 >> duration) || duration == 0)
+        error("expected: drag <left|right|middle> <x0> <y0> <x1> <y1> <frames>");
+      const int code = parseButton(button);
+      if (code < 0) error("unknown mouse button " + button);
+
+      events.push_back(Event{e.frame, Event::Type::MOUSE_MOVE, 0, 0, x0, y0});
+      events.push_back(Event{e.frame, Event::Type::MOUSE_BUTTON, code, GLENV_MOUSE_PRESS, x0, y0});
+      for (uint64_t i = 1;i<=duration;++i) {
+        const double t = double(i)/double(duration);
+        events.push_back(Event{e.frame+i, Event::Type::MOUSE_MOVE, 0, 0,
+                               x0+(x1-x0)*t, y0+(y1-y0)*t});
+      }
+      events.push_back(Event{e.frame+duration, Event::Type::MOUSE_BUTTON, code, GLENV_MOUSE_RELEASE, x1, y1});
+    } else {
+      error("unknown command " + command);
+    }
+  }
+
+  std::stable_sort(events.begin(), events.end(),
+                   [](const Event& a, const Event& b) {return a.frame < b.frame;});
+}
+
+std::vector<GLBenchmark::Event> GLBenchmark::takeEvents() {
+  std::vector<Event> result;
+  while (nextEvent < events.size() && events[nextEvent].frame <= frame) {
+    result.push_back(events[nextEvent]);
+    nextEvent++;
+  }
+  return result;
+}
+
+void GLBenchmark::beginMeasurement() {
+  GLCallCounter::reset();
+  measureStart = std::chrono::steady_clock::now();
+}
+
+void GLBenchmark::endMeasurement(const std::vector<uint8_t>& finalFrame) {
+  report.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - measureStart).count();
+  report.glCallsPerFrame   = double(GLCallCounter::calls) / double(measuredFrames);
+  report.drawCallsPerFrame = double(GLCallCounter::drawCalls) / double(measuredFrames);
+  if (!finalFrame.empty()) report.finalFrameHash = hash(finalFrame);
+}
+
+std::string GLBenchmark::hash(const std::vector<uint8_t>& data) {
+  uint64_t h = 14695981039346656037ull;
+  for (uint8_t b : data) {
+    h ^= b;
+    h *= 1099511628211ull;
+  }
+  std::stringstream s;
+  s << std::hex << std::setw(16) << std::setfill('0') << h;
+  return s.str();
+}
+
+static void writeString(std::ostream& out, const std::string& str) {
+  out << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') out << '\\';
+    if (static_cast<unsigned char>(c) >= 0x20) out << c;
+  }
+  out << '"';
+}
+
+static void writeSummary(std::ostream& out, const std::string& prefix, const FrameStats::Summary& s) {
+  out << "  \"" << prefix << "_p50\": " << s.p50 << ",\n"
+      << "  \"" << prefix << "_p95\": " << s.p95 << ",\n"
+      << "  \"" << prefix << "_p99\": " << s.p99 << ",\n"
+      << "  \"" << prefix << "_max\": " << s.max << ",\n";
+}
+
+void GLBenchmark::writeJSON(std::ostream& out, const Report& report) {
+  // flat on purpose, so that baselines can be read back without a JSON parser
+  out << "{\n";
+  out << "  \"name\": ";     writeString(out, report.name);     out << ",\n";
+  out << "  \"script\": ";   writeString(out, report.script);   out << ",\n";
+  out << "  \"renderer\": "; writeString(out, report.renderer); out << ",\n";
+  out << "  \"backend\": ";  writeString(out, report.backend);  out << ",\n";
+  out << "  \"warmup_frames\": " << report.warmupFrames << ",\n";
+  out << "  \"frames\": " << report.frames << ",\n";
+  out << "  \"timestep\": " << report.timestep << ",\n";
+  out << "  \"wall_ms\": " << report.wallMs << ",\n";
+  writeSummary(out, "frame_ms", report.frameMs);
+  writeSummary(out, "cpu_ms", report.cpuMs);
+  out << "  \"hitches\": " << report.hitches << ",\n";
+  out << "  \"gl_calls_per_frame\": " << report.glCallsPerFrame << ",\n";
+  out << "  \"draw_calls_per_frame\": " << report.drawCallsPerFrame << ",\n";
+  out << "  \"final_frame_hash\": "; writeString(out, report.finalFrameHash); out << "\n";
+  out << "}\n";
+}
+
+/** Value of "key" in a flat JSON object as written by writeJSON (quotes removed). */
+static bool findValue(const std::string& json, const std::string& key, std::string& value) {
+  const std::string pattern = "\"" + key + "\":";
+  const size_t pos = json.find(pattern);
+  if (pos == std::string::npos) return false;
+  size_t start = json.find_first_not_of(" \t", pos + pattern.size());
+  if (start == std::string::npos) return false;
+  if (json[start] == '"') {
+    const size_t end = json.find('"', start+1);
+    value = json.substr(start+1, end-start-1);
+  } else {
+    const size_t end = json.find_first_of(",}\n", start);
+    value = json.substr(start, end-start);
+  }
+  return true;
+}
+
+static bool findNumber(const std::string& json, const std::string& key, double& value) {
+  std::string text;
+  if (!findValue(json, key, text)) return false;
+  value = std::atof(text.c_str());
+  return true;
+}
+
+bool GLBenchmark::finish() const {
+  if (reportFile.empty() || reportFile == "-") {
+    writeJSON(std::cout, report);
+  } else {
+    std::ofstream file{reportFile};
+    if (file) writeJSON(file, report);
+    if (!file) std::cerr << "Unable to write benchmark report to " << reportFile << std::endl;
+  }
+
+  if (baselineFile.empty()) return true;
+  std::ifstream file{baselineFile};
+  if (!file) {
+    std::cout << "No benchmark baseline at " << baselineFile << ", skipping comparison" << std::endl;
+    return true;
+  }
+  const std::string baseline{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+  // the comparison formats numbers its own way; leave std::cout as it was
+  std::ios coutFormat{nullptr};
+  coutFormat.copyfmt(std::cout);
+
+  bool passed = true;
+  std::cout << std::fixed << std::setprecision(3)
+            << "Benchmark " << report.name << " vs. " << baselineFile << "\n";
+
+  // only frame times decide the result; other times are reported for context
+  auto compareTime = [&](const std::string& key, double current, bool decides) {
+    double base{0};
+    if (!findNumber(baseline, key, base) || base <= 0) return;
+    const double change = current/base - 1.0;
+    const bool regressed = change > tolerance;
+    if (decides) passed = passed && !regressed;
+    std::cout << "  " << std::left << std::setw(22) << key << std::right
+              << std::setw(10) << base << " -> " << std::setw(10) << current
+              << "  (" << std::showpos << std::setprecision(1) << 100.0*change << std::noshowpos
+              << std::setprecision(3) << "%)"
+              << (regressed ? (decides ? "  REGRESSION" : "  slower") : "") << "\n";
+  };
+  compareTime("frame_ms_p50", report.frameMs.p50, true);
+  compareTime("frame_ms_p95", report.frameMs.p95, true);
+  compareTime("cpu_ms_p50",   report.cpuMs.p50, false);
+
+  auto compareCount = [&](const std::string& key, double current) {
+    double base{0};
+    if (!findNumber(baseline, key, base)) return;
+    std::cout << "  " << std::left << std::setw(22) << key << std::right
+              << std::setw(10) << base << " -> " << std::setw(10) << current
+              << (base != current ? "  changed" : "") << "\n";
+  };
+  compareCount("gl_calls_per_frame",   report.glCallsPerFrame);
+  compareCount("draw_calls_per_frame", report.drawCallsPerFrame);
+
+  std::string baseHash;
+  if (findValue(baseline, "final_frame_hash", baseHash) && !baseHash.empty() && !report.finalFrameHash.empty())
+    std::cout << "  final frame           " << (baseHash == report.finalFrameHash ? "identical" : "changed") << "\n";
+
+  std::cout << (passed ? "  PASSED" : "  FAILED") << " (tolerance " << std::setprecision(0)
+            << 100.0*tolerance << "%)" << std::endl;
+  std::cout.copyfmt(coutFormat);
+  return passed;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "FrameStats.h"
+
+/**
+ * @file GLBenchmark.h
+ * @brief Deterministic benchmark runs of @ref GLApp demos: scripted input,
+ *        fixed timestep, machine-readable report, and baseline comparison.
+ *
+ * A benchmark is described by a small text script. Settings lines configure
+ * the run; event lines (starting with a frame number) are replayed through
+ * the application's input hooks at the start of that frame:
+ * @code
+ * # settings
+ * warmup   60          # frames rendered before measuring
+ * frames   600         # measured frames
+ * timestep 0.0166667   # animation seconds per frame
+ *
+ * # events: <frame> <command> <arguments>
+ * 0   key   SPACE press      # key names: A-Z, 0-9, F1-F12, SPACE, ESCAPE,
+ * 0   key   SPACE release    # ENTER, LEFT, RIGHT, UP, DOWN, or a key code
+ * 30  char  65
+ * 60  drag  left 400 300 600 300 120   # button x0 y0 x1 y1 duration (frames)
+ * 200 move  420 310
+ * 200 button right press 420 310
+ * 240 wheel 0 -1
+ * @endcode
+ * \c drag is the building block for camera paths: it presses the button at
+ * (x0,y0), moves linearly to (x1,y1) over \c duration frames, and releases.
+ *
+ * @ref GLApp runs a benchmark when the environment variable
+ * \c GLAPP_BENCHMARK names a script (see @ref fromEnvironment()). The report
+ * is written as JSON to \c GLAPP_BENCHMARK_REPORT (default: stdout) and,
+ * if \c GLAPP_BENCHMARK_BASELINE names an earlier report, compared against
+ * it with the relative tolerance \c GLAPP_BENCHMARK_TOLERANCE (default 0.1).
+ */
+
+/**
+ * @brief Exception type thrown for malformed benchmark scripts.
+ */
+class BenchmarkException : public std::exception {
+public:
+  /** @brief Construct with an explanatory message. */
+  BenchmarkException(const std::string& whatStr) : whatStr(whatStr) {}
+  /** @brief Retrieve the explanatory C-string. */
+  virtual const char* what() const throw() {
+    return whatStr.c_str();
+  }
+private:
+  std::string whatStr; ///< Stored message.
+};
+
+/**
+ * @brief Script, frame clock, and report of one benchmark run.
+ */
+class GLBenchmark {
+public:
+  /**
+   * @brief One replayed input event.
+   */
+  struct Event {
+    enum class Type {KEY, CHAR, MOUSE_MOVE, MOUSE_BUTTON, WHEEL};
+    uint64_t frame; ///< Frame index (0 = first warm-up frame).
+    Type type;
+    int code;       ///< Key code, character, or mouse button.
+    int action;     ///< GLENV_PRESS/GLENV_RELEASE or GLENV_MOUSE_PRESS/GLENV_MOUSE_RELEASE.
+    double x, y;    ///< Cursor position, or wheel offsets for WHEEL.
+  };
+
+  /**
+   * @brief Results of the measured frames.
+   */
+  struct Report {
+    std::string name;          ///< Application title.
+    std::string script;        ///< Script file.
+    std::string renderer;      ///< GL_RENDERER string.
+    std::string backend;       ///< "window" or "headless".
+    uint64_t warmupFrames{0};
+    uint64_t frames{0};
+    double timestep{0};
+    double wallMs{0};          ///< Wall-clock time of the measured frames.
+    FrameStats::Summary frameMs{};
+    FrameStats::Summary cpuMs{};
+    uint64_t hitches{0};
+    double glCallsPerFrame{0};
+    double drawCallsPerFrame{0};
+    std::string finalFrameHash; ///< FNV-1a of the final frame (hex), empty if not read back.
+  };
+
+  /**
+   * @brief Load and parse a script.
+   * @throw BenchmarkException If the file cannot be read or contains errors.
+   */
+  explicit GLBenchmark(const std::string& scriptFile);
+
+  /**
+   * @brief Create a benchmark from \c GLAPP_BENCHMARK and the related
+   *        variables, or return nullptr if benchmarking is not requested.
+   */
+  static std::unique_ptr<GLBenchmark> fromEnvironment();
+
+  /** @name Frame clock */
+  ///@{
+  /** @brief Index of the frame being rendered. */
+  uint64_t getFrame() const {return frame;}
+  /** @brief Animation time of the current frame in seconds. */
+  double getTime() const {return double(frame)*timestep;}
+  uint64_t getWarmupFrames() const {return warmupFrames;}
+  uint64_t getMeasuredFrames() const {return measuredFrames;}
+  uint64_t getTotalFrames() const {return warmupFrames+measuredFrames;}
+  double getTimestep() const {return timestep;}
+  /** @brief True for the first measured frame. */
+  bool isMeasurementStart() const {return frame == warmupFrames;}
+  /** @brief True for the last frame of the run. */
+  bool isLastFrame() const {return frame+1 == getTotalFrames();}
+  /** @brief Remove and return the events of the current frame, in script order. */
+  std::vector<Event> takeEvents();
+  /** @brief Move to the next frame. */
+  void advance() {frame++;}
+  ///@}
+
+  /** @name Measurement */
+  ///@{
+  /** @brief Start timing and reset @ref GLCallCounter (first measured frame). */
+  void beginMeasurement();
+  /**
+   * @brief Stop timing and store per-frame call counts (last frame).
+   * @param finalFrame Pixels of the final frame to hash; empty to skip.
+   */
+  void endMeasurement(const std::vector<uint8_t>& finalFrame);
+  /** @brief Report filled by the measurement; the application adds its details. */
+  Report& getReport() {return report;}
+  ///@}
+
+  /** @name Reporting */
+  ///@{
+  void setReportFile(const std::string& filename) {reportFile = filename;}
+  void setBaselineFile(const std::string& filename) {baselineFile = filename;}
+  void setTolerance(double relative) {tolerance = relative;}
+  const std::string& getScriptFile() const {return scriptFile;}
+
+  /** @brief Write @p report as JSON. */
+  static void writeJSON(std::ostream& out, const Report& report);
+  /** @brief 64-bit FNV-1a hash of @p data as 16 hex digits. */
+  static std::string hash(const std::vector<uint8_t>& data);
+
+  /**
+   * @brief Write @ref getReport() and compare it against the baseline, if any.
+   * @return False if the median or 95th percentile frame time regressed by
+   *         more than the tolerance. The median CPU time, changed call
+   *         counts, and final frame hashes are reported but do not fail the
+   *         run, since they differ legitimately between drivers.
+   */
+  bool finish() const;
+  ///@}
+
+private:
+  std::string scriptFile;
+  uint64_t warmupFrames;
+  uint64_t measuredFrames;
+  double timestep;
+  std::vector<Event> events; ///< Sorted by frame (stable).
+  size_t nextEvent;          ///< First event not yet taken.
+  uint64_t frame;
+  std::string reportFile;
+  std::string baselineFile;
+  double tolerance;
+  std::chrono::steady_clock::time_point measureStart;
+  Report report;
+
+  void parse(std::istream& in);
+};
@@ -2,6 +2,7 @@
 
 #include "GLBuffer.h"
 #include "GLEnv.h"
+#include "Trace.h"
 
 
 GLBuffer::GLBuffer(GLenum target) :
@@ -20,6 +21,7 @@ GLBuffer::~GLBuffer()  {
 }
 
 void GLBuffer::setData(const std::vector<float>& data, size_t valuesPerElement, GLenum usage) {
+	TRACE_SCOPE("GLBuffer::setData");
 	elemSize = sizeof(data[0]);
 	stride = valuesPerElement*elemSize;
 	type = GL_FLOAT;
@@ -28,6 +30,7 @@ void GLBuffer::setData(const std::vector<float>& data, size_t valuesPerElement,
 }
 
 void GLBuffer::setData(const std::vector<GLuint>& data) {
+	TRACE_SCOPE("GLBuffer::setData");
 	elemSize = sizeof(data[0]);
 	stride = 1*elemSize;
 	type = GL_UNSIGNED_INT;
@@ -38,6 +41,7 @@ void GLBuffer::setData(const std::vector<GLuint>& data) {
 
 void GLBuffer::setData(const float data[], size_t elemCount,
                        size_t valuesPerElement,GLenum usage) {
+  TRACE_SCOPE("GLBuffer::setData");
   elemSize = sizeof(data[0]);
   stride = valuesPerElement*elemSize;
   type = GL_FLOAT;
@@ -46,6 +50,7 @@ void GLBuffer::setData(const float data[], size_t elemCount,
 }
 
 void GLBuffer::setData(const GLuint data[], size_t elemCount) {
+  TRACE_SCOPE("GLBuffer::setData");
   elemSize = sizeof(data[0]);
   stride = 1*elemSize;
   type = GL_UNSIGNED_INT;
@@ -70,3 +75,7 @@ void GLBuffer::bind() const {
 	GL(glBindBuffer(target, bufferID));
 }
 
+void GLBuffer::setLabel(const std::string& label) const {
+	GLDebugOutput::label(GL_BUFFER, bufferID, label);
+}
+
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include <GL/glew.h>
@@ -77,6 +78,12 @@ public:
   /** @brief Bind the buffer to its target with `glBindBuffer(target, id)`. */
   void bind() const;
 
+  /**
+   * @brief Name the buffer in driver debug messages and GPU debuggers.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label) const;
+
 private:
   GLenum target;   ///< Buffer binding target passed at construction.
   GLuint bufferID; ///< GL name of the buffer object.
@@ -1,9 +1,19 @@
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <vector>
 
 #include "GLEnv.h"
 #include "GLDebug.h"
 
+uint64_t GLCallCounter::calls = 0;
+uint64_t GLCallCounter::drawCalls = 0;
+
+bool GLDebugOutput::active = false;
+bool GLDebugOutput::synchronous = false;
+bool GLDebugOutput::objectLabels = false;
+GLDebugOutput::CallSite GLDebugOutput::site{nullptr, nullptr, 0};
+
 std::string errorString(GLenum glerr) {
   switch (glerr) {
     case GL_NO_ERROR: return "GL_NO_ERROR";
@@ -64,3 +74,187 @@ void checkAndThrowProgram(GLuint program) {
     throw GLException{str};
   }
 }
+
+#ifndef __EMSCRIPTEN__
+
+static const char* sourceString(GLenum source) {
+  switch (source) {
+    case GL_DEBUG_SOURCE_API : return "API";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM : return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER : return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY : return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION : return "application";
+    default : return "other";
+  }
+}
+
+static const char* typeString(GLenum type) {
+  switch (type) {
+    case GL_DEBUG_TYPE_ERROR : return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR : return "deprecated behavior";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR : return "undefined behavior";
+    case GL_DEBUG_TYPE_PORTABILITY : return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE : return "performance";
+    case GL_DEBUG_TYPE_MARKER : return "marker";
+    default : return "message";
+  }
+}
+
+static const char* severityString(GLenum severity) {
+  switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH : return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM : return "medium";
+    case GL_DEBUG_SEVERITY_LOW : return "low";
+    default : return "notification";
+  }
+}
+
+// error messages name the GL error token somewhere in their text on most
+// drivers; fall back to the message id, which is the error code on NVIDIA
+static std::string errorToken(GLuint id, const GLchar* message) {
+  const GLenum errors[] = {GL_INVALID_ENUM, GL_INVALID_VALUE, GL_INVALID_OPERATION,
+                           GL_INVALID_FRAMEBUFFER_OPERATION, GL_OUT_OF_MEMORY};
+  for (GLenum e : errors) {
+    const std::string token = errorString(e);
+    if (strstr(message, token.c_str())) return token;
+  }
+  for (GLenum e : errors) {
+    if (id == e) return errorString(e);
+  }
+  return "GL error";
+}
+
+struct GLDebugOutputCallback {
+  static void GLAPIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                  GLsizei, const GLchar* message, const void*) {
+    const GLDebugOutput::CallSite site = GLDebugOutput::site;
+    std::stringstream s;
+    if (type == GL_DEBUG_TYPE_ERROR) {
+      s << "GL error: " << errorToken(id, message);
+    } else {
+      s << "GL " << typeString(type) << " (" << severityString(severity) << ")";
+    }
+    if (site.statement) {
+      s << (GLDebugOutput::synchronous ? " in " : " after ") << site.statement
+        << " at " << site.line << " (" << site.file << ")";
+    }
+    s << ":\n  " << message << " [" << sourceString(source) << ", id " << id << "]";
+    std::cerr << s.str() << std::endl;
+  }
+};
+
+bool GLDebugOutput::enable(bool synchronous) {
+  if (glDebugMessageCallback && glDebugMessageControl) {
+    glDebugMessageCallback(GLDebugOutputCallback::callback, nullptr);
+    objectLabels = glObjectLabel != nullptr;
+  } else if (glDebugMessageCallbackARB && glDebugMessageControlARB) {
+    glDebugMessageCallbackARB(GLDebugOutputCallback::callback, nullptr);
+    objectLabels = false;
+  } else {
+    return false;
+  }
+  // GL_DEBUG_OUTPUT only exists with KHR_debug; ARB_debug_output is always on
+  if (glDebugMessageCallback) glEnable(GL_DEBUG_OUTPUT);
+  active = true;
+  setSynchronous(synchronous);
+  setFilter(Severity::LOW);
+  clearErrorFlags();
+  return true;
+}
+
+void GLDebugOutput::disable() {
+  if (!active) return;
+  if (glDebugMessageCallback) {
+    glDebugMessageCallback(nullptr, nullptr);
+    glDisable(GL_DEBUG_OUTPUT);
+  } else {
+    glDebugMessageCallbackARB(nullptr, nullptr);
+  }
+  glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  active = false;
+  objectLabels = false;
+}
+
+void GLDebugOutput::setSynchronous(bool synchronous) {
+  if (!active) return;
+  GLDebugOutput::synchronous = synchronous;
+  if (synchronous)
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  else
+    glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+}
+
+void GLDebugOutput::setFilter(Severity minimum, uint32_t sources) {
+  if (!active) return;
+  auto control = [](GLenum source, GLenum severity, GLboolean enabled) {
+    if (glDebugMessageControl)
+      glDebugMessageControl(source, GL_DONT_CARE, severity, 0, nullptr, enabled);
+    else
+      glDebugMessageControlARB(source, GL_DONT_CARE, severity, 0, nullptr, enabled);
+  };
+
+  const GLenum sourceEnums[] = {
+    GL_DEBUG_SOURCE_API, GL_DEBUG_SOURCE_WINDOW_SYSTEM, GL_DEBUG_SOURCE_SHADER_COMPILER,
+    GL_DEBUG_SOURCE_THIRD_PARTY, GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_SOURCE_OTHER
+  };
+  const std::pair<Severity, GLenum> severityEnums[] = {
+    {Severity::NOTIFICATION, GL_DEBUG_SEVERITY_NOTIFICATION},
+    {Severity::LOW,          GL_DEBUG_SEVERITY_LOW},
+    {Severity::MEDIUM,       GL_DEBUG_SEVERITY_MEDIUM},
+    {Severity::HIGH,         GL_DEBUG_SEVERITY_HIGH}
+  };
+
+  control(GL_DONT_CARE, GL_DONT_CARE, GL_FALSE);
+  for (size_t i = 0;i<6;++i) {
+    if (!(sources & (1u << i))) continue;
+    for (const auto& severity : severityEnums) {
+      // ARB_debug_output has no notification severity
+      if (severity.first == Severity::NOTIFICATION && !glDebugMessageControl) continue;
+      if (severity.first >= minimum) control(sourceEnums[i], severity.second, GL_TRUE);
+    }
+  }
+}
+
+void GLDebugOutput::label(GLenum identifier, GLuint name, const std::string& label) {
+  if (!objectLabels || name == 0) return;
+  glObjectLabel(identifier, name, GLsizei(label.size()), label.c_str());
+}
+
+void GLDebugOutput::clearErrorFlags() {
+  if (!active) return;
+  // bounded like GL(): some contexts never clear their error state
+  for (size_t i = 0;i<MAX_GL_ERROR_COUNT && glGetError() != GL_NO_ERROR;++i) {}
+}
+
+#else
+
+// WebGL has no debug output; GL() keeps polling glGetError()
+bool GLDebugOutput::enable(bool) {return false;}
+void GLDebugOutput::disable() {}
+void GLDebugOutput::setSynchronous(bool) {}
+void GLDebugOutput::setFilter(Severity, uint32_t) {}
+void GLDebugOutput::label(GLenum, GLuint, const std::string&) {}
+void GLDebugOutput::clearErrorFlags() {}
+
+#endif
+
+bool GLDebugOutput::enableFromEnvironment() {
+  const char* output = std::getenv("GLDEBUG_OUTPUT");
+  if (output && std::string(output) == "0") return false;
+
+  const char* sync = std::getenv("GLDEBUG_SYNC");
+  if (!enable(sync && std::string(sync) == "1")) return false;
+
+  if (const char* severity = std::getenv("GLDEBUG_SEVERITY")) {
+    const std::string s{severity};
+    if (s == "notification")
+      setFilter(Severity::NOTIFICATION);
+    else if (s == "medium")
+      setFilter(Severity::MEDIUM);
+    else if (s == "high")
+      setFilter(Severity::HIGH);
+    else if (s != "low")
+      std::cerr << "GLDEBUG_SEVERITY: unknown severity " << s << std::endl;
+  }
+  return true;
+}
@@ -2,6 +2,9 @@
 
 #include <iostream>
 #include <exception>
+#include <string>
+#include <cstdint>
+#include <type_traits>
 
 /**
  * @file GLDebug.h
@@ -13,10 +16,13 @@
  *  - String conversion for common GL error codes via @ref errorString().
  *  - Debug helpers @ref checkAndThrow(), @ref checkAndThrowShader(), and
  *    @ref checkAndThrowProgram().
- *  - A debug-only \c GL(stmt) macro that wraps GL calls to flush and report
- *    error codes before and after executing \p stmt.
+ *  - @ref GLDebugOutput, which receives errors and warnings from the driver
+ *    through a \c KHR_debug message callback.
+ *  - A debug-only \c GL(stmt) macro that records its call site for
+ *    @ref GLDebugOutput or, where debug output is unavailable, flushes and
+ *    reports error codes before and after executing \p stmt.
  *
- * @note When \c NDEBUG is defined, \c GL(stmt) compiles down to a plain
+ * @note When \c NDEBUG is defined, \c GL(stmt) compiles down to a counted
  *       \c stmt without extra error checks.
  */
 
@@ -60,12 +66,157 @@ struct Dimensions {
  */
 std::string errorString(GLenum glerr);
 
-#ifndef NDEBUG
+/**
+ * @brief Counts statements executed through the GL() macro.
+ *
+ * Both debug and release variants of GL() increment @ref calls; statements
+ * starting with \c glDraw* (except \c glDrawBuffer(s)) or \c glMultiDraw*
+ * also increment @ref drawCalls. The classification happens at compile
+ * time, so counting costs two additions per call. GL calls made without the
+ * macro are not counted. Used by the benchmark mode of @ref GLApp.
+ */
+struct GLCallCounter {
+  static uint64_t calls;     ///< GL() statements since the last reset().
+  static uint64_t drawCalls; ///< Draw statements among them.
+
+  /** @brief Zero both counters. */
+  static void reset() {calls = 0; drawCalls = 0;}
+
+  /** @brief True if @p s starts with @p prefix. */
+  static constexpr bool startsWith(const char* s, const char* prefix) {
+    return *prefix == 0 || (*s == *prefix && startsWith(s+1, prefix+1));
+  }
+  /** @brief True if the stringified statement @p s is a draw call. */
+  static constexpr bool isDraw(const char* s) {
+    return (startsWith(s, "glDraw") && !startsWith(s, "glDrawBuffer")) ||
+           startsWith(s, "glMultiDraw");
+  }
+};
+
+/** @brief Count one GL() statement (draw classification folded at compile time). */
+#define GL_COUNT_CALL(stmt)                                                  \
+GLCallCounter::calls++;                                                      \
+GLCallCounter::drawCalls += std::integral_constant<bool, GLCallCounter::isDraw(#stmt)>::value
+
+#ifdef __EMSCRIPTEN__
+// object label namespaces of KHR_debug, missing from the GLES 3 headers
+#ifndef GL_BUFFER
+#define GL_BUFFER       0x82E0
+#define GL_SHADER       0x82E1
+#define GL_PROGRAM      0x82E2
+#define GL_VERTEX_ARRAY 0x8074
+#endif
+#endif
 
 /**
- * @name Debug-only error reporting support
- * @{
+ * @brief Driver debug messages (\c KHR_debug / GL 4.3 \c glDebugMessageCallback)
+ *        as a replacement for polling glGetError().
+ *
+ * Once enabled, the driver reports errors, performance warnings, and other
+ * messages to a callback instead of the application draining glGetError()
+ * around every call, which serialises the driver. In debug builds the GL()
+ * macro then only records its call site (three stores, no GL call), and
+ * the callback attributes each message to the last GL() statement:
+ * @code
+ * GL error: GL_INVALID_ENUM after glBindTexture(target, id) at 212 (main.cpp):
+ *   GL_INVALID_ENUM in glBindTexture(target = 0x1234) [API, id 1]
+ * @endcode
+ * In asynchronous mode (the default) the driver may deliver messages late
+ * and on another thread, so the reported call site is the most recent one;
+ * synchronous mode makes the attribution exact at some driver cost.
+ *
+ * @ref GLEnv enables debug output in debug builds when the context supports
+ * it (see @ref enableFromEnvironment()). Without support (e.g. macOS,
+ * WebGL), GL() keeps checking glGetError().
  */
+class GLDebugOutput {
+public:
+  /** @brief Message severities in increasing order. */
+  enum class Severity {NOTIFICATION, LOW, MEDIUM, HIGH};
+
+  /** @brief Message sources, combinable as a bit mask for setFilter(). */
+  enum Source : uint32_t {
+    API             = 1 << 0,
+    WINDOW_SYSTEM   = 1 << 1,
+    SHADER_COMPILER = 1 << 2,
+    THIRD_PARTY     = 1 << 3,
+    APPLICATION     = 1 << 4,
+    OTHER           = 1 << 5,
+    ALL_SOURCES     = (1 << 6) - 1
+  };
+
+  /**
+   * @brief Register the message callback on the current context.
+   * @param synchronous If true, messages are delivered during the offending
+   *                    call (exact call sites, slower driver).
+   * @return False if the context supports neither GL 4.3, \c KHR_debug,
+   *         nor \c ARB_debug_output; GL() then keeps polling glGetError().
+   */
+  static bool enable(bool synchronous=false);
+
+  /**
+   * @brief Enable with settings from the environment: \c GLDEBUG_OUTPUT=0
+   *        keeps polling glGetError(), \c GLDEBUG_SYNC=1 requests
+   *        synchronous mode, and \c GLDEBUG_SEVERITY
+   *        (\c notification, \c low, \c medium, \c high) sets the minimum
+   *        severity (default \c low).
+   */
+  static bool enableFromEnvironment();
+
+  /** @brief Unregister the callback; GL() falls back to glGetError(). */
+  static void disable();
+
+  /** @brief True while the callback is registered. */
+  static bool isActive() {return active;}
+
+  /** @brief Switch between synchronous and asynchronous delivery. */
+  static void setSynchronous(bool synchronous);
+
+  /**
+   * @brief Only deliver messages of at least @p minimum severity from the
+   *        sources in @p sources. Errors are always of high severity.
+   */
+  static void setFilter(Severity minimum, uint32_t sources=ALL_SOURCES);
+
+  /**
+   * @brief Attach a name shown in driver messages and GPU debuggers.
+   * @param identifier Object namespace (GL_BUFFER, GL_TEXTURE, GL_PROGRAM, ...).
+   * @param name       GL object name. Objects only exist after their first
+   *                   bind, so label them after construction or first upload.
+   * @param label      Label text.
+   * @note Does nothing unless debug output is active with \c KHR_debug.
+   */
+  static void label(GLenum identifier, GLuint name, const std::string& label);
+
+  /**
+   * @brief Drain stale error flags, which the callback has already reported.
+   *
+   * Call before a glGetError()-based check such as @ref checkAndThrow(), which
+   * would otherwise throw for an earlier statement. Does nothing when inactive.
+   */
+  static void clearErrorFlags();
+
+  /** @brief Remember the statement GL() is about to execute (used by the macro). */
+  static void setCallSite(const char* statement, const char* file, uint32_t line) {
+    site.statement = statement;
+    site.file = file;
+    site.line = line;
+  }
+
+private:
+  struct CallSite {
+    const char* statement;
+    const char* file;
+    uint32_t line;
+  };
+
+  static bool active;
+  static bool synchronous;
+  static bool objectLabels;
+  static CallSite site;
+
+  friend struct GLDebugOutputCallback;
+};
 
 /**
  * @brief Maximum number of consecutive glGetError() iterations before bailing.
@@ -75,6 +226,13 @@ std::string errorString(GLenum glerr);
  */
 #define MAX_GL_ERROR_COUNT 10
 
+#ifndef NDEBUG
+
+/**
+ * @name Debug-only error reporting support
+ * @{
+ */
+
 /**
  * @brief Internal printer used by the GL() macro to emit formatted errors.
  * @param statement The stringified GL statement being executed.
@@ -87,19 +245,28 @@ void errorOut(const std::string& statement, const std::string& location,
               uint32_t line, const std::string& file, uint32_t errnum);
 
 /**
- * @brief Debug wrapper that flushes and reports GL errors around a statement.
+ * @brief Debug wrapper that reports GL errors attributed to a statement.
  *
  * Usage:
  * @code
  * GL(glBindTexture(GL_TEXTURE_2D, id));
  * @endcode
  *
- * In debug builds, existing GL errors are drained and reported ("before"), the
- * statement is executed, then new errors are drained and reported ("in"). In
- * release builds (\c NDEBUG defined), this expands to the bare statement.
+ * In debug builds with @ref GLDebugOutput active, the call site is recorded
+ * for the message callback and the statement is executed without querying
+ * the error state. Otherwise existing GL errors are drained and reported
+ * ("before"), the statement is executed, then new errors are drained and
+ * reported ("in"). In release builds (\c NDEBUG defined), this expands to
+ * the statement plus the @ref GLCallCounter increments.
  */
 # define GL(stmt)                                                      \
 do {                                                                 \
+GL_COUNT_CALL(stmt);                                               \
+if (GLDebugOutput::isActive()) {                                   \
+GLDebugOutput::setCallSite(#stmt, __FILE__, __LINE__);             \
+stmt;                                                              \
+break;                                                             \
+}                                                                  \
 GLenum glerr;                                                      \
 uint32_t counter = 0;                                              \
 while((glerr = glGetError()) != GL_NO_ERROR) {                     \
@@ -119,8 +286,8 @@ if (counter > MAX_GL_ERROR_COUNT) break;                         \
 } while(0)
 /** @} */
 #else
-/** @brief Release build: GL(stmt) becomes a no-op wrapper around stmt. */
-# define GL(stmt) do { stmt; } while(0)
+/** @brief Release build: GL(stmt) only counts and executes stmt. */
+# define GL(stmt) do { GL_COUNT_CALL(stmt); stmt; } while(0)
 #endif
 
 /**
@@ -20,6 +20,10 @@ const GLuint GLDepthBuffer::getId() const {
 	return id;
 }
 
+void GLDepthBuffer::setLabel(const std::string& label) const {
+	GLDebugOutput::label(GL_RENDERBUFFER, id, label);
+}
+
 void GLDepthBuffer::setSize(uint32_t width, uint32_t height) {
   this->width = width;
   this->height =height;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "GLEnv.h"
@@ -35,6 +36,12 @@ public:
    */
   const GLuint getId() const;
 
+  /**
+   * @brief Name the renderbuffer in driver debug messages and GPU debuggers.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label) const;
+
   /** @name Introspection */
   ///@{
   /** @brief Stored width in pixels. */
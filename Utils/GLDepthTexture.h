@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "GLEnv.h"
@@ -55,6 +56,12 @@ public:
    */
   const GLuint getId() const {return id;}
 
+  /**
+   * @brief Name the texture in driver debug messages and GPU debuggers.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label) const {GLDebugOutput::label(GL_TEXTURE, id, label);}
+
   /**
    * @brief Allocate empty depth storage of the requested size/format.
    * @param width   Width in texels.
@@ -109,6 +116,18 @@ public:
     GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter));
   }
 
+  /**
+   * @brief Enable or disable depth comparison.
+   *
+   * With comparison disabled the texture is sampled as a plain \c sampler2D
+   * returning the stored depth, e.g. to reconstruct positions.
+   */
+  void setCompare(bool compare) {
+    GL(glBindTexture(GL_TEXTURE_2D, id));
+    GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE,
+                       compare ? GL_COMPARE_REF_TO_TEXTURE : GL_NONE));
+  }
+
 private:
   GLuint id;                ///< GL name of the texture object.
   uint32_t width;           ///< Texture width in texels.
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "GLEnv.h"
+
+/**
+ * @file GLDepthTextureArray.h
+ * @brief RAII wrapper for a layered OpenGL depth texture with compare mode enabled.
+ *
+ * The array counterpart of @ref GLDepthTexture: a `GL_TEXTURE_2D_ARRAY` of
+ * equally sized depth layers, sampled in GLSL as \c sampler2DArrayShadow.
+ * Layers are rendered one at a time through
+ * @ref GLFramebuffer::bind(const GLDepthTextureArray&, size_t), e.g. one per
+ * shadow cascade (see @ref CascadedShadowMap).
+ *
+ * @note All GL calls are wrapped with the `GL()` macro for debug error checking.
+ */
+class GLDepthTextureArray {
+public:
+  /**
+   * @brief Create a depth texture array with initial sampler parameters.
+   * @param magFilter Magnification filter (e.g., `GL_LINEAR`).
+   * @param minFilter Minification filter (e.g., `GL_LINEAR`).
+   * @param wrapX     Wrap mode for S (x) coordinate (e.g., `GL_CLAMP_TO_EDGE`).
+   * @param wrapY     Wrap mode for T (y) coordinate (e.g., `GL_CLAMP_TO_EDGE`).
+   * @post A texture name is generated, parameters are applied, and depth
+   *       comparison is enabled (`GL_COMPARE_REF_TO_TEXTURE` with `GL_LESS`).
+   */
+  GLDepthTextureArray(GLint magFilter=GL_LINEAR, GLint minFilter=GL_LINEAR,
+                      GLint wrapX=GL_CLAMP_TO_EDGE, GLint wrapY=GL_CLAMP_TO_EDGE) :
+  id{ 0 },
+  width{ 0 },
+  height{ 0 },
+  layers{ 0 },
+  dataType{ GLDepthDataType::DEPTH24 }
+  {
+    GL(glGenTextures(1, &id));
+    GL(glBindTexture(GL_TEXTURE_2D_ARRAY, id));
+    GL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrapX));
+    GL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrapY));
+    GL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, magFilter));
+    GL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter));
+    GL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE));
+    GL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LESS));
+  }
+
+  /** @brief Destroy and delete the GL texture name. */
+  ~GLDepthTextureArray() {
+    GL(glDeleteTextures(1, &id));
+  }
+
+  GLDepthTextureArray(const GLDepthTextureArray&) = delete;
+  GLDepthTextureArray& operator=(const GLDepthTextureArray&) = delete;
+
+  /**
+   * @brief Retrieve the OpenGL texture object name.
+   * @return GLuint of the managed depth texture array.
+   */
+  const GLuint getId() const {return id;}
+
+  /**
+   * @brief Name the texture in driver debug messages and GPU debuggers.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label) const {GLDebugOutput::label(GL_TEXTURE, id, label);}
+
+  /**
+   * @brief Allocate empty depth storage for all layers.
+   * @param width    Width of each layer in texels.
+   * @param height   Height of each layer in texels.
+   * @param layers   Number of layers.
+   * @param dataType Depth format to allocate (DEPTH16/DEPTH24/DEPTH32).
+   */
+  void setEmpty(uint32_t width, uint32_t height, uint32_t layers,
+                GLDepthDataType dataType=GLDepthDataType::DEPTH32) {
+    this->width = width;
+    this->height = height;
+    this->layers = layers;
+    this->dataType = dataType;
+
+    GLenum internalFormat{GL_DEPTH_COMPONENT32F};
+    switch (dataType) {
+      case GLDepthDataType::DEPTH16: internalFormat = GL_DEPTH_COMPONENT16; break;
+      case GLDepthDataType::DEPTH24: internalFormat = GL_DEPTH_COMPONENT24; break;
+      case GLDepthDataType::DEPTH32: internalFormat = GL_DEPTH_COMPONENT32F; break;
+    }
+
+    GL(glBindTexture(GL_TEXTURE_2D_ARRAY, id));
+    GL(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GLint(internalFormat), GLsizei(width),
+                    GLsizei(height), GLsizei(layers), 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0));
+  }
+
+  /** @name Introspection */
+  ///@{
+  /** @brief Layer height in texels. */
+  uint32_t getHeight() const {return height;}
+  /** @brief Layer width in texels. */
+  uint32_t getWidth() const {return width;}
+  /** @brief Number of layers. */
+  uint32_t getLayers() const {return layers;}
+  /** @brief Depth storage type used for allocation. */
+  GLDepthDataType getType() const {return dataType;}
+  ///@}
+
+private:
+  GLuint id;                ///< GL name of the texture object.
+  uint32_t width;           ///< Layer width in texels.
+  uint32_t height;          ///< Layer height in texels.
+  uint32_t layers;          ///< Number of layers.
+  GLDepthDataType dataType; ///< Internal depth format (DEPTH16/DEPTH24/DEPTH32).
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+
+#include "GLEnv.h"
+#include "GLTextureCube.h"
+
+/**
+ * @file GLDepthTextureCube.h
+ * @brief RAII wrapper for an OpenGL depth cube map with compare mode enabled.
+ *
+ * The cube counterpart of @ref GLDepthTexture: six square depth faces in a
+ * `GL_TEXTURE_CUBE_MAP`, sampled in GLSL as \c samplerCubeShadow (e.g. for
+ * omnidirectional point light shadows). It also serves as the depth
+ * attachment when rendering a dynamic @ref GLTextureCube in one layered pass
+ * (see @ref CubeMapPass).
+ *
+ * @note All GL calls are wrapped with the `GL()` macro for debug error checking.
+ */
+class GLDepthTextureCube {
+public:
+  /**
+   * @brief Create a depth cube map with initial sampler parameters.
+   * @param magFilter Magnification filter (e.g., `GL_LINEAR`).
+   * @param minFilter Minification filter (e.g., `GL_LINEAR`).
+   * @post A texture name is generated, parameters are applied, and depth
+   *       comparison is enabled (`GL_COMPARE_REF_TO_TEXTURE` with `GL_LESS`).
+   */
+  GLDepthTextureCube(GLint magFilter=GL_LINEAR, GLint minFilter=GL_LINEAR) :
+  id{ 0 },
+  size{ 0 },
+  dataType{ GLDepthDataType::DEPTH24 }
+  {
+    GL(glGenTextures(1, &id));
+    GL(glBindTexture(GL_TEXTURE_CUBE_MAP, id));
+    GL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+    GL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, magFilter));
+    GL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, minFilter));
+    GL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE));
+    GL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LESS));
+  }
+
+  /** @brief Destroy and delete the GL texture name. */
+  ~GLDepthTextureCube() {
+    GL(glDeleteTextures(1, &id));
+  }
+
+  GLDepthTextureCube(const GLDepthTextureCube&) = delete;
+  GLDepthTextureCube& operator=(const GLDepthTextureCube&) = delete;
+
+  /**
+   * @brief Retrieve the OpenGL texture object name.
+   * @return GLuint of the managed depth cube map.
+   */
+  const GLuint getId() const {return id;}
+
+  /**
+   * @brief Name the texture in driver debug messages and GPU debuggers.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label) const {GLDebugOutput::label(GL_TEXTURE, id, label);}
+
+  /**
+   * @brief Allocate empty depth storage for all six faces.
+   * @param size     Width and height of each face in texels.
+   * @param dataType Depth format to allocate (DEPTH16/DEPTH24/DEPTH32).
+   */
+  void setEmpty(uint32_t size, GLDepthDataType dataType=GLDepthDataType::DEPTH32) {
+    this->size = size;
+    this->dataType = dataType;
+
+    GLenum internalFormat{GL_DEPTH_COMPONENT32F};
+    switch (dataType) {
+      case GLDepthDataType::DEPTH16: internalFormat = GL_DEPTH_COMPONENT16; break;
+      case GLDepthDataType::DEPTH24: internalFormat = GL_DEPTH_COMPONENT24; break;
+      case GLDepthDataType::DEPTH32: internalFormat = GL_DEPTH_COMPONENT32F; break;
+    }
+
+    GL(glBindTexture(GL_TEXTURE_CUBE_MAP, id));
+    for (GLenum face = 0;face<6;++face) {
+      GL(glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GLint(internalFormat),
+                      GLsizei(size), GLsizei(size), 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0));
+    }
+  }
+
+  /** @name Introspection */
+  ///@{
+  /** @brief Face height in texels. */
+  uint32_t getHeight() const {return size;}
+  /** @brief Face width in texels. */
+  uint32_t getWidth() const {return size;}
+  /** @brief Depth storage type used for allocation. */
+  GLDepthDataType getType() const {return dataType;}
+  ///@}
+
+private:
+  GLuint id;                ///< GL name of the texture object.
+  uint32_t size;            ///< Face width and height in texels.
+  GLDepthDataType dataType; ///< Internal depth format (DEPTH16/DEPTH24/DEPTH32).
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "GLEnv.h"
+
+/**
+ * @file GLDrawTarget.h
+ * @brief Interface for redirecting @ref GLApp::draw() into another target.
+ *
+ * @ref GLApp only knows this interface, so a demo links the implementation
+ * (e.g. @ref DynamicResolution and its framebuffer objects) only if it opts
+ * in, e.g. through @ref GLApp::setDynamicResolution().
+ */
+class GLDrawTarget {
+public:
+  virtual ~GLDrawTarget() = default;
+
+  /**
+   * @brief Bind the target before @ref GLApp::draw().
+   * @param outputSize Size of the window's framebuffer.
+   */
+  virtual void begin(const Dimensions& outputSize) = 0;
+  /** @brief Resolve the target into the window after @ref GLApp::draw(). */
+  virtual void end() = 0;
+  /** @brief Size @ref GLApp::draw() renders at between @ref begin() and @ref end(). */
+  virtual Dimensions getRenderSize() const = 0;
+};
@@ -3,6 +3,9 @@
 #include <chrono>
 #include <cmath>
 #include <iostream>
+#include <cstdlib>
+#include <thread>
+#include <algorithm>
 
 #ifndef SET_ENS_CANVAS
 #define ENS_CANVAS "#canvas"
@@ -14,6 +17,10 @@ typedef std::chrono::high_resolution_clock Clock;
 
 #include "GLEnv.h"
 #include "GLDebug.h"
+#include "GLProgram.h"
+#include "GLHeadlessContext.h"
+#include "bmp.h"
+#include "Trace.h"
 
 #ifdef _WIN32
 #ifndef _GLFW_USE_HYBRID_HPG
@@ -26,6 +33,24 @@ extern "C" {
 #endif
 
 
+GLEnvBackend GLEnv::defaultBackend = GLEnvBackend::WINDOW;
+GLuint GLEnv::defaultFramebufferID = 0;
+GLuint GLEnv::redirectedFramebufferID = 0;
+
+static GLEnvBackend selectBackend(GLEnvBackend fallback) {
+  const char* env = std::getenv("GLENV_BACKEND");
+  if (!env) return fallback;
+  const std::string name{env};
+  if (name == "headless") return GLEnvBackend::HEADLESS;
+  if (name == "window") return GLEnvBackend::WINDOW;
+  std::cerr << "Ignoring unknown GLENV_BACKEND " << name << std::endl;
+  return fallback;
+}
+
+void GLEnv::setDefaultBackend(GLEnvBackend backend) {
+  defaultBackend = backend;
+}
+
 void GLEnv::checkGLError(const std::string& id) {
   GLenum e = glGetError();
   if (e != GL_NO_ERROR) {
@@ -43,13 +68,40 @@ void GLEnv::errorCallback(int error, const char* description) {
 
 GLEnv::GLEnv(uint32_t w, uint32_t h, uint32_t s, const std::string& title, 
              bool fpsCounter, bool sync, int major, int minor, bool core) :
-#ifndef __EMSCRIPTEN__
+#ifdef __EMSCRIPTEN__
+  backend(GLEnvBackend::WINDOW),
+#else
+  backend(selectBackend(defaultBackend)),
   window(nullptr),
+  headless(),
 #endif
+  offscreenFBO(0),
+  offscreenColor(0),
+  offscreenDepth(0),
+  offscreenSize{w,h},
+  offscreenSamples(s),
+  closeRequested(false),
+  frameLimit(0),
+  presentedFrames(0),
+  finalFrameFile(),
+  finalFrameSaved(false),
+  creationTime(Clock::now()),
   sync(sync),
   title(title),
   fpsCounter(fpsCounter),
-  last(Clock::now())
+  last(Clock::now()),
+  frameCount(0),
+  frameStats(),
+  frameStatsFile(),
+  frameStart(last),
+  lastPresent(last),
+  firstInput(last),
+  frameStarted(false),
+  inputPending(false),
+  firstFrame(true),
+  maxFramesInFlight(0),
+  targetFrameRate(0.0),
+  frameDeadline(last)
 {
 #ifdef __EMSCRIPTEN__
   emscripten_set_canvas_element_size(ENS_CANVAS, w, h);
@@ -69,52 +121,134 @@ GLEnv::GLEnv(uint32_t w, uint32_t h, uint32_t s, const std::string& title,
   emscripten_webgl_make_context_current(context);
 
 #else
-  glfwSetErrorCallback(errorCallback);
+  if (backend == GLEnvBackend::HEADLESS) {
+#ifndef NDEBUG
+    headless = std::make_unique<GLHeadlessContext>(major, minor, core, true);
+#else
+    headless = std::make_unique<GLHeadlessContext>(major, minor, core);
+#endif
+  } else {
+    glfwSetErrorCallback(errorCallback);
 
-  if (!glfwInit())
-    throw GLException{"GLFW Init Failed"};
+    if (!glfwInit())
+      throw GLException{"GLFW Init Failed"};
 
-  glfwWindowHint(GLFW_SAMPLES, int(s));
+    glfwWindowHint(GLFW_SAMPLES, int(s));
 
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
-  
-  if (core) {
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-  }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
 
-  window = glfwCreateWindow(int(w), int(h), title.c_str(), nullptr, nullptr);
-  if (window == nullptr) {
-    std::stringstream s;
-    s << "Failed to open GLFW window.";
-    glfwTerminate();
-    throw GLException{s.str()};
-  }
+    if (core) {
+      glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+      glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    }
+
+#ifndef NDEBUG
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
+
+    window = glfwCreateWindow(int(w), int(h), title.c_str(), nullptr, nullptr);
+    if (window == nullptr) {
+      std::stringstream s;
+      s << "Failed to open GLFW window.";
+      glfwTerminate();
+      throw GLException{s.str()};
+    }
 
-  glfwMakeContextCurrent(window);
+    glfwMakeContextCurrent(window);
+  }
 
   GLenum err{glewInit()};
-  if (err != GLEW_OK) {
+  // GLEW built for GLX also loads GLX extensions, which fails without an X display
+  if (err != GLEW_OK && !(headless && err == GLEW_ERROR_NO_GLX_DISPLAY)) {
     std::stringstream s;
     s << "Failed to init GLEW " << glewGetErrorString(err) << std::endl;
-    glfwTerminate();
+    if (window) glfwTerminate();
     throw GLException{s.str()};
   }
-  setSync(sync);
+
+#ifndef NDEBUG
+  GLDebugOutput::enableFromEnvironment();
+#endif
+
+  if (headless) {
+    createOffscreenFramebuffer(w, h, s);
+    const GLubyte* renderer = glGetString(GL_RENDERER);
+    std::cout << title << ": headless " << headless->getDescription() << ", "
+              << (renderer ? reinterpret_cast<const char*>(renderer) : "unknown renderer") << std::endl;
+  } else {
+    setSync(sync);
+  }
+#endif
+
+  if (const char* frames = std::getenv("GLENV_FRAMES"))
+    setFrameLimit(std::strtoull(frames, nullptr, 10));
+  if (const char* file = std::getenv("GLENV_FINAL_FRAME"))
+    setFinalFrameExport(file);
+  if (const char* file = std::getenv("GLENV_FRAME_STATS"))
+    setFrameStatsExport(file);
+  if (const char* frames = std::getenv("GLENV_FRAMES_IN_FLIGHT"))
+    setMaxFramesInFlight(uint32_t(std::strtoul(frames, nullptr, 10)));
+  if (const char* fps = std::getenv("GLENV_TARGET_FPS"))
+    setTargetFrameRate(std::strtod(fps, nullptr));
+#ifndef __EMSCRIPTEN__
+  // before GLApp builds its stock programs, so those are cached as well
+  if (const char* directory = std::getenv("GLENV_PROGRAM_CACHE"))
+    GLProgram::setBinaryCacheDirectory(directory);
 #endif
 
 }
 
 GLEnv::~GLEnv() {
+  if (!frameStatsFile.empty() && !frameStats.save(frameStatsFile))
+    std::cerr << "Unable to write frame statistics to " << frameStatsFile << std::endl;
 #ifndef __EMSCRIPTEN__
-  glfwDestroyWindow(window);
-  glfwTerminate();
+  GLDebugOutput::disable();
+  for (const FrameFence& f : frameFences) glDeleteSync(f.sync);
+  frameFences.clear();
+  if (headless) {
+    // the last frame is still in the offscreen framebuffer
+    saveFinalFrame();
+    glDeleteFramebuffers(1, &offscreenFBO);
+    glDeleteRenderbuffers(1, &offscreenColor);
+    glDeleteRenderbuffers(1, &offscreenDepth);
+    defaultFramebufferID = 0;
+    headless.reset();
+  } else {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
 #endif
 }
 
+void GLEnv::createOffscreenFramebuffer(uint32_t w, uint32_t h, uint32_t s) {
+  const GLsizei samples = s > 1 ? GLsizei(s) : 0;
+
+  GL(glGenRenderbuffers(1, &offscreenColor));
+  GL(glBindRenderbuffer(GL_RENDERBUFFER, offscreenColor));
+  GL(glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, GLsizei(w), GLsizei(h)));
+
+  GL(glGenRenderbuffers(1, &offscreenDepth));
+  GL(glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepth));
+  GL(glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, GLsizei(w), GLsizei(h)));
+  GL(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+
+  GL(glGenFramebuffers(1, &offscreenFBO));
+  GL(glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO));
+  GL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor));
+  GL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth));
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    throw GLException{"Headless framebuffer is incomplete"};
+
+  offscreenSize = Dimensions{w, h};
+  offscreenSamples = s;
+  defaultFramebufferID = offscreenFBO;
+  GL(glViewport(0, 0, GLsizei(w), GLsizei(h)));
+}
+
 void GLEnv::setSync(bool sync) {
   this->sync = sync;
+  if (backend == GLEnvBackend::HEADLESS) return;
 
 #ifdef __EMSCRIPTEN__
   // TODO: check this
@@ -135,11 +269,223 @@ void GLEnv::setFPSCounter(bool fpsCounter) {
   this->fpsCounter = fpsCounter;
 }
 
-void GLEnv::endOfFrame() {
+static double milliseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void GLEnv::setMaxFramesInFlight(uint32_t frames) {
+  maxFramesInFlight = std::min(frames, 3u);
 #ifndef __EMSCRIPTEN__
-  glfwSwapBuffers(window);
-  glfwPollEvents();
+  if (maxFramesInFlight > 0 && !glFenceSync) {
+    std::cerr << "Sync objects are not supported, frames in flight are not limited" << std::endl;
+    maxFramesInFlight = 0;
+  }
+  if (maxFramesInFlight == 0) retireFrames(0);
 #endif
+}
+
+void GLEnv::setTargetFrameRate(double fps) {
+  targetFrameRate = std::max(fps, 0.0);
+  frameDeadline = Clock::now();
+#ifdef __EMSCRIPTEN__
+  if (targetFrameRate > 0.0)
+    emscripten_set_main_loop_timing(EM_TIMING_SETTIMEOUT, int(std::lround(1000.0/targetFrameRate)));
+  else
+    setSync(sync);
+#endif
+}
+
+#ifndef __EMSCRIPTEN__
+double GLEnv::retireFrames(size_t frames) {
+  double latency{-1.0};
+  while (!frameFences.empty()) {
+    const FrameFence& oldest = frameFences.front();
+    // finished frames are retired without waiting, so that their latency
+    // is measured close to the time they completed
+    GLenum status = glClientWaitSync(oldest.sync, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      if (frameFences.size() <= frames) break;
+      TRACE_SCOPE("wait for GPU");
+      do {
+        status = glClientWaitSync(oldest.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+      } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    if (oldest.hasInput) latency = milliseconds(Clock::now() - oldest.input);
+    glDeleteSync(oldest.sync);
+    frameFences.pop_front();
+  }
+  return latency;
+}
+
+void GLEnv::waitForFrameDeadline() {
+  const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(1.0/targetFrameRate));
+  // OS sleeps overshoot by up to a scheduler tick, so wake up early and
+  // yield through the remainder
+  const Clock::duration spin = std::chrono::milliseconds(1);
+
+  Clock::time_point now = Clock::now();
+  if (frameDeadline > now) {
+    TRACE_SCOPE("frame limiter");
+    if (frameDeadline - now > spin) std::this_thread::sleep_until(frameDeadline - spin);
+    while ((now = Clock::now()) < frameDeadline) std::this_thread::yield();
+  }
+  frameDeadline = std::max(frameDeadline + period, now);
+}
+#endif
+
+void GLEnv::beginOfFrame() {
+  frameStart = Clock::now();
+  frameStarted = true;
+}
+
+double GLEnv::getTime() const {
+#ifdef __EMSCRIPTEN__
+  return emscripten_performance_now()/1000.0;
+#else
+  if (!window) return std::chrono::duration<double>(Clock::now() - creationTime).count();
+  return glfwGetTime();
+#endif
+}
+
+void GLEnv::setFrameLimit(uint64_t frames) {
+  frameLimit = frames;
+}
+
+void GLEnv::setFinalFrameExport(const std::string& filename) {
+  finalFrameFile = filename;
+  finalFrameSaved = false;
+}
+
+void GLEnv::saveFinalFrame() {
+  if (finalFrameFile.empty() || finalFrameSaved) return;
+  finalFrameSaved = true;
+  // BMP stores the bottom row first
+  if (!BMP::save(finalFrameFile, readFramebuffer().flipHorizontal()))
+    std::cerr << "Unable to write final frame to " << finalFrameFile << std::endl;
+}
+
+Image GLEnv::readFramebuffer() const {
+  const Dimensions dim{getFramebufferSize()};
+  const GLsizei w = GLsizei(dim.width);
+  const GLsizei h = GLsizei(dim.height);
+
+  GLint previousRead{0}, previousDraw{0}, previousAlignment{4};
+  GL(glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead));
+  GL(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw));
+  GL(glGetIntegerv(GL_PACK_ALIGNMENT, &previousAlignment));
+
+  // multisampled FBOs cannot be read directly, resolve into a temporary one
+  GLuint resolveFBO{0}, resolveColor{0};
+  if (defaultFramebufferID != 0 && offscreenSamples > 1) {
+    GL(glGenRenderbuffers(1, &resolveColor));
+    GL(glBindRenderbuffer(GL_RENDERBUFFER, resolveColor));
+    GL(glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h));
+    GL(glGenFramebuffers(1, &resolveFBO));
+    GL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFBO));
+    GL(glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveColor));
+    GL(glBindFramebuffer(GL_READ_FRAMEBUFFER, defaultFramebufferID));
+    GL(glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST));
+    GL(glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFBO));
+  } else {
+    GL(glBindFramebuffer(GL_READ_FRAMEBUFFER, defaultFramebufferID));
+    if (defaultFramebufferID == 0) GL(glReadBuffer(GL_BACK));
+  }
+
+  // RGBA/UNSIGNED_BYTE is the only combination every implementation accepts
+  std::vector<uint8_t> rgba(size_t(w)*size_t(h)*4);
+  GL(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+  GL(glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data()));
+
+  GL(glPixelStorei(GL_PACK_ALIGNMENT, previousAlignment));
+  GL(glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(previousRead)));
+  GL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousDraw)));
+  if (resolveFBO) {
+    GL(glDeleteFramebuffers(1, &resolveFBO));
+    GL(glDeleteRenderbuffers(1, &resolveColor));
+  }
+
+  Image image(dim.width, dim.height, 3);
+  for (size_t y = 0;y<dim.height;++y) {
+    const uint8_t* src = rgba.data() + (dim.height-1-y)*dim.width*4;
+    uint8_t* dst = image.data.data() + y*dim.width*3;
+    for (size_t x = 0;x<dim.width;++x) {
+      dst[3*x+0] = src[4*x+0];
+      dst[3*x+1] = src[4*x+1];
+      dst[3*x+2] = src[4*x+2];
+    }
+  }
+  return image;
+}
+
+void GLEnv::markInput() {
+  if (inputPending) return;
+  firstInput = Clock::now();
+  inputPending = true;
+}
+
+#ifdef __EMSCRIPTEN__
+static const char* saveFrameStatsOnUnload(int eventType, const void* reserved, void* userData) {
+  const GLEnv* env = static_cast<const GLEnv*>(userData);
+  env->getFrameStats().save("-");
+  return nullptr;
+}
+#endif
+
+void GLEnv::setFrameStatsExport(const std::string& filename) {
+  frameStatsFile = filename;
+#ifdef __EMSCRIPTEN__
+  // the destructor never runs in the browser, so hook page unload instead
+  emscripten_set_beforeunload_callback(filename.empty() ? nullptr : this,
+                                       filename.empty() ? nullptr : saveFrameStatsOnUnload);
+#endif
+}
+
+void GLEnv::endOfFrame() {
+  GLDebugOutput::clearErrorFlags();
+  presentedFrames++;
+  if (frameLimit > 0 && presentedFrames == frameLimit) saveFinalFrame();
+
+  const Clock::time_point presentStart = Clock::now();
+  if (!frameStarted) frameStart = lastPresent;
+
+  FrameSample sample;
+  sample.cpuMs = milliseconds(presentStart - frameStart);
+  sample.inputToPresentMs = -1.0;
+
+#ifdef __EMSCRIPTEN__
+  sample.swapMs = milliseconds(frameStart - lastPresent);
+  if (inputPending) sample.inputToPresentMs = milliseconds(presentStart - firstInput);
+  inputPending = false;
+  const Clock::time_point presentEnd = presentStart;
+#else
+  if (headless) {
+    // nothing to present; wait for the GPU like a blocking swap would
+    glFinish();
+  } else {
+    glfwSwapBuffers(window);
+    const Clock::time_point swapEnd = Clock::now();
+    if (maxFramesInFlight > 0) {
+      frameFences.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), inputPending, firstInput});
+      sample.inputToPresentMs = retireFrames(maxFramesInFlight - 1);
+    } else if (inputPending) {
+      sample.inputToPresentMs = milliseconds(swapEnd - firstInput);
+    }
+  }
+  inputPending = false;
+  if (targetFrameRate > 0.0) waitForFrameDeadline();
+  // events polled here are handled and presented in the next frame
+  if (window) glfwPollEvents();
+  const Clock::time_point presentEnd = Clock::now();
+  sample.swapMs = milliseconds(presentEnd - presentStart);
+#endif
+
+  sample.frameMs = milliseconds(presentEnd - lastPresent);
+  if (!firstFrame) frameStats.record(sample);
+  TRACE_COUNTER("frame ms", sample.frameMs);
+  firstFrame = false;
+  frameStarted = false;
+  lastPresent = presentEnd;
 
   if (fpsCounter) {
     frameCount++;
@@ -152,12 +498,16 @@ void GLEnv::endOfFrame() {
 #ifdef __EMSCRIPTEN__
       emscripten_set_window_title(s.str().c_str());
 #else
-      glfwSetWindowTitle(window, s.str().c_str());
+      if (window) glfwSetWindowTitle(window, s.str().c_str());
 #endif
       frameCount = 0;
       last = now;
     }
   }
+
+#ifdef __EMSCRIPTEN__
+  if (frameLimit > 0 && presentedFrames == frameLimit) emscripten_cancel_main_loop();
+#endif
 }
 
 #ifdef __EMSCRIPTEN__
@@ -187,20 +537,26 @@ void GLEnv::setResizeCallback(em_ui_callback_func f, void *userData) {
 }
 
 #else
+// headless environments have no window and never deliver input events
+
 void GLEnv::setKeyCallback(GLFWkeyfun f) {
+  if (!window) return;
   glfwSetKeyCallback(window, f);
 }
 
 void GLEnv::setKeyCallbacks(GLFWkeyfun f, GLFWcharfun c) {
+  if (!window) return;
   glfwSetKeyCallback(window, f);
   glfwSetCharCallback(window, c);
 }
 
 void GLEnv::setResizeCallback(GLFWframebuffersizefun f) {
+  if (!window) return;
   glfwSetFramebufferSizeCallback(window, f);
 }
 
 void GLEnv::setMouseCallbacks(GLFWcursorposfun p, GLFWmousebuttonfun b, GLFWscrollfun s) {
+  if (!window) return;
   glfwSetCursorPosCallback(window, p);
   glfwSetMouseButtonCallback(window, b);
   glfwSetScrollCallback(window, s);
@@ -212,6 +568,7 @@ Dimensions GLEnv::getFramebufferSize() const {
 #ifdef __EMSCRIPTEN__
   emscripten_get_canvas_element_size(ENS_CANVAS, &width, &height);
 #else
+  if (!window) return offscreenSize;
   glfwGetFramebufferSize(window, &width, &height);
 #endif
   return Dimensions{uint32_t(width), uint32_t(height)};
@@ -223,22 +580,26 @@ Dimensions GLEnv::getWindowSize() const {
 #ifdef __EMSCRIPTEN__
   emscripten_get_canvas_element_size(ENS_CANVAS, &width, &height);
 #else
+  if (!window) return offscreenSize;
   glfwGetWindowSize(window, &width, &height);
 #endif
   return Dimensions{uint32_t(width), uint32_t(height)};
 }
 
 bool GLEnv::shouldClose() const {
+  if (frameLimit > 0 && presentedFrames >= frameLimit) return true;
 #ifdef __EMSCRIPTEN__
   return false;
 #else
+  if (!window) return closeRequested;
   return glfwWindowShouldClose(window);
 #endif
 }
 
 void GLEnv::setClose() {
 #ifndef __EMSCRIPTEN__
-  glfwSetWindowShouldClose(window, GL_TRUE);
+  closeRequested = true;
+  if (window) glfwSetWindowShouldClose(window, GL_TRUE);
 #endif
 }
 
@@ -265,6 +626,7 @@ void GLEnv::setCursorMode(CursorMode mode) {
       break;
   }
 #else
+  if (!window) return;
   switch (mode) {
     case CursorMode::NORMAL :
       glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
@@ -3,6 +3,7 @@
 #include <memory>
 #include <string>
 #include <chrono>
+#include <deque>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten/emscripten.h>
@@ -14,6 +15,10 @@
 #endif
 
 #include "GLDebug.h"
+#include "FrameStats.h"
+#include "Image.h"
+
+class GLHeadlessContext;
 
 /**
  * @file GLEnv.h
@@ -30,9 +35,16 @@
  *  - Event callback registration for keyboard, mouse, and resize.
  *  - Frame lifecycle utilities: @ref endOfFrame() swaps buffers/polls events and
  *    updates an optional FPS counter in the window title.
+ *  - Per-frame CPU, swap, and input-to-present timings collected in a
+ *    @ref FrameStats ring (@ref getFrameStats()), optionally exported at exit.
  *  - Dimension queries (@ref getFramebufferSize(), @ref getWindowSize()).
- *  - VSync control (@ref setSync(), @ref getSync()).
+ *  - VSync control (@ref setSync(), @ref getSync()) and latency control:
+ *    a cap on the frames queued ahead of the GPU and a sleeping frame
+ *    limiter (@ref setMaxFramesInFlight(), @ref setTargetFrameRate()).
  *  - Simple cursor mode handling via @ref setCursorMode().
+ *  - A headless backend (EGL, no window or display server) that renders
+ *    into an offscreen framebuffer, plus a frame limit and readback of the
+ *    final frame for unattended runs (@ref GLEnvBackend).
  *
  * All GL error handling uses the utilities declared in @ref GLDebug.h.
  */
@@ -52,6 +64,30 @@ enum class GLDepthDataType {DEPTH16, DEPTH24, DEPTH32};
  */
 enum class CursorMode {NORMAL, HIDDEN, FIXED};
 
+/**
+ * @brief Context/presentation backend of a @ref GLEnv.
+ *
+ * \c HEADLESS creates the context through EGL without a window (Linux only;
+ * works on GPU drivers as well as on Mesa llvmpipe). Rendering goes to an
+ * offscreen FBO of the requested size, which is bound whenever the default
+ * framebuffer would be (see @ref GLEnv::defaultFramebuffer()). Input
+ * callbacks are ignored and the loop ends after the frame limit or
+ * @ref GLEnv::setClose().
+ *
+ * The backend is chosen when a @ref GLEnv is constructed: the environment
+ * variable \c GLENV_BACKEND ("window" or "headless") takes precedence over
+ * @ref GLEnv::setDefaultBackend(). \c GLENV_FRAMES and \c GLENV_FINAL_FRAME
+ * preset @ref GLEnv::setFrameLimit() and @ref GLEnv::setFinalFrameExport(),
+ * so any demo can run unattended, e.g.
+ * \code GLENV_BACKEND=headless GLENV_FRAMES=100 GLENV_FINAL_FRAME=out.bmp ./shadows \endcode
+ * Likewise \c GLENV_FRAME_STATS, \c GLENV_FRAMES_IN_FLIGHT, and
+ * \c GLENV_TARGET_FPS preset @ref GLEnv::setFrameStatsExport(),
+ * @ref GLEnv::setMaxFramesInFlight(), and @ref GLEnv::setTargetFrameRate().
+ * \c GLENV_PROGRAM_CACHE names a directory for
+ * @ref GLProgram::setBinaryCacheDirectory() (desktop only).
+ */
+enum class GLEnvBackend {WINDOW, HEADLESS};
+
 /**
  * @brief Window/context manager for OpenGL (GLFW+GLEW) or WebGL (Emscripten).
  *
@@ -79,6 +115,32 @@ public:
   /** @brief Destroy window/context (desktop) or release resources (web). */
   ~GLEnv();
 
+  /** @name Backend */
+  ///@{
+  /** @brief Backend used by environments constructed afterwards (unless overridden by \c GLENV_BACKEND). */
+  static void setDefaultBackend(GLEnvBackend backend);
+  /** @brief Backend of this environment. */
+  GLEnvBackend getBackend() const {return backend;}
+  /**
+   * @brief Framebuffer that stands in for the window's default framebuffer.
+   *
+   * 0 for windowed contexts, the offscreen FBO for headless ones. Code that
+   * returns from render-to-texture should bind this instead of 0.
+   */
+  static GLuint defaultFramebuffer() {
+    return redirectedFramebufferID ? redirectedFramebufferID : defaultFramebufferID;
+  }
+  /**
+   * @brief Let @ref defaultFramebuffer() return another FBO until called
+   *        with 0 again.
+   *
+   * Used while a frame is rendered into an intermediate target (see
+   * DynamicResolution), so passes that return from render-to-texture land
+   * in that target instead of the window.
+   */
+  static void redirectDefaultFramebuffer(GLuint framebuffer) {redirectedFramebufferID = framebuffer;}
+  ///@}
+
 #ifdef __EMSCRIPTEN__
   /** @brief Set key callback for Emscripten builds. */
   void setKeyCallback(em_key_callback_func f, void *userData);
@@ -113,15 +175,88 @@ public:
    */
   Dimensions getWindowSize() const;
   /**
-   * @brief Query whether the window should close (desktop always; web always false).
+   * @brief Query whether the main loop should end: window closed, @ref setClose()
+   *        called, or frame limit reached (web: frame limit only).
    */
   bool shouldClose() const;
-  /** @brief Request closing the window (desktop only; no‑op on web). */
+  /** @brief Request closing the window (desktop and headless; no‑op on web). */
   void setClose();
   /**
-   * @brief End‑of‑frame housekeeping: swap/poll + optional FPS title update.
+   * @brief Mark the start of the application's work for a frame.
+   *
+   * Optional; without it the CPU time of a frame is measured from the end of
+   * the previous @ref endOfFrame().
+   */
+  void beginOfFrame();
+  /**
+   * @brief End‑of‑frame housekeeping: swap, frame pacing, poll + optional
+   *        FPS title update.
+   *
+   * After the swap, waits for the GPU if more frames than
+   * @ref getMaxFramesInFlight() are queued, then sleeps up to the
+   * frame limiter's deadline, and only then polls events, so input is read
+   * as late as possible before the next frame.
+   *
+   * Also records a @ref FrameSample. The swap time is the duration of buffer
+   * swap, pacing, and event polling on desktop; on Emscripten, where the
+   * browser presents after the frame callback returns, it is the wait between
+   * the previous frame callback and this one.
    */
   void endOfFrame();
+  /**
+   * @brief Note that an input event arrived.
+   *
+   * The oldest event noted before a present defines that frame's
+   * input-to-present latency. @ref GLApp calls this from its input callbacks.
+   */
+  void markInput();
+
+  /**
+   * @brief Seconds since an arbitrary fixed point (GLFW timer when windowed).
+   */
+  double getTime() const;
+
+  /** @name Unattended runs */
+  ///@{
+  /**
+   * @brief End the main loop after @p frames presented frames (0 = no limit).
+   *
+   * @ref shouldClose() returns true once the limit is reached; on Emscripten
+   * the browser main loop is cancelled instead.
+   */
+  void setFrameLimit(uint64_t frames);
+  uint64_t getFrameLimit() const {return frameLimit;}
+  /** @brief Frames presented since construction. */
+  uint64_t getPresentedFrames() const {return presentedFrames;}
+  /**
+   * @brief Save the frame that reaches the frame limit as BMP.
+   *
+   * Headless environments without a limit save their last frame on destruction.
+   * @param filename Target file, empty to disable.
+   */
+  void setFinalFrameExport(const std::string& filename);
+  /**
+   * @brief Read the current contents of the default framebuffer.
+   *
+   * Reads the back buffer when windowed (call before @ref endOfFrame()) and
+   * resolves multisampling of the offscreen framebuffer when headless.
+   * @return RGB image with the top row first.
+   */
+  Image readFramebuffer() const;
+  ///@}
+
+  /** @name Frame statistics */
+  ///@{
+  const FrameStats& getFrameStats() const {return frameStats;}
+  FrameStats& getFrameStats() {return frameStats;}
+  /**
+   * @brief Save the frame statistics when the environment is destroyed.
+   * @param filename Target file (".json" for JSON, CSV otherwise), "-" for
+   *                 JSON on stdout, or empty to disable. Emscripten builds
+   *                 save when the page is unloaded.
+   */
+  void setFrameStatsExport(const std::string& filename);
+  ///@}
 
   /**
    * @brief Set mouse cursor behavior.
@@ -136,6 +271,39 @@ public:
   /** @brief Current vsync state. */
   bool getSync() const {return sync;}
 
+  /** @name Latency control */
+  ///@{
+  /**
+   * @brief Limit how many frames the CPU may submit ahead of the GPU.
+   *
+   * Drivers queue up to three frames by default, which with vsync adds up
+   * to three refresh intervals of input latency. With a limit, a fence is
+   * inserted after every present and @ref endOfFrame() blocks until no more
+   * than @p frames frames are unfinished; 1 keeps the CPU in lock-step
+   * with the GPU (lowest latency, least overlap). The input-to-present time
+   * of a @ref FrameSample is then measured up to the GPU finishing the frame
+   * that handled the input, rather than to the return of the swap. Needs
+   * sync objects (GL 3.2 or ARB_sync) and is ignored on Emscripten, where
+   * WebGL cannot block.
+   * @param frames 1 to 3, or 0 for the driver's default queueing.
+   */
+  void setMaxFramesInFlight(uint32_t frames);
+  uint32_t getMaxFramesInFlight() const {return maxFramesInFlight;}
+  /**
+   * @brief Cap the frame rate, e.g. with vsync off.
+   *
+   * @ref endOfFrame() sleeps until one frame period after the previous
+   * deadline and only spins for the last fraction of a millisecond, so an
+   * uncapped application no longer burns a core or runs the GPU flat out.
+   * A frame that misses its deadline starts the next period immediately
+   * instead of being followed by a burst. On Emscripten the browser loop
+   * is switched to timeout-based timing at the requested rate.
+   * @param fps Frames per second, or 0 to disable.
+   */
+  void setTargetFrameRate(double fps);
+  double getTargetFrameRate() const {return targetFrameRate;}
+  ///@}
+
   /**
    * @brief Convenience GL error check, logs to stderr with an identifier.
    * @param id Human‑readable label for the check site.
@@ -146,15 +314,66 @@ public:
   void setTitle(const std::string& title);
 
 private:
+  GLEnvBackend backend;                   ///< Selected backend.
 #ifndef __EMSCRIPTEN__
-  GLFWwindow* window; ///< GLFW window handle (desktop only).
+  GLFWwindow* window; ///< GLFW window handle (desktop only, nullptr when headless).
+  std::unique_ptr<GLHeadlessContext> headless; ///< EGL context (headless only).
 #endif
+  GLuint offscreenFBO;                    ///< Headless render target.
+  GLuint offscreenColor;                  ///< Color renderbuffer of offscreenFBO.
+  GLuint offscreenDepth;                  ///< Depth/stencil renderbuffer of offscreenFBO.
+  Dimensions offscreenSize;               ///< Size of the offscreen renderbuffers.
+  uint32_t offscreenSamples;              ///< Sample count of the offscreen renderbuffers.
+  bool closeRequested;                    ///< setClose() was called (headless).
+  uint64_t frameLimit;                    ///< Frames until shouldClose() (0 = unlimited).
+  uint64_t presentedFrames;               ///< Frames presented so far.
+  std::string finalFrameFile;             ///< BMP written for the last frame (empty = none).
+  bool finalFrameSaved;                   ///< finalFrameFile has been written.
+  std::chrono::high_resolution_clock::time_point creationTime; ///< Time base of getTime() when headless.
   bool sync;                              ///< VSync flag.
   std::string title;                      ///< Base window/page title.
   bool fpsCounter;                        ///< Enable FPS computation.
   std::chrono::high_resolution_clock::time_point last; ///< Time of last FPS update.
   uint64_t frameCount;                    ///< Frames accumulated since last title refresh.
+  FrameStats frameStats;                  ///< Ring of per-frame timings.
+  std::string frameStatsFile;             ///< Export target at exit (empty = none).
+  std::chrono::high_resolution_clock::time_point frameStart;  ///< Start of the current frame's work.
+  std::chrono::high_resolution_clock::time_point lastPresent; ///< End of the previous endOfFrame().
+  std::chrono::high_resolution_clock::time_point firstInput;  ///< Oldest input not yet presented.
+  bool frameStarted;                      ///< beginOfFrame() was called for the current frame.
+  bool inputPending;                      ///< firstInput is valid.
+  bool firstFrame;                        ///< Skip the first interval (includes startup).
+  uint32_t maxFramesInFlight;             ///< Frames-in-flight cap (0 = driver default).
+  double targetFrameRate;                 ///< Frame limiter rate (0 = off).
+  std::chrono::high_resolution_clock::time_point frameDeadline; ///< Earliest start of the next frame.
+#ifndef __EMSCRIPTEN__
+  /** @brief Fence of a presented frame and the oldest input it contains. */
+  struct FrameFence {
+    GLsync sync;
+    bool hasInput;
+    std::chrono::high_resolution_clock::time_point input;
+  };
+  std::deque<FrameFence> frameFences;     ///< Unfinished frames, oldest first.
+
+  /**
+   * @brief Retire finished frames and block until at most @p frames are
+   *        unfinished.
+   * @return Input-to-completion latency of the newest retired frame with
+   *         input, or -1.
+   */
+  double retireFrames(size_t frames);
+  /** @brief Sleep until frameDeadline and advance it by one period. */
+  void waitForFrameDeadline();
+#endif
+
+  static GLEnvBackend defaultBackend;    ///< Backend for new environments.
+  static GLuint defaultFramebufferID;     ///< See defaultFramebuffer().
+  static GLuint redirectedFramebufferID;  ///< See redirectDefaultFramebuffer().
 
   /** @brief GLFW error callback that throws a GLException (desktop only). */
   static void errorCallback(int error, const char* description);
+  /** @brief Create and bind the headless render target. */
+  void createOffscreenFramebuffer(uint32_t w, uint32_t h, uint32_t s);
+  /** @brief Write the final frame once, if requested. */
+  void saveFinalFrame();
 };
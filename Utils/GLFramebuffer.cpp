@@ -80,6 +80,42 @@ void GLFramebuffer::bind(const GLDepthTexture& d) {
   setBuffers(0, d.getWidth(), d.getHeight());
 }
 
+void GLFramebuffer::bind(const GLDepthTextureArray& d, size_t layer) {
+  GL(glBindFramebuffer(GL_FRAMEBUFFER, id));
+  GL(glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, d.getId(), 0, GLint(layer)));
+  setBuffers(0, d.getWidth(), d.getHeight());
+}
+
+void GLFramebuffer::bind(const GLDepthTextureCube& d, Face face) {
+  GL(glBindFramebuffer(GL_FRAMEBUFFER, id));
+  GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_TEXTURE_CUBE_MAP_POSITIVE_X + GLenum(face), d.getId(), 0));
+  setBuffers(0, d.getWidth(), d.getHeight());
+}
+
+void GLFramebuffer::bind(const GLTextureCube& t, Face face, const GLDepthBuffer& d) {
+  GL(glBindFramebuffer(GL_FRAMEBUFFER, id));
+  GL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, d.getId()));
+  GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_TEXTURE_CUBE_MAP_POSITIVE_X + GLenum(face), t.getId(), 0));
+  setBuffers(1, t.getWidth(), t.getHeight());
+}
+
+#ifndef __EMSCRIPTEN__
+void GLFramebuffer::bind(const GLDepthTextureCube& d) {
+  GL(glBindFramebuffer(GL_FRAMEBUFFER, id));
+  GL(glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, d.getId(), 0));
+  setBuffers(0, d.getWidth(), d.getHeight());
+}
+
+void GLFramebuffer::bind(const GLTextureCube& t, const GLDepthTextureCube& d) {
+  GL(glBindFramebuffer(GL_FRAMEBUFFER, id));
+  GL(glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, d.getId(), 0));
+  GL(glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, t.getId(), 0));
+  setBuffers(1, t.getWidth(), t.getHeight());
+}
+#endif
+
 void GLFramebuffer::bind(const GLTexture2D& t, const GLDepthTexture& d) {
   GL(glBindFramebuffer(GL_FRAMEBUFFER, id));
 
@@ -338,7 +374,7 @@ void GLFramebuffer::unbind3D() {
   GL(glFramebufferTextureLayer(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT2, 0, 0, 0));
 #endif
 
-  GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+  GL(glBindFramebuffer(GL_FRAMEBUFFER, GLEnv::defaultFramebuffer()));
 }
 
 void GLFramebuffer::unbind2D() {
@@ -360,7 +396,7 @@ void GLFramebuffer::unbind2D() {
   GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, 0, 0));
   GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, 0, 0));
 #endif
-  GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+  GL(glBindFramebuffer(GL_FRAMEBUFFER, GLEnv::defaultFramebuffer()));
 }
 
 bool GLFramebuffer::checkBinding() const {
@@ -371,6 +407,10 @@ const GLuint GLFramebuffer::getId() const {
   return id;
 }
 
+void GLFramebuffer::setLabel(const std::string& label) const {
+  GLDebugOutput::label(GL_FRAMEBUFFER, id, label);
+}
+
 void GLFramebuffer::setBuffers(size_t count, size_t width, size_t height) {
   switch (count) {
     case 0: {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "GLEnv.h"
@@ -8,6 +9,9 @@
 #include "GLTexture3D.h"
 #include "GLDepthBuffer.h"
 #include "GLDepthTexture.h"
+#include "GLDepthTextureArray.h"
+#include "GLDepthTextureCube.h"
+#include "GLTextureCube.h"
 
 /**
  * @file GLFramebuffer.h
@@ -37,9 +41,32 @@ public:
    */
   const GLuint getId() const;
 
+  /**
+   * @brief Name the framebuffer in driver debug messages and GPU debuggers.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label) const;
+
   // ===== Bind helpers: depth texture + color 2D textures =====
   /** @brief Bind only a depth texture (no color attachments; draw buffer = NONE). */
   void bind(const GLDepthTexture& d);
+  /** @brief Bind one layer of a depth texture array (no color attachments; draw buffer = NONE). */
+  void bind(const GLDepthTextureArray& d, size_t layer);
+  /** @brief Bind one face of a depth cube map (no color attachments; draw buffer = NONE). */
+  void bind(const GLDepthTextureCube& d, Face face);
+  /** @brief Bind one face of a color cube map plus a depth renderbuffer. */
+  void bind(const GLTextureCube& t, Face face, const GLDepthBuffer& d);
+#ifndef __EMSCRIPTEN__
+  /**
+   * @brief Bind all six faces of a depth cube map as a layered attachment.
+   *
+   * Layer i of the attachment is ::Face i; a geometry shader selects the face
+   * of each primitive by writing \c gl_Layer (see @ref CubeMapPass).
+   */
+  void bind(const GLDepthTextureCube& d);
+  /** @brief Bind all six faces of a color cube map plus a depth cube map as layered attachments. */
+  void bind(const GLTextureCube& t, const GLDepthTextureCube& d);
+#endif
   /** @brief Bind one 2D color texture plus a depth texture. */
   void bind(const GLTexture2D& t, const GLDepthTexture& d);
   /** @brief Bind two 2D color textures plus a depth texture. */
@@ -0,0 +1,273 @@
+#include <cstring>
+#include <sstream>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <dlfcn.h>
+#define GLHEADLESS_EGL
+#endif
+
+#include "GLEnv.h"
+#include "GLHeadlessContext.h"
+
+#ifdef GLHEADLESS_EGL
+
+// the few EGL declarations needed here, so that no EGL headers are required
+// at build time (libEGL itself is loaded with dlopen)
+typedef void* EGLDisplay;
+typedef void* EGLConfig;
+typedef void* EGLSurface;
+typedef void* EGLContext;
+typedef void* EGLDeviceEXT;
+typedef unsigned int EGLBoolean;
+typedef unsigned int EGLenum;
+typedef int32_t EGLint;
+
+#define EGL_FALSE                              0
+#define EGL_TRUE                               1
+#define EGL_DONT_CARE                          (-1)
+#define EGL_NONE                               0x3038
+#define EGL_ALPHA_SIZE                         0x3021
+#define EGL_BLUE_SIZE                          0x3022
+#define EGL_GREEN_SIZE                         0x3023
+#define EGL_RED_SIZE                           0x3024
+#define EGL_DEPTH_SIZE                         0x3025
+#define EGL_SURFACE_TYPE                       0x3033
+#define EGL_RENDERABLE_TYPE                    0x3040
+#define EGL_EXTENSIONS                         0x3055
+#define EGL_HEIGHT                             0x3056
+#define EGL_WIDTH                              0x3057
+#define EGL_CONTEXT_MAJOR_VERSION              0x3098
+#define EGL_OPENGL_API                         0x30A2
+#define EGL_CONTEXT_MINOR_VERSION              0x30FB
+#define EGL_CONTEXT_OPENGL_PROFILE_MASK        0x30FD
+#define EGL_CONTEXT_OPENGL_DEBUG               0x31B0
+#define EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE  0x31B1
+#define EGL_PLATFORM_DEVICE_EXT                0x313F
+#define EGL_PLATFORM_SURFACELESS_MESA          0x31DD
+#define EGL_PBUFFER_BIT                        0x0001
+#define EGL_OPENGL_BIT                         0x0008
+#define EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT    0x0001
+#define EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT 0x0002
+
+namespace {
+  struct EGLFunctions {
+    void* (*getProcAddress)(const char*);
+    EGLDisplay (*getDisplay)(void*);
+    EGLBoolean (*initialize)(EGLDisplay, EGLint*, EGLint*);
+    EGLBoolean (*terminate)(EGLDisplay);
+    const char* (*queryString)(EGLDisplay, EGLint);
+    EGLint (*getError)();
+    EGLBoolean (*bindAPI)(EGLenum);
+    EGLBoolean (*chooseConfig)(EGLDisplay, const EGLint*, EGLConfig*, EGLint, EGLint*);
+    EGLSurface (*createPbufferSurface)(EGLDisplay, EGLConfig, const EGLint*);
+    EGLBoolean (*destroySurface)(EGLDisplay, EGLSurface);
+    EGLContext (*createContext)(EGLDisplay, EGLConfig, EGLContext, const EGLint*);
+    EGLBoolean (*destroyContext)(EGLDisplay, EGLContext);
+    EGLBoolean (*makeCurrent)(EGLDisplay, EGLSurface, EGLSurface, EGLContext);
+    EGLDisplay (*getPlatformDisplayEXT)(EGLenum, void*, const EGLint*);
+    EGLBoolean (*queryDevicesEXT)(EGLint, EGLDeviceEXT*, EGLint*);
+  };
+
+  EGLFunctions egl{};
+
+  template <typename T>
+  void loadSymbol(void* library, T& f, const char* name) {
+    f = reinterpret_cast<T>(dlsym(library, name));
+  }
+
+  template <typename T>
+  void loadExtension(T& f, const char* name) {
+    f = reinterpret_cast<T>(egl.getProcAddress(name));
+  }
+
+  bool hasExtension(const char* extensions, const char* name) {
+    if (!extensions) return false;
+    const size_t length = strlen(name);
+    for (const char* p = strstr(extensions, name);p;p = strstr(p+length, name)) {
+      const bool startOK = p == extensions || p[-1] == ' ';
+      const bool endOK   = p[length] == ' ' || p[length] == 0;
+      if (startOK && endOK) return true;
+    }
+    return false;
+  }
+
+  std::string eglError(const std::string& what) {
+    std::stringstream s;
+    s << "Headless context: " << what << " (EGL error 0x" << std::hex << egl.getError() << ")";
+    return s.str();
+  }
+}
+
+GLHeadlessContext::GLHeadlessContext(int major, int minor, bool core, bool debug) :
+  library(nullptr),
+  display(nullptr),
+  surface(nullptr),
+  context(nullptr),
+  description()
+{
+  library = dlopen("libEGL.so.1", RTLD_NOW | RTLD_GLOBAL);
+  if (!library) library = dlopen("libEGL.so", RTLD_NOW | RTLD_GLOBAL);
+  if (!library) throw GLException{"Headless context: unable to load libEGL"};
+
+  loadSymbol(library, egl.getProcAddress,       "eglGetProcAddress");
+  loadSymbol(library, egl.getDisplay,           "eglGetDisplay");
+  loadSymbol(library, egl.initialize,           "eglInitialize");
+  loadSymbol(library, egl.terminate,            "eglTerminate");
+  loadSymbol(library, egl.queryString,          "eglQueryString");
+  loadSymbol(library, egl.getError,             "eglGetError");
+  loadSymbol(library, egl.bindAPI,              "eglBindAPI");
+  loadSymbol(library, egl.chooseConfig,         "eglChooseConfig");
+  loadSymbol(library, egl.createPbufferSurface, "eglCreatePbufferSurface");
+  loadSymbol(library, egl.destroySurface,       "eglDestroySurface");
+  loadSymbol(library, egl.createContext,        "eglCreateContext");
+  loadSymbol(library, egl.destroyContext,       "eglDestroyContext");
+  loadSymbol(library, egl.makeCurrent,          "eglMakeCurrent");
+  if (!egl.getProcAddress || !egl.getDisplay || !egl.initialize || !egl.makeCurrent ||
+      !egl.createContext || !egl.chooseConfig || !egl.bindAPI || !egl.queryString) {
+    release();
+    throw GLException{"Headless context: libEGL is incomplete"};
+  }
+  loadExtension(egl.getPlatformDisplayEXT, "eglGetPlatformDisplayEXT");
+  loadExtension(egl.queryDevicesEXT,       "eglQueryDevicesEXT");
+
+  // EGL_NO_DISPLAY queries client extensions (fails harmlessly without EGL_EXT_client_extensions)
+  const char* clientExtensions = egl.queryString(nullptr, EGL_EXTENSIONS);
+  std::string platform;
+  if (egl.getPlatformDisplayEXT && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+    display = egl.getPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, nullptr, nullptr);
+    platform = "Mesa surfaceless platform";
+  }
+  if (!display && egl.getPlatformDisplayEXT && egl.queryDevicesEXT &&
+      hasExtension(clientExtensions, "EGL_EXT_platform_device")) {
+    EGLDeviceEXT device{nullptr};
+    EGLint count{0};
+    if (egl.queryDevicesEXT(1, &device, &count) && count > 0) {
+      display = egl.getPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+      platform = "device platform";
+    }
+  }
+  if (!display) {
+    display = egl.getDisplay(nullptr);
+    platform = "default display";
+  }
+
+  EGLint eglMajor{0}, eglMinor{0};
+  if (!display || !egl.initialize(display, &eglMajor, &eglMinor)) {
+    display = nullptr;
+    const std::string msg = eglError("unable to initialize an EGL display");
+    release();
+    throw GLException{msg};
+  }
+
+  if (!egl.bindAPI(EGL_OPENGL_API)) {
+    const std::string msg = eglError("desktop OpenGL is not supported by EGL");
+    release();
+    throw GLException{msg};
+  }
+
+  const char* displayExtensions = egl.queryString(display, EGL_EXTENSIONS);
+  const bool surfaceless = hasExtension(displayExtensions, "EGL_KHR_surfaceless_context");
+
+  // all color/depth buffers live in GLEnv's FBO, the config only selects the API
+  EGLint configAttribs[] = {
+    EGL_SURFACE_TYPE,    surfaceless ? EGL_DONT_CARE : EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE,        8,
+    EGL_GREEN_SIZE,      8,
+    EGL_BLUE_SIZE,       8,
+    EGL_ALPHA_SIZE,      8,
+    EGL_DEPTH_SIZE,      EGL_DONT_CARE,
+    EGL_NONE
+  };
+  EGLConfig config{nullptr};
+  EGLint configCount{0};
+  if (!egl.chooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+    // surfaceless Mesa exposes configs without any color buffer bits
+    configAttribs[4] = EGL_NONE;
+    if (!egl.chooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+      const std::string msg = eglError("no suitable EGL config");
+      release();
+      throw GLException{msg};
+    }
+  }
+
+  EGLint contextAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION,             major,
+    EGL_CONTEXT_MINOR_VERSION,             minor,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK,       core ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT
+                                                : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+    EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE, core ? EGL_TRUE : EGL_FALSE,
+    EGL_CONTEXT_OPENGL_DEBUG,              debug ? EGL_TRUE : EGL_FALSE,
+    EGL_NONE
+  };
+  context = egl.createContext(display, config, nullptr, contextAttribs);
+  if (!context && debug) {
+    // EGL_CONTEXT_OPENGL_DEBUG requires EGL 1.5
+    contextAttribs[8] = EGL_NONE;
+    context = egl.createContext(display, config, nullptr, contextAttribs);
+  }
+  if (!context) {
+    std::stringstream s;
+    s << "unable to create an OpenGL " << major << "." << minor << (core ? " core" : "") << " context";
+    const std::string msg = eglError(s.str());
+    release();
+    throw GLException{msg};
+  }
+
+  if (!surfaceless) {
+    const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    surface = egl.createPbufferSurface(display, config, pbufferAttribs);
+    if (!surface) {
+      const std::string msg = eglError("unable to create a pbuffer surface");
+      release();
+      throw GLException{msg};
+    }
+  }
+
+  if (!egl.makeCurrent(display, surface, surface, context)) {
+    const std::string msg = eglError("unable to make the context current");
+    release();
+    throw GLException{msg};
+  }
+
+  std::stringstream s;
+  s << "EGL " << eglMajor << "." << eglMinor << " (" << platform
+    << (surfaceless ? ", surfaceless" : ", pbuffer") << ")";
+  description = s.str();
+}
+
+GLHeadlessContext::~GLHeadlessContext() {
+  release();
+}
+
+void GLHeadlessContext::release() {
+  if (display) {
+    egl.makeCurrent(display, nullptr, nullptr, nullptr);
+    if (context) egl.destroyContext(display, context);
+    if (surface) egl.destroySurface(display, surface);
+    egl.terminate(display);
+  }
+  context = surface = display = nullptr;
+  // libEGL stays loaded: vendor libraries may register atexit handlers
+  library = nullptr;
+}
+
+#else
+
+GLHeadlessContext::GLHeadlessContext(int, int, bool, bool) :
+  library(nullptr),
+  display(nullptr),
+  surface(nullptr),
+  context(nullptr),
+  description()
+{
+  throw GLException{"Headless rendering is only available on Linux (EGL)"};
+}
+
+GLHeadlessContext::~GLHeadlessContext() {
+}
+
+void GLHeadlessContext::release() {
+}
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @file GLHeadlessContext.h
+ * @brief Window-less OpenGL context creation through EGL (desktop Linux only).
+ *
+ * Used by @ref GLEnv when the headless backend is selected. The context has
+ * no usable default framebuffer; @ref GLEnv renders into an offscreen FBO
+ * instead. \c libEGL is loaded at runtime, so applications do not link
+ * against it and windowed runs are unaffected when it is missing.
+ *
+ * @details Display selection, in order of preference:
+ *  - \c EGL_MESA_platform_surfaceless (Mesa, including llvmpipe without GPU),
+ *  - \c EGL_EXT_platform_device (first enumerated device, e.g. NVIDIA),
+ *  - \c eglGetDisplay(EGL_DEFAULT_DISPLAY).
+ * The context is made current without a surface when the display supports
+ * \c EGL_KHR_surfaceless_context and with a 1x1 pbuffer otherwise.
+ */
+class GLHeadlessContext {
+public:
+  /**
+   * @brief Create a context and make it current on the calling thread.
+   * @param major Requested GL major version.
+   * @param minor Requested GL minor version.
+   * @param core  If true, request a forward-compatible core profile.
+   * @param debug If true, request a debug context (falls back to a regular
+   *              one if EGL does not support it).
+   * @throw GLException If EGL is unavailable or no suitable context can be created.
+   */
+  GLHeadlessContext(int major, int minor, bool core, bool debug=false);
+  /** @brief Release the context and terminate the display. */
+  ~GLHeadlessContext();
+
+  GLHeadlessContext(const GLHeadlessContext&) = delete;
+  GLHeadlessContext& operator=(const GLHeadlessContext&) = delete;
+
+  /** @brief Short description of the EGL platform and renderer for logs. */
+  const std::string& getDescription() const {return description;}
+
+private:
+  void* library;  ///< dlopen handle of libEGL.
+  void* display;  ///< EGLDisplay.
+  void* surface;  ///< EGLSurface (pbuffer) or EGL_NO_SURFACE.
+  void* context;  ///< EGLContext.
+  std::string description;
+
+  void release();
+};
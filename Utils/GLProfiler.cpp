@@ -0,0 +1,327 @@
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <functional>
+#include <filesystem>
+#include <iterator>
+
+#include "GLProfiler.h"
+
+#ifdef __EMSCRIPTEN__
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+#endif
+
+namespace {
+  // The HUD atlas was generated by Image::toCode(). Read into this plain
+  // aggregate, its pixels are static data; initializing a real Image's
+  // std::vector from them takes the compiler many minutes at -O2 and up.
+  namespace embedded {
+    struct Image {
+      uint32_t width;
+      uint32_t height;
+      uint8_t componentCount;
+      uint8_t data[1208*430*4];
+    };
+#include "helvetica_neue.inc"
+  }
+
+  ::Image hudFontImage() {
+    const embedded::Image& image = embedded::fontImage;
+    return ::Image{image.width, image.height, image.componentCount,
+                   std::vector<uint8_t>(std::begin(image.data), std::end(image.data))};
+  }
+}
+
+static const size_t npos = size_t(-1);
+
+bool GLProfiler::enabled = false;
+bool GLProfiler::requestedEnabled = false;
+bool GLProfiler::gpuSupported = false;
+bool GLProfiler::inFrame = false;
+std::vector<GLProfiler::Entry> GLProfiler::entries;
+std::vector<size_t> GLProfiler::scopeStack;
+std::vector<GLProfiler::Clock::time_point> GLProfiler::startStack;
+std::vector<size_t> GLProfiler::gpuStack;
+std::array<GLProfiler::QueryPool,2> GLProfiler::pools;
+size_t GLProfiler::currentPool = 0;
+GLProfiler::Clock::time_point GLProfiler::windowStart;
+std::vector<GLProfiler::ScopeStats> GLProfiler::stats;
+std::shared_ptr<FontEngine> GLProfiler::hudFont;
+
+void GLProfiler::Accumulator::add(double v) {
+  if (count == 0) {
+    min = max = v;
+  } else {
+    min = std::min(min, v);
+    max = std::max(max, v);
+  }
+  sum += v;
+  count++;
+}
+
+static double milliseconds(std::chrono::high_resolution_clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void GLProfiler::setEnabled(bool enabled) {
+  requestedEnabled = enabled;
+}
+
+void GLProfiler::beginFrame() {
+  if (requestedEnabled != enabled) {
+    if (!requestedEnabled) {
+      releaseQueries();
+      entries.clear();
+      stats.clear();
+    } else {
+#ifdef __EMSCRIPTEN__
+      gpuSupported = emscripten_webgl_enable_extension(emscripten_webgl_get_current_context(),
+                                                       "EXT_disjoint_timer_query_webgl2");
+#else
+      gpuSupported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+#endif
+      windowStart = Clock::now();
+    }
+    enabled = requestedEnabled;
+  }
+  if (!enabled) return;
+
+  if (entries.empty()) {
+    Entry root{};
+    root.name      = "frame";
+    root.parent    = npos;
+    root.gpuParent = npos;
+    entries.push_back(root);
+  }
+
+  // the pool about to be reused was recorded two frames ago
+  currentPool = (currentPool+1) % pools.size();
+  resolvePool(pools[currentPool]);
+
+  inFrame = true;
+  scopeStack.assign(1, 0);
+  startStack.assign(1, Clock::now());
+  gpuStack.clear();
+}
+
+void GLProfiler::endFrame() {
+  if (!enabled || !inFrame) return;
+  while (scopeStack.size() > 1) endScope();
+
+  const Clock::time_point now = Clock::now();
+  entries[0].cpuFrame += milliseconds(now - startStack[0]);
+  entries[0].cpuHit = true;
+  scopeStack.clear();
+  startStack.clear();
+  inFrame = false;
+
+  for (Entry& e : entries) {
+    if (!e.cpuHit) continue;
+    e.cpuTimes.add(e.cpuFrame);
+    e.cpuFrame = 0;
+    e.cpuHit = false;
+  }
+
+  if (now - windowStart >= std::chrono::seconds(1)) {
+    publishWindow();
+    windowStart = now;
+  }
+}
+
+size_t GLProfiler::findOrAddEntry(const char* name, bool gpu) {
+  const size_t parent = scopeStack.back();
+  for (size_t child : entries[parent].children) {
+    if (strcmp(entries[child].name.c_str(), name) == 0) {
+      entries[child].gpu = entries[child].gpu || gpu;
+      return child;
+    }
+  }
+
+  Entry e{};
+  e.name      = name;
+  e.parent    = parent;
+  e.gpuParent = gpuStack.empty() ? npos : gpuStack.back();
+  e.depth     = entries[parent].depth+1;
+  e.gpu       = gpu;
+  entries.push_back(e);
+  entries[parent].children.push_back(entries.size()-1);
+  return entries.size()-1;
+}
+
+void GLProfiler::beginScope(const char* name, bool gpu) {
+  if (!inFrame) {
+    // scopes outside of a frame are balanced but not recorded
+    scopeStack.push_back(npos);
+    return;
+  }
+
+  const size_t index = findOrAddEntry(name, gpu);
+  scopeStack.push_back(index);
+  startStack.push_back(Clock::now());
+
+  if (gpu && gpuSupported) {
+    if (!gpuStack.empty()) stopQuery();
+    gpuStack.push_back(index);
+    startQuery(index);
+  }
+}
+
+void GLProfiler::endScope() {
+  if (scopeStack.empty()) return;
+  const size_t index = scopeStack.back();
+  scopeStack.pop_back();
+  if (index == npos) return;
+
+  entries[index].cpuFrame += milliseconds(Clock::now() - startStack.back());
+  entries[index].cpuHit = true;
+  startStack.pop_back();
+
+  if (!gpuStack.empty() && gpuStack.back() == index) {
+    stopQuery();
+    gpuStack.pop_back();
+    if (!gpuStack.empty()) startQuery(gpuStack.back());
+  }
+}
+
+void GLProfiler::startQuery(size_t owner) {
+  QueryPool& pool = pools[currentPool];
+  if (pool.used == pool.queries.size()) {
+    GLuint query{0};
+    GL(glGenQueries(1, &query));
+    pool.queries.push_back(query);
+    pool.owners.push_back(npos);
+  }
+  pool.owners[pool.used] = owner;
+  GL(glBeginQuery(GL_TIME_ELAPSED, pool.queries[pool.used]));
+  pool.used++;
+}
+
+void GLProfiler::stopQuery() {
+  GL(glEndQuery(GL_TIME_ELAPSED));
+}
+
+void GLProfiler::resolvePool(QueryPool& pool) {
+  if (pool.used == 0) return;
+  const size_t used = pool.used;
+  pool.used = 0;
+
+  // never wait for the GPU: if the last query of that frame is not done yet,
+  // the frame's GPU samples are dropped
+  GLuint available{GL_FALSE};
+  GL(glGetQueryObjectuiv(pool.queries[used-1], GL_QUERY_RESULT_AVAILABLE, &available));
+  if (!available) return;
+#ifdef __EMSCRIPTEN__
+  GLint disjoint{0};
+  GL(glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint));
+  if (disjoint) return;
+#endif
+
+  for (size_t i = 0;i<used;++i) {
+#ifdef __EMSCRIPTEN__
+    GLuint nanoseconds{0};
+    GL(glGetQueryObjectuiv(pool.queries[i], GL_QUERY_RESULT, &nanoseconds));
+#else
+    GLuint64 nanoseconds{0};
+    GL(glGetQueryObjectui64v(pool.queries[i], GL_QUERY_RESULT, &nanoseconds));
+#endif
+    const double ms = double(nanoseconds) * 1e-6;
+    for (size_t e = pool.owners[i];e != npos && e < entries.size();e = entries[e].gpuParent) {
+      entries[e].gpuFrame += ms;
+      entries[e].gpuHit = true;
+    }
+  }
+
+  for (Entry& e : entries) {
+    if (!e.gpuHit) continue;
+    e.gpuTimes.add(e.gpuFrame);
+    e.gpuFrame = 0;
+    e.gpuHit = false;
+  }
+}
+
+void GLProfiler::publishWindow() {
+  stats.clear();
+  std::function<void(size_t)> visit = [&](size_t index) {
+    Entry& e = entries[index];
+    if (e.cpuTimes.count > 0) {
+      ScopeStats s;
+      s.name   = e.name;
+      s.depth  = e.depth;
+      s.gpu    = e.gpuTimes.count > 0;
+      s.cpuMin = float(e.cpuTimes.min);
+      s.cpuAvg = float(e.cpuTimes.sum / e.cpuTimes.count);
+      s.cpuMax = float(e.cpuTimes.max);
+      s.gpuMin = s.gpu ? float(e.gpuTimes.min) : 0.0f;
+      s.gpuAvg = s.gpu ? float(e.gpuTimes.sum / e.gpuTimes.count) : 0.0f;
+      s.gpuMax = s.gpu ? float(e.gpuTimes.max) : 0.0f;
+      stats.push_back(s);
+    }
+    e.cpuTimes = Accumulator{};
+    e.gpuTimes = Accumulator{};
+    for (size_t child : e.children) visit(child);
+  };
+  if (!entries.empty()) visit(0);
+}
+
+void GLProfiler::releaseQueries() {
+  for (QueryPool& pool : pools) {
+    if (!pool.queries.empty())
+      GL(glDeleteQueries(GLsizei(pool.queries.size()), pool.queries.data()));
+    pool = QueryPool{};
+  }
+}
+
+std::string GLProfiler::report() {
+  std::stringstream s;
+  s << std::fixed << std::setprecision(2);
+  for (const ScopeStats& st : stats) {
+    s << std::string(2*st.depth, ' ') << st.name
+      << "  cpu " << st.cpuAvg << " (" << st.cpuMin << "-" << st.cpuMax << ")";
+    if (st.gpu)
+      s << "  gpu " << st.gpuAvg << " (" << st.gpuMin << "-" << st.gpuMax << ")";
+    s << " ms\n";
+  }
+  return s.str();
+}
+
+void GLProfiler::setHUDFont(std::shared_ptr<FontEngine> font) {
+  hudFont = font;
+}
+
+void GLProfiler::drawHUD(float winAspect) {
+  if (stats.empty()) return;
+  if (!hudFont) {
+    const FontRenderer renderer{hudFontImage(), embedded::fontPos};
+#ifdef __EMSCRIPTEN__
+    hudFont = renderer.generateFontEngine();
+#else
+    std::error_code error;
+    const std::filesystem::path cacheDir = std::filesystem::temp_directory_path(error);
+    hudFont = error ? renderer.generateFontEngine()
+                    : renderer.generateFontEngine((cacheDir / "helvetica_neue.fontatlas").string());
+#endif
+  }
+
+  const GLboolean blend = glIsEnabled(GL_BLEND);
+  const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  GL(glDisable(GL_DEPTH_TEST));
+
+  const float height = 0.025f;
+  Vec2 pos{-0.98f, 0.98f-height};
+  std::stringstream lines{report()};
+  std::string line;
+  hudFont->beginBatch();
+  while (std::getline(lines, line)) {
+    hudFont->render(line, winAspect, height, pos, Alignment::Left, Vec4{1.0f,1.0f,0.0f,1.0f});
+    pos.y -= 2.2f*height;
+  }
+  hudFont->endBatch();
+
+  if (!blend) GL(glDisable(GL_BLEND));
+  if (depthTest) GL(glEnable(GL_DEPTH_TEST));
+}
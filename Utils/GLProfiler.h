@@ -0,0 +1,190 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GLEnv.h"
+#include "FontRenderer.h"
+
+/**
+ * @file GLProfiler.h
+ * @brief Nested CPU/GPU scope profiler with a text HUD.
+ *
+ * Code is instrumented with RAII scopes:
+ * @code
+ * void draw() override {
+ *   PROFILE_GPU("shadow pass");
+ *   ...
+ * }
+ * void animate(double t) override {
+ *   PROFILE_CPU("animate");
+ *   ...
+ * }
+ * @endcode
+ * CPU scopes measure wall-clock time. GPU scopes measure the CPU time as
+ * well and additionally wrap their GL commands in \c GL_TIME_ELAPSED
+ * queries. Queries are recorded into two alternating per-frame pools and
+ * read back only when a pool is reused two frames later, after checking
+ * \c GL_QUERY_RESULT_AVAILABLE, so profiling never stalls the pipeline.
+ * Because elapsed-time queries cannot nest, a nested GPU scope temporarily
+ * ends its parent's query and restarts it afterwards; parent times are the
+ * sum of their own segments and their children.
+ *
+ * Per-frame times are aggregated to min/avg/max over one-second windows and
+ * can be printed (@ref GLProfiler::report()) or drawn as an overlay
+ * (@ref GLProfiler::drawHUD()). @ref GLApp drives the frame boundaries,
+ * instruments animate/draw/endOfFrame, and toggles profiling and HUD with F3.
+ *
+ * @note While disabled, a scope costs a single branch; defining
+ *       \c GLPROFILER_DISABLED removes the macros altogether. The profiler
+ *       is meant to be used from the GL thread only.
+ */
+
+/**
+ * @brief Process-wide profiler state (all members are static).
+ */
+class GLProfiler {
+public:
+  /**
+   * @brief Aggregated timings of one scope over the last completed window (ms).
+   */
+  struct ScopeStats {
+    std::string name; ///< Scope label.
+    size_t depth;     ///< Nesting depth (0 = whole frame).
+    bool gpu;         ///< True if GPU times were recorded.
+    float cpuMin, cpuAvg, cpuMax; ///< CPU time per frame.
+    float gpuMin, gpuAvg, gpuMax; ///< GPU time per frame (0 if unavailable).
+  };
+
+  /**
+   * @brief Request enabling/disabling; takes effect at the next @ref beginFrame().
+   *
+   * Disabling releases all query objects and clears the statistics.
+   */
+  static void setEnabled(bool enabled);
+  /** @brief True while scopes are recorded. */
+  static bool isEnabled() {return enabled;}
+
+  /** @name Frame boundaries (called by GLApp) */
+  ///@{
+  static void beginFrame();
+  static void endFrame();
+  ///@}
+
+  /** @name Scope markers (prefer @ref ProfileScope / the PROFILE_* macros) */
+  ///@{
+  static void beginScope(const char* name, bool gpu);
+  static void endScope();
+  ///@}
+
+  /** @brief Statistics of the last completed window in depth-first order. */
+  static const std::vector<ScopeStats>& getStats() {return stats;}
+  /** @brief Multi-line text table of @ref getStats(). */
+  static std::string report();
+
+  /**
+   * @brief Draw the statistics as a text overlay in the top-left corner.
+   * @param winAspect Window aspect ratio (width/height).
+   *
+   * Uses the font set via @ref setHUDFont() or, on first use, the built-in
+   * Helvetica bitmap font, whose atlas is cached in the temporary directory
+   * after the first run (see @ref FontRenderer::generateFontEngine(const std::string&) const).
+   * Blend and depth test state are restored.
+   */
+  static void drawHUD(float winAspect);
+  /** @brief Replace the font used by @ref drawHUD(). */
+  static void setHUDFont(std::shared_ptr<FontEngine> font);
+
+private:
+  typedef std::chrono::high_resolution_clock Clock;
+
+  /** @brief Running min/sum/max of per-frame values. */
+  struct Accumulator {
+    double min{0}, max{0}, sum{0};
+    uint32_t count{0};
+    void add(double v);
+  };
+
+  /** @brief One node in the scope tree. */
+  struct Entry {
+    std::string name;
+    size_t parent;    ///< Parent entry (0 for top-level scopes, npos for the frame root).
+    size_t gpuParent; ///< Innermost enclosing GPU scope or npos.
+    size_t depth;
+    bool gpu;
+    std::vector<size_t> children;
+    double cpuFrame;  ///< CPU ms accumulated in the current frame.
+    double gpuFrame;  ///< GPU ms accumulated while resolving a pool.
+    bool cpuHit;      ///< Entered during the current frame.
+    bool gpuHit;      ///< Received GPU samples while resolving a pool.
+    Accumulator cpuTimes; ///< Per-frame CPU times in the current window.
+    Accumulator gpuTimes; ///< Per-frame GPU times in the current window.
+  };
+
+  /** @brief Query objects issued during one frame. */
+  struct QueryPool {
+    std::vector<GLuint> queries; ///< Allocated query names (grown on demand).
+    std::vector<size_t> owners;  ///< Entry owning each used query.
+    size_t used{0};              ///< Queries issued in the recorded frame.
+  };
+
+  static bool enabled;
+  static bool requestedEnabled;
+  static bool gpuSupported;
+  static bool inFrame;
+  static std::vector<Entry> entries;
+  static std::vector<size_t> scopeStack;
+  static std::vector<Clock::time_point> startStack;
+  static std::vector<size_t> gpuStack;
+  static std::array<QueryPool,2> pools;
+  static size_t currentPool;
+  static Clock::time_point windowStart;
+  static std::vector<ScopeStats> stats;
+  static std::shared_ptr<FontEngine> hudFont;
+
+  static size_t findOrAddEntry(const char* name, bool gpu);
+  static void startQuery(size_t owner);
+  static void stopQuery();
+  static void resolvePool(QueryPool& pool);
+  static void publishWindow();
+  static void releaseQueries();
+};
+
+/**
+ * @brief RAII marker that records the lifetime of a scope in @ref GLProfiler.
+ */
+class ProfileScope {
+public:
+  /**
+   * @param name Label (kept by pointer only while the scope lives, copied on first use).
+   * @param gpu  Also measure GPU time of the enclosed GL commands.
+   */
+  ProfileScope(const char* name, bool gpu=false) :
+    active(GLProfiler::isEnabled())
+  {
+    if (active) GLProfiler::beginScope(name, gpu);
+  }
+  ~ProfileScope() {
+    if (active) GLProfiler::endScope();
+  }
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+  bool active; ///< Profiler state at construction (keeps begin/end balanced).
+};
+
+#define GLPROFILER_CONCAT_IMPL(a, b) a##b
+#define GLPROFILER_CONCAT(a, b) GLPROFILER_CONCAT_IMPL(a, b)
+
+#ifdef GLPROFILER_DISABLED
+#define PROFILE_CPU(name)
+#define PROFILE_GPU(name)
+#else
+/** @brief Profile the rest of the enclosing block on the CPU. */
+#define PROFILE_CPU(name) ProfileScope GLPROFILER_CONCAT(profileScope, __LINE__){name, false}
+/** @brief Profile the rest of the enclosing block on CPU and GPU. */
+#define PROFILE_GPU(name) ProfileScope GLPROFILER_CONCAT(profileScope, __LINE__){name, true}
+#endif
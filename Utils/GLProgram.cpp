@@ -1,45 +1,71 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <iomanip>
+#include <iterator>
+#include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <random>
+#include <functional>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/html5.h>
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#endif
 
 #include "GLProgram.h"
 #include "GLDebug.h"
+#include "Trace.h"
 
 GLProgram::GLProgram(const GLProgram& other) :
   GLProgram(other.vertexShaderStrings, other.fragmentShaderStrings, other.geometryShaderStrings)
 {
+  if (!other.label.empty()) setLabel(other.label);
 }
 
 GLProgram& GLProgram::operator=(const GLProgram& other) {
+  unregisterPending();
   GL(glDeleteShader(glVertexShader));
   GL(glDeleteShader(glFragmentShader));
   GL(glDeleteShader(glGeometryShader));
   GL(glDeleteProgram(glProgram));
   programFromVectors(other.vertexShaderStrings, other.fragmentShaderStrings, other.geometryShaderStrings);
+  if (!other.label.empty()) setLabel(other.label);
   return *this;
 }
 
 GLuint GLProgram::createShader(GLenum type, const GLchar** src, GLsizei count) {
 	if (count==0) return 0;
+	// with debug output on, GL() leaves reported errors in the flags
+	GLDebugOutput::clearErrorFlags();
 	GLuint s = glCreateShader(type); checkAndThrow();
 	glShaderSource(s, count, src, NULL); checkAndThrow();
-	glCompileShader(s); checkAndThrowShader(s);
+	glCompileShader(s);
+	// inside a batch the status is checked later in resolve()
+	if (openBatches == 0) checkAndThrowShader(s);
 	return s;
 }
 
-GLProgram::GLProgram(std::vector<std::string> vertexShaderStrings, std::vector<std::string> fragmentShaderStrings, std::vector<std::string> geometryShaderStrings):
+GLProgram::GLProgram(std::vector<std::string> vertexShaderStrings, std::vector<std::string> fragmentShaderStrings, std::vector<std::string> geometryShaderStrings, const std::string& label):
   glVertexShader(0),
   glFragmentShader(0),
   glGeometryShader(0),
   glProgram(0),
   vertexShaderStrings(vertexShaderStrings),
   fragmentShaderStrings(fragmentShaderStrings),
-  geometryShaderStrings(geometryShaderStrings)
+  geometryShaderStrings(geometryShaderStrings),
+  pending(false),
+  label()
 {
   programFromVectors(vertexShaderStrings, fragmentShaderStrings, geometryShaderStrings);
+  if (!label.empty()) setLabel(label);
 }
 
 GLProgram::~GLProgram() {
+  unregisterPending();
 	GL(glDeleteShader(glVertexShader));
 	GL(glDeleteShader(glFragmentShader));
   GL(glDeleteShader(glGeometryShader));
@@ -60,7 +86,15 @@ GLProgram GLProgram::createFromFiles(const std::vector<std::string>& vs, const s
 		if (!f.empty())		
 			gsTexts.push_back(loadFile(f));
 	}
-	return createFromStrings(vsTexts,fsTexts,gsTexts);
+	std::vector<std::string> names;
+	for (const std::vector<std::string>* files : {&vs, &fs, &gs}) {
+		for (const std::string& f : *files) {
+			if (!f.empty()) names.push_back(std::filesystem::path(f).filename().string());
+		}
+	}
+	std::stringstream s;
+	for (size_t i = 0;i<names.size();++i) s << (i ? " + " : "") << names[i];
+	return {vsTexts,fsTexts,gsTexts,s.str()};
 }
 
 GLProgram GLProgram::createFromStrings(const std::vector<std::string>& vs, const std::vector<std::string>& fs, const std::vector<std::string>& gs) {
@@ -89,6 +123,8 @@ std::string GLProgram::loadFile(const std::string& filename) {
 }
 
 GLint GLProgram::getAttributeLocation(const std::string& id) const {
+  resolve();
+  GLDebugOutput::clearErrorFlags();
   const GLint l = glGetAttribLocation(glProgram, id.c_str());
 	checkAndThrow();	
 	if(l == -1)
@@ -97,6 +133,8 @@ GLint GLProgram::getAttributeLocation(const std::string& id) const {
 }
 
 GLint GLProgram::getUniformLocation(const std::string& id) const {
+  resolve();
+  GLDebugOutput::clearErrorFlags();
 	const GLint l = glGetUniformLocation(glProgram, id.c_str());
 	checkAndThrow();
 	if(l == -1)
@@ -105,9 +143,18 @@ GLint GLProgram::getUniformLocation(const std::string& id) const {
 }
 
 void GLProgram::enable() const {
+  resolve();
 	GL(glUseProgram(glProgram));
 }
 
+void GLProgram::setLabel(const std::string& label) {
+  this->label = label;
+  GLDebugOutput::label(GL_PROGRAM, glProgram, label);
+  GLDebugOutput::label(GL_SHADER, glVertexShader, label + " (vertex)");
+  GLDebugOutput::label(GL_SHADER, glFragmentShader, label + " (fragment)");
+  GLDebugOutput::label(GL_SHADER, glGeometryShader, label + " (geometry)");
+}
+
 void GLProgram::disable() const {
 	GL(glUseProgram(0));
 }
@@ -209,6 +256,18 @@ void GLProgram::setTexture(GLint id, const GLDepthTexture& texture, GLenum unit)
   GL(glUniform1i(id, GLint(unit)));
 }
 
+void GLProgram::setTexture(GLint id, const GLDepthTextureArray& texture, GLenum unit) const {
+  GL(glActiveTexture(GL_TEXTURE0 + unit));
+  GL(glBindTexture(GL_TEXTURE_2D_ARRAY, texture.getId()));
+  GL(glUniform1i(id, GLint(unit)));
+}
+
+void GLProgram::setTexture(GLint id, const GLDepthTextureCube& texture, GLenum unit) const {
+  GL(glActiveTexture(GL_TEXTURE0 + unit));
+  GL(glBindTexture(GL_TEXTURE_CUBE_MAP, texture.getId()));
+  GL(glUniform1i(id, GLint(unit)));
+}
+
 void GLProgram::setTexture(GLint id, const GLTexture2D& texture, GLenum unit) const {
 	GL(glActiveTexture(GL_TEXTURE0 + unit));
 	GL(glBindTexture(GL_TEXTURE_2D, texture.getId()));
@@ -239,6 +298,7 @@ void GLProgram::unsetTexture3D(GLenum unit) const {
 }
 
 void GLProgram::programFromVectors(std::vector<std::string> vs, std::vector<std::string> fs, std::vector<std::string> gs) {
+  TRACE_SCOPE("GLProgram::programFromVectors");
   vertexShaderStrings   = vs;
   fragmentShaderStrings = fs;
   geometryShaderStrings = gs;
@@ -256,17 +316,241 @@ void GLProgram::programFromVectors(std::vector<std::string> vs, std::vector<std:
    if (!s.empty())
      geometryShaderTexts.push_back(s.c_str());
 
+#ifndef __EMSCRIPTEN__
+  const std::string cacheFile = binaryCacheFilename();
+  if (!cacheFile.empty() && loadBinary(cacheFile)) {
+    glVertexShader = glFragmentShader = glGeometryShader = 0;
+    return;
+  }
+#endif
+
   glVertexShader = createShader(GL_VERTEX_SHADER, vertexShaderTexts.data(), GLsizei(vertexShaderTexts.size()));
   glFragmentShader = createShader(GL_FRAGMENT_SHADER, fragmentShaderTexts.data(), GLsizei(fragmentShaderTexts.size()));
   glGeometryShader = createShader(GL_GEOMETRY_SHADER, geometryShaderTexts.data(), GLsizei(geometryShaderTexts.size()));
 
+  GLDebugOutput::clearErrorFlags();
   glProgram = glCreateProgram(); checkAndThrow();
   if (glVertexShader) {glAttachShader(glProgram, glVertexShader); checkAndThrow();}
   if (glFragmentShader) {glAttachShader(glProgram, glFragmentShader); checkAndThrow();}
   if (glGeometryShader) {glAttachShader(glProgram, glGeometryShader); checkAndThrow();}
-  glLinkProgram(glProgram); checkAndThrowProgram(glProgram);
+#ifndef __EMSCRIPTEN__
+  if (!cacheFile.empty()) GL(glProgramParameteri(glProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+#endif
+  glLinkProgram(glProgram);
+
+  if (openBatches > 0) {
+    pending = true;
+    pendingPrograms.push_back(this);
+    return;
+  }
+
+  checkAndThrowProgram(glProgram);
+#ifndef __EMSCRIPTEN__
+  if (!cacheFile.empty()) storeBinary(cacheFile);
+#endif
+}
+
+void GLProgram::resolve() const {
+  if (!pending) return;
+  unregisterPending();
+
+  if (glVertexShader) checkAndThrowShader(glVertexShader);
+  if (glFragmentShader) checkAndThrowShader(glFragmentShader);
+  if (glGeometryShader) checkAndThrowShader(glGeometryShader);
+  checkAndThrowProgram(glProgram);
+#ifndef __EMSCRIPTEN__
+  const std::string cacheFile = binaryCacheFilename();
+  if (!cacheFile.empty()) storeBinary(cacheFile);
+#endif
 }
 
+void GLProgram::unregisterPending() const {
+  if (!pending) return;
+  pending = false;
+  pendingPrograms.erase(std::remove(pendingPrograms.begin(), pendingPrograms.end(), this),
+                        pendingPrograms.end());
+}
+
+bool GLProgram::isReady() const {
+  if (!pending || !parallelCompileSupported()) return true;
+  GLint done{GL_TRUE};
+  GL(glGetProgramiv(glProgram, GL_COMPLETION_STATUS_KHR, &done));
+  return done == GL_TRUE;
+}
+
+bool GLProgram::parallelCompileSupported() {
+#ifdef __EMSCRIPTEN__
+  static const bool supported = emscripten_webgl_enable_extension(emscripten_webgl_get_current_context(),
+                                                                   "KHR_parallel_shader_compile");
+#else
+  static const bool supported = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+#endif
+  return supported;
+}
+
+size_t GLProgram::openBatches = 0;
+std::vector<const GLProgram*> GLProgram::pendingPrograms;
+
+GLProgramBatch::GLProgramBatch() :
+  open(true)
+{
+  ++GLProgram::openBatches;
+#ifndef __EMSCRIPTEN__
+  // 0xFFFFFFFF lets the implementation pick the number of compiler threads
+  if (GLEW_KHR_parallel_shader_compile) {
+    GL(glMaxShaderCompilerThreadsKHR(0xFFFFFFFF));
+  } else if (GLEW_ARB_parallel_shader_compile) {
+    GL(glMaxShaderCompilerThreadsARB(0xFFFFFFFF));
+  }
+#endif
+}
+
+GLProgramBatch::~GLProgramBatch() {
+  if (open) --GLProgram::openBatches;
+}
+
+void GLProgramBatch::finish() {
+  TRACE_SCOPE("GLProgramBatch::finish");
+  if (open) {
+    open = false;
+    --GLProgram::openBatches;
+  }
+
+  // validate programs as they complete, the rest keep compiling in the driver
+  while (!GLProgram::pendingPrograms.empty()) {
+    const std::vector<const GLProgram*> waiting = GLProgram::pendingPrograms;
+    bool progress = false;
+    for (const GLProgram* program : waiting) {
+      if (program->isReady()) {
+        program->resolve();
+        progress = true;
+      }
+    }
+    if (!progress) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+size_t GLProgramBatch::pendingCount() {
+  return GLProgram::pendingPrograms.size();
+}
+
+#ifndef __EMSCRIPTEN__
+std::string GLProgram::binaryCacheDirectory = "";
+
+void GLProgram::setBinaryCacheDirectory(const std::string& directory) {
+  binaryCacheDirectory = directory;
+}
+
+const std::string& GLProgram::getBinaryCacheDirectory() {
+  return binaryCacheDirectory;
+}
+
+static void hashString(uint64_t& hash, const std::string& s) {
+  // 64 bit FNV-1a, terminated so that {"ab","c"} and {"a","bc"} differ
+  for (const char c : s) {
+    hash ^= uint8_t(c);
+    hash *= 0x100000001b3ull;
+  }
+  hash ^= 0xff;
+  hash *= 0x100000001b3ull;
+}
+
+static std::string glString(GLenum name) {
+  const GLubyte* s = glGetString(name);
+  return s ? std::string(reinterpret_cast<const char*>(s)) : std::string();
+}
+
+std::string GLProgram::binaryCacheFilename() const {
+  if (binaryCacheDirectory.empty()) return "";
+
+  GLint formatCount{0};
+  GL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+  if (formatCount == 0) return "";
+
+  uint64_t hash = 0xcbf29ce484222325ull;
+  hashString(hash, glString(GL_VENDOR));
+  hashString(hash, glString(GL_RENDERER));
+  hashString(hash, glString(GL_VERSION));
+  for (const std::string& s : vertexShaderStrings) hashString(hash, s);
+  hashString(hash, "#vs");
+  for (const std::string& s : fragmentShaderStrings) hashString(hash, s);
+  hashString(hash, "#fs");
+  for (const std::string& s : geometryShaderStrings) hashString(hash, s);
+  hashString(hash, "#gs");
+
+  std::stringstream s;
+  s << binaryCacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+  return s.str();
+}
+
+/** Clear the GL error flags, bounded like GL() since some contexts never clear them. */
+static void discardGLErrors() {
+  for (uint32_t i = 0;i<MAX_GL_ERROR_COUNT && glGetError() != GL_NO_ERROR;++i) {}
+}
+
+bool GLProgram::loadBinary(const std::string& filename) {
+  std::ifstream file{filename, std::ios::binary};
+  if (!file) return false;
+
+  char magic[4];
+  uint32_t format{0};
+  file.read(magic, 4);
+  file.read(reinterpret_cast<char*>(&format), sizeof(format));
+  if (!file || std::string(magic,4) != "GLPB") return false;
+  const std::vector<char> binary{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  if (binary.empty()) return false;
+
+  GLDebugOutput::clearErrorFlags();
+  glProgram = glCreateProgram(); checkAndThrow();
+  // the driver may refuse binaries from another driver version; only that
+  // error is expected and discarded, so clear the flags right before the call
+  discardGLErrors();
+  glProgramBinary(glProgram, GLenum(format), binary.data(), GLsizei(binary.size()));
+  discardGLErrors();
+  GLint linked{GL_FALSE};
+  GL(glGetProgramiv(glProgram, GL_LINK_STATUS, &linked));
+  if (linked != GL_TRUE) {
+    GL(glDeleteProgram(glProgram));
+    glProgram = 0;
+    return false;
+  }
+  return true;
+}
+
+void GLProgram::storeBinary(const std::string& filename) const {
+  GLint length{0};
+  GL(glGetProgramiv(glProgram, GL_PROGRAM_BINARY_LENGTH, &length));
+  if (length <= 0) return;
+
+  std::vector<char> binary(size_t(length), 0);
+  GLenum format{0};
+  GL(glGetProgramBinary(glProgram, length, nullptr, &format, binary.data()));
+
+  std::error_code ec;
+  std::filesystem::create_directories(binaryCacheDirectory, ec);
+  if (ec) return;
+
+  // write to a temporary file of our own first, so concurrent runs (or
+  // threads) never see partial files nor write into each other's
+  std::stringstream tmp;
+  tmp << filename << "." << std::hex << std::random_device{}()
+      << std::hash<std::thread::id>{}(std::this_thread::get_id()) << ".tmp";
+  const std::string tmpFilename = tmp.str();
+  bool written{false};
+  {
+    std::ofstream file{tmpFilename, std::ios::binary};
+    if (!file) return;
+    const uint32_t format32 = uint32_t(format);
+    file.write("GLPB", 4);
+    file.write(reinterpret_cast<const char*>(&format32), sizeof(format32));
+    file.write(binary.data(), std::streamsize(binary.size()));
+    written = bool(file);
+  }
+  if (written) std::filesystem::rename(tmpFilename, filename, ec);
+  if (!written || ec) std::filesystem::remove(tmpFilename, ec);
+}
+#endif
+
 
 void GLProgram::setUniform(const std::string& id, float value) const {
   setUniform(getUniformLocation(id), value);
@@ -311,6 +595,14 @@ void GLProgram::setTexture(const std::string& id, const GLDepthTexture& texture,
   setTexture(getUniformLocation(id), texture, unit);
 }
 
+void GLProgram::setTexture(const std::string& id, const GLDepthTextureArray& texture, GLenum unit) const {
+  setTexture(getUniformLocation(id), texture, unit);
+}
+
+void GLProgram::setTexture(const std::string& id, const GLDepthTextureCube& texture, GLenum unit) const {
+  setTexture(getUniformLocation(id), texture, unit);
+}
+
 void GLProgram::setTexture(const std::string& id, const GLTexture2D& texture, GLenum unit) const {
   setTexture(getUniformLocation(id), texture, unit);
 }
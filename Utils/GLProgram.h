@@ -14,6 +14,8 @@
 #include "GLTexture2D.h"
 #include "GLTexture3D.h"
 #include "GLDepthTexture.h"
+#include "GLDepthTextureArray.h"
+#include "GLDepthTextureCube.h"
 #include "GLTextureCube.h"
 #ifndef __EMSCRIPTEN__
 #include "GLTexture1D.h"
@@ -143,6 +145,8 @@ public:
   ///@{
   void setTexture(const std::string& id, const GLTextureCube& texture, GLenum unit=0) const;
   void setTexture(const std::string& id, const GLDepthTexture& texture, GLenum unit=0) const;
+  void setTexture(const std::string& id, const GLDepthTextureArray& texture, GLenum unit=0) const;
+  void setTexture(const std::string& id, const GLDepthTextureCube& texture, GLenum unit=0) const;
   void setTexture(const std::string& id, const GLTexture2D& texture, GLenum unit=0) const;
   void setTexture(const std::string& id, const GLTexture3D& texture, GLenum unit=0) const;
   ///@}
@@ -183,6 +187,8 @@ public:
   ///@{
   void setTexture(GLint id, const GLTextureCube& texture, GLenum unit=0) const;
   void setTexture(GLint id, const GLDepthTexture& texture, GLenum unit=0) const;
+  void setTexture(GLint id, const GLDepthTextureArray& texture, GLenum unit=0) const;
+  void setTexture(GLint id, const GLDepthTextureCube& texture, GLenum unit=0) const;
   void setTexture(GLint id, const GLTexture2D& texture, GLenum unit=0) const;
   void setTexture(GLint id, const GLTexture3D& texture, GLenum unit=0) const;
   ///@}
@@ -201,7 +207,49 @@ public:
   /** @brief Unbind any program (glUseProgram(0)). */
   void disable() const;
 
+  /**
+   * @brief Name the program and its shaders in driver debug messages and GPU
+   *        debuggers. Programs created from files are labelled with the file
+   *        names; copies keep the label.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label);
+
+  /**
+   * @brief Non-blocking check whether a batched compile/link has finished.
+   *
+   * Returns true for programs built outside a @ref GLProgramBatch and when
+   * the driver does not expose \c GL_COMPLETION_STATUS_KHR.
+   */
+  bool isReady() const;
+
+#ifndef __EMSCRIPTEN__
+  /**
+   * @name Program binary cache
+   * @brief Reuse linked program binaries across application runs.
+   *
+   * When a cache directory is set, every program built afterwards is first
+   * looked up by a hash of its shader sources and the driver's vendor,
+   * renderer, and version strings. A hit is restored via glProgramBinary; a
+   * miss (or a binary the driver rejects, e.g. after a driver update) falls
+   * back to compiling from source and stores the new binary.
+   *
+   * @note Set the directory before constructing a @ref GLApp so its stock
+   *       programs are cached too, or set \c GLENV_PROGRAM_CACHE, which
+   *       @ref GLEnv reads on construction. Not available on WebGL.
+   */
+  ///@{
+  /** @brief Enable the cache in @p directory (created on demand); empty disables it. */
+  static void setBinaryCacheDirectory(const std::string& directory);
+  /** @brief Current cache directory (empty if disabled). */
+  static const std::string& getBinaryCacheDirectory();
+  ///@}
+#endif
+
 private:
+  friend class GLProgramBatch;
+  friend class GLProgramVariants;
+
   GLuint glVertexShader;   ///< Compiled vertex shader name (0 if none).
   GLuint glFragmentShader; ///< Compiled fragment shader name (0 if none).
   GLuint glGeometryShader; ///< Compiled geometry shader name (0 if none).
@@ -210,6 +258,11 @@ private:
   std::vector<std::string> vertexShaderStrings;   ///< Source strings used to build the vertex shader.
   std::vector<std::string> fragmentShaderStrings; ///< Source strings used to build the fragment shader.
   std::vector<std::string> geometryShaderStrings; ///< Source strings used to build the geometry shader.
+  mutable bool pending;                           ///< Submitted in a batch but status not yet checked.
+  std::string label;                              ///< Debug label (see setLabel()).
+
+  static size_t openBatches;                      ///< Number of live @ref GLProgramBatch scopes.
+  static std::vector<const GLProgram*> pendingPrograms; ///< Programs awaiting @ref resolve().
 
   /** @brief Load a text file completely into a string (throws on failure). */
   static std::string loadFile(const std::string& filename);
@@ -217,9 +270,79 @@ private:
   /** @brief Create and compile a shader of \p type from \p count strings. */
   static GLuint createShader(GLenum type, const GLchar** src, GLsizei count);
 
-  /** @brief Private ctor used by the factory helpers. */
-  GLProgram(std::vector<std::string> vertexShaderStrings, std::vector<std::string> fragmentShaderStrings, std::vector<std::string> geometryShaderStrings);
+  /** @brief Private ctor used by the factory helpers (@p label as in setLabel()). */
+  GLProgram(std::vector<std::string> vertexShaderStrings, std::vector<std::string> fragmentShaderStrings, std::vector<std::string> geometryShaderStrings,
+            const std::string& label="");
 
   /** @brief Build and link GL objects from source vectors. */
   void programFromVectors(std::vector<std::string> vs, std::vector<std::string> fs, std::vector<std::string> gs);
+
+  /** @brief Check compile/link status of a pending program (blocks until done, throws on failure). */
+  void resolve() const;
+  /** @brief Remove this program from @ref pendingPrograms. */
+  void unregisterPending() const;
+  /** @brief True if the driver reports \c GL_COMPLETION_STATUS_KHR. */
+  static bool parallelCompileSupported();
+
+#ifndef __EMSCRIPTEN__
+  static std::string binaryCacheDirectory; ///< Program binary cache location (empty = off).
+
+  /** @brief Cache file for the current sources, or empty if caching is off/unsupported. */
+  std::string binaryCacheFilename() const;
+  /** @brief Try to restore @ref glProgram from @p filename; false if missing or rejected. */
+  bool loadBinary(const std::string& filename);
+  /** @brief Write the linked binary of @ref glProgram to @p filename (best effort). */
+  void storeBinary(const std::string& filename) const;
+#endif
+};
+
+/**
+ * @brief Scope in which new programs are compiled and linked asynchronously.
+ *
+ * While a batch is open, the @ref GLProgram factories only submit the shader
+ * sources and the link request to the driver and return immediately; the
+ * compile and link status is checked later. With
+ * \c GL_KHR_parallel_shader_compile the driver works on all submitted
+ * programs concurrently, so startup cost is bounded by the slowest program
+ * instead of the sum of all of them.
+ *
+ * @details Typical usage:
+ * @code
+ * GLProgramBatch batch;
+ * GLProgram a = GLProgram::createFromFile("a.vert", "a.frag");
+ * GLProgram b = GLProgram::createFromFile("b.vert", "b.frag");
+ * batch.finish();   // waits for both, throws on compile/link errors
+ * @endcode
+ *
+ * A pending program that is used before @ref finish() (enable, location
+ * queries) is completed on the spot, so batching never changes semantics,
+ * it only moves the point where errors surface. @ref GLApp keeps a batch
+ * open from its constructor until the end of @ref GLApp::init(), so the
+ * stock programs and all programs created by a demo's constructor and
+ * init() are compiled together.
+ */
+class GLProgramBatch {
+public:
+  /** @brief Open the batch and ask the driver for as many compiler threads as it likes. */
+  GLProgramBatch();
+  /** @brief Close the batch; programs still pending complete lazily on first use. */
+  ~GLProgramBatch();
+
+  GLProgramBatch(const GLProgramBatch&) = delete;
+  GLProgramBatch& operator=(const GLProgramBatch&) = delete;
+
+  /**
+   * @brief Wait for every pending program and check its status, then close the batch.
+   *
+   * Polls \c GL_COMPLETION_STATUS_KHR and validates programs in the order
+   * they finish.
+   * @throw GLException with the info log of the first failing shader/program.
+   */
+  void finish();
+
+  /** @brief Number of programs that have been submitted but not yet checked. */
+  static size_t pendingCount();
+
+private:
+  bool open; ///< False once @ref finish() or the destructor closed the batch.
 };
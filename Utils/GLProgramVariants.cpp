@@ -0,0 +1,109 @@
+#include <sstream>
+#include <algorithm>
+#include <utility>
+
+#include "GLProgramVariants.h"
+
+GLProgramVariants GLProgramVariants::createFromFile(const std::string& vs, const std::string& fs,
+                                                    const std::string& gs) {
+  return {GLProgram::loadFile(vs), GLProgram::loadFile(fs),
+          gs.empty() ? std::string() : GLProgram::loadFile(gs)};
+}
+
+GLProgramVariants GLProgramVariants::createFromString(const std::string& vs, const std::string& fs,
+                                                      const std::string& gs) {
+  return {vs, fs, gs};
+}
+
+GLProgramVariants::GLProgramVariants(const std::string& vs, const std::string& fs, const std::string& gs) {
+  vertexSource   = parseStage(vs);
+  fragmentSource = parseStage(fs);
+  geometrySource = parseStage(gs);
+}
+
+std::string GLProgramVariants::versionHeader() {
+#ifdef __EMSCRIPTEN__
+  return "#version 300 es\n"
+         "precision highp float;\n"
+         "precision highp int;\n"
+         "precision highp sampler3D;\n"
+         "precision highp sampler2DShadow;\n"
+         "precision highp sampler2DArrayShadow;\n"
+         "precision highp samplerCubeShadow;\n";
+#else
+  return "#version 410 core\n";
+#endif
+}
+
+std::string GLProgramVariants::parseStage(const std::string& source) {
+  std::stringstream input{source};
+  std::string result;
+  std::string line;
+  while (std::getline(input, line)) {
+    std::stringstream tokenizer{line};
+    std::string directive;
+    tokenizer >> directive;
+
+    if (directive == "#version") {
+      // replaced by versionHeader(), keep the line so error logs still match the file
+      line.clear();
+    } else if (directive == "#pragma") {
+      std::string pragma;
+      tokenizer >> pragma;
+      if (pragma == "features") {
+        std::string feature;
+        while (tokenizer >> feature) {
+          if (std::find(features.begin(), features.end(), feature) != features.end()) continue;
+          if (features.size() == 32)
+            throw ProgramException{"GLProgramVariants: more than 32 features declared"};
+          features.push_back(feature);
+        }
+        line.clear();
+      }
+    }
+    result += line + "\n";
+  }
+  return result;
+}
+
+uint32_t GLProgramVariants::featureMask(const std::vector<std::string>& enabled) const {
+  uint32_t mask = 0;
+  for (const std::string& f : enabled) {
+    const auto it = std::find(features.begin(), features.end(), f);
+    if (it == features.end())
+      throw ProgramException{std::string("GLProgramVariants: unknown feature ") + f};
+    mask |= 1u << uint32_t(it - features.begin());
+  }
+  return mask;
+}
+
+std::vector<std::string> GLProgramVariants::stageStrings(const std::string& source, uint32_t mask) const {
+  if (source.empty()) return {};
+
+  std::string defines;
+  for (size_t i = 0;i<features.size();++i) {
+    if (mask & (1u << i)) defines += "#define " + features[i] + " 1\n";
+  }
+  return {versionHeader() + defines + "#line 1\n", source};
+}
+
+const GLProgram& GLProgramVariants::get(uint32_t mask) {
+  auto it = variants.find(mask);
+  if (it == variants.end()) {
+    // the constructor is private to friends, so std::make_unique cannot reach it
+    std::unique_ptr<GLProgram> program{new GLProgram(stageStrings(vertexSource, mask),
+                                                     stageStrings(fragmentSource, mask),
+                                                     stageStrings(geometrySource, mask))};
+    std::string label = "variant";
+    for (size_t i = 0;i<features.size();++i) {
+      if (mask & (1u << i)) label += " " + features[i];
+    }
+    program->setLabel(label);
+    it = variants.emplace(mask, std::move(program)).first;
+  }
+  return *it->second;
+}
+
+const GLProgram& GLProgramVariants::get(const std::vector<std::string>& enabled) {
+  return get(featureMask(enabled));
+}
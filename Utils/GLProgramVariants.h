@@ -0,0 +1,95 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GLProgram.h"
+
+/**
+ * @file GLProgramVariants.h
+ * @brief Compile-time specialisation of one shader source into cached program variants.
+ *
+ * A variant source is a regular GLSL shader without (or with an ignored)
+ * \c #version line that declares the feature keys it understands:
+ * @code
+ * #pragma features TEXTURED NORMAL_MAP_MASK
+ * ...
+ * #ifdef TEXTURED
+ *   vec3 kd = texture(td, texCoords).rgb;
+ * #else
+ *   const vec3 kd = vec3(0.0, 0.0, 0.8);
+ * #endif
+ * @endcode
+ * For each requested feature combination the library prepends the version
+ * header of the current target (GLSL 4.10 core on desktop, GLSL ES 3.00 with
+ * default precisions on Emscripten) and one \c #define per enabled feature,
+ * so branches that only depend on the feature set are removed by the
+ * preprocessor instead of being evaluated per fragment. Compiled variants are
+ * cached by their feature bit mask.
+ *
+ * @note Features may be declared in any stage; all stages of a variant see
+ *       the same set of defines. At most 32 features are supported.
+ */
+class GLProgramVariants {
+public:
+  /**
+   * @name Factory helpers
+   */
+  ///@{
+  /**
+   * @brief Load variant sources from files.
+   * @throw ProgramException on file read errors or invalid feature declarations.
+   */
+  static GLProgramVariants createFromFile(const std::string& vs, const std::string& fs,
+                                          const std::string& gs="");
+  /**
+   * @brief Use in-memory variant sources.
+   * @throw ProgramException on invalid feature declarations.
+   */
+  static GLProgramVariants createFromString(const std::string& vs, const std::string& fs,
+                                            const std::string& gs="");
+  ///@}
+
+  GLProgramVariants(GLProgramVariants&&) = default;
+  GLProgramVariants& operator=(GLProgramVariants&&) = default;
+
+  /**
+   * @brief Bit mask for a set of feature names (bit i = i-th declared feature).
+   * @throw ProgramException if a name was not declared by the sources.
+   */
+  uint32_t featureMask(const std::vector<std::string>& features) const;
+
+  /**
+   * @brief Program specialised for @p mask, compiled on first request.
+   *
+   * The returned reference stays valid for the lifetime of this object.
+   */
+  const GLProgram& get(uint32_t mask);
+  /** @brief Convenience overload taking feature names. */
+  const GLProgram& get(const std::vector<std::string>& features);
+
+  /** @brief Feature keys in declaration order. */
+  const std::vector<std::string>& getFeatures() const {return features;}
+  /** @brief Number of variants compiled so far. */
+  size_t getVariantCount() const {return variants.size();}
+
+  /** @brief Version header (plus default precisions on ES) prepended to every stage. */
+  static std::string versionHeader();
+
+private:
+  std::string vertexSource;   ///< Vertex stage with version/feature lines blanked out.
+  std::string fragmentSource; ///< Fragment stage with version/feature lines blanked out.
+  std::string geometrySource; ///< Geometry stage (may be empty).
+  std::vector<std::string> features; ///< Declared feature keys.
+  std::map<uint32_t, std::unique_ptr<GLProgram>> variants; ///< Compiled programs by feature mask.
+
+  /** @brief Private ctor used by the factory helpers. */
+  GLProgramVariants(const std::string& vs, const std::string& fs, const std::string& gs);
+
+  /** @brief Blank out \c #version and collect \c #pragma features lines of one stage. */
+  std::string parseStage(const std::string& source);
+  /** @brief Source strings for one stage of the variant @p mask. */
+  std::vector<std::string> stageStrings(const std::string& source, uint32_t mask) const;
+};
@@ -0,0 +1,180 @@
+#include <sstream>
+
+#include "GLStaticGeometry.h"
+
+GLStaticGeometry::GLStaticGeometry(const std::vector<Attribute>& layout) :
+  layout(layout),
+  stride(0),
+  vertexCount(0),
+  indexCount(0),
+  uploaded(false),
+  array{},
+  vertexBuffer{GL_ARRAY_BUFFER},
+  indexBuffer{GL_ELEMENT_ARRAY_BUFFER}
+{
+  if (layout.empty())
+    throw GLException{"GLStaticGeometry needs at least one vertex attribute"};
+  for (const Attribute& a : layout) {
+    if (a.elemCount < 1 || a.elemCount > 4) {
+      std::stringstream s;
+      s << "GLStaticGeometry: attribute " << a.name << " has " << a.elemCount
+        << " components, expected 1 to 4";
+      throw GLException{s.str()};
+    }
+    stride += a.elemCount;
+  }
+}
+
+size_t GLStaticGeometry::addMesh(const std::vector<std::vector<float>>& attributes,
+                                 const std::vector<GLuint>& indices) {
+  if (attributes.size() != layout.size())
+    throw GLException{"GLStaticGeometry::addMesh: attribute count does not match the layout"};
+
+  const size_t meshVertexCount = attributes[0].size() / layout[0].elemCount;
+  std::vector<const float*> pointers;
+  for (size_t a = 0;a<layout.size();++a) {
+    if (attributes[a].size() != meshVertexCount*layout[a].elemCount) {
+      std::stringstream s;
+      s << "GLStaticGeometry::addMesh: attribute " << layout[a].name
+        << " has " << attributes[a].size() << " values, expected "
+        << meshVertexCount*layout[a].elemCount;
+      throw GLException{s.str()};
+    }
+    pointers.push_back(attributes[a].data());
+  }
+  return addMesh(pointers, meshVertexCount, indices.data(), indices.size());
+}
+
+size_t GLStaticGeometry::addMesh(const std::vector<const float*>& attributes, size_t meshVertexCount,
+                                 const GLuint* indices, size_t meshIndexCount) {
+  if (uploaded)
+    throw GLException{"GLStaticGeometry::addMesh called after upload"};
+  if (attributes.size() != layout.size())
+    throw GLException{"GLStaticGeometry::addMesh: attribute count does not match the layout"};
+
+  // interleave the separate attribute streams into the shared vertex array
+  const size_t start = vertexData.size();
+  vertexData.resize(start + meshVertexCount*stride);
+  size_t offset = 0;
+  for (size_t a = 0;a<layout.size();++a) {
+    const size_t elemCount = layout[a].elemCount;
+    for (size_t v = 0;v<meshVertexCount;++v) {
+      for (size_t c = 0;c<elemCount;++c) {
+        vertexData[start + v*stride + offset + c] = attributes[a][v*elemCount+c];
+      }
+    }
+    offset += elemCount;
+  }
+
+  MeshRange range;
+  range.firstIndex  = indexData.size();
+  range.baseVertex  = GLint(vertexCount);
+  range.vertexCount = GLsizei(meshVertexCount);
+
+  if (indices && meshIndexCount > 0) {
+    for (size_t i = 0;i<meshIndexCount;++i) {
+      if (indices[i] >= meshVertexCount)
+        throw GLException{"GLStaticGeometry::addMesh: index out of range"};
+      indexData.push_back(indices[i]);
+    }
+    range.indexCount = GLsizei(meshIndexCount);
+  } else {
+    for (size_t i = 0;i<meshVertexCount;++i) indexData.push_back(GLuint(i));
+    range.indexCount = GLsizei(meshVertexCount);
+  }
+
+  vertexCount += meshVertexCount;
+  indexCount  += size_t(range.indexCount);
+  ranges.push_back(range);
+  return ranges.size()-1;
+}
+
+void GLStaticGeometry::upload(const GLProgram& program) {
+#ifdef __EMSCRIPTEN__
+  // ES 3.0 has no base-vertex draws, so rebase the indices once on the CPU
+  for (const MeshRange& r : ranges) {
+    for (size_t i = 0;i<size_t(r.indexCount);++i) {
+      indexData[r.firstIndex+i] += GLuint(r.baseVertex);
+    }
+  }
+#endif
+
+  array.bind();
+  vertexBuffer.setData(vertexData, stride, GL_STATIC_DRAW);
+  size_t offset = 0;
+  for (const Attribute& a : layout) {
+    array.connectVertexAttrib(vertexBuffer, program, a.name, a.elemCount, offset);
+    offset += a.elemCount;
+  }
+  indexBuffer.setData(indexData);
+  array.connectIndexBuffer(indexBuffer);
+
+  std::vector<float>().swap(vertexData);
+  std::vector<GLuint>().swap(indexData);
+  // the pack is final now, so the id list for drawAll() can be built once
+  allMeshes.resize(ranges.size());
+  for (size_t i = 0;i<allMeshes.size();++i) allMeshes[i] = i;
+  uploaded = true;
+}
+
+void GLStaticGeometry::bind() const {
+  array.bind();
+}
+
+const GLStaticGeometry::MeshRange& GLStaticGeometry::checkedMesh(size_t mesh) const {
+  if (mesh >= ranges.size()) {
+    std::stringstream s;
+    s << "GLStaticGeometry::draw: mesh id " << mesh << " out of range, the pack has "
+      << ranges.size() << " meshes";
+    throw GLException{s.str()};
+  }
+  return ranges[mesh];
+}
+
+void GLStaticGeometry::draw(size_t mesh) const {
+  if (!uploaded)
+    throw GLException{"GLStaticGeometry::draw called before upload"};
+  const MeshRange& r = checkedMesh(mesh);
+
+  array.bind();
+#ifdef __EMSCRIPTEN__
+  GL(glDrawElements(GL_TRIANGLES, r.indexCount, GL_UNSIGNED_INT,
+                    (const GLvoid*)(r.firstIndex*sizeof(GLuint))));
+#else
+  GL(glDrawElementsBaseVertex(GL_TRIANGLES, r.indexCount, GL_UNSIGNED_INT,
+                              (GLvoid*)(r.firstIndex*sizeof(GLuint)), r.baseVertex));
+#endif
+}
+
+void GLStaticGeometry::drawAll() const {
+  draw(allMeshes);
+}
+
+void GLStaticGeometry::draw(const std::vector<size_t>& meshes) const {
+  if (!uploaded)
+    throw GLException{"GLStaticGeometry::draw called before upload"};
+  if (meshes.empty()) return;
+
+  array.bind();
+
+#ifdef __EMSCRIPTEN__
+  for (size_t m : meshes) {
+    const MeshRange& r = checkedMesh(m);
+    GL(glDrawElements(GL_TRIANGLES, r.indexCount, GL_UNSIGNED_INT,
+                      (const GLvoid*)(r.firstIndex*sizeof(GLuint))));
+  }
+#else
+  drawCounts.resize(meshes.size());
+  drawFirsts.resize(meshes.size());
+  drawBases.resize(meshes.size());
+  for (size_t i = 0;i<meshes.size();++i) {
+    const MeshRange& r = checkedMesh(meshes[i]);
+    drawCounts[i] = r.indexCount;
+    drawFirsts[i] = (GLvoid*)(r.firstIndex*sizeof(GLuint));
+    drawBases[i]  = r.baseVertex;
+  }
+  GL(glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT,
+                                   drawFirsts.data(), GLsizei(meshes.size()),
+                                   drawBases.data()));
+#endif
+}
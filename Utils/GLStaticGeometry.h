@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "GLEnv.h"
+#include "GLArray.h"
+#include "GLBuffer.h"
+#include "GLProgram.h"
+
+/**
+ * @file GLStaticGeometry.h
+ * @brief Packs many static meshes with a common vertex layout into shared buffers.
+ *
+ * Instead of one @ref GLArray plus one @ref GLBuffer per attribute and mesh,
+ * all meshes added to a @ref GLStaticGeometry are interleaved into a single
+ * vertex buffer and a single index buffer that are bound through one VAO.
+ * Each mesh is remembered by its first index and base vertex, so an arbitrary
+ * subset can be submitted with one \c glMultiDrawElementsBaseVertex call.
+ *
+ * @details Typical usage:
+ * @code
+ * GLStaticGeometry geo{{{"vertexPosition",3},{"vertexNormal",3}}};
+ * size_t plane  = geo.addMesh({planePos, planeNormals});
+ * size_t teapot = geo.addMesh({teapotPos, teapotNormals}, teapotIndices);
+ * geo.upload(program);
+ * ...
+ * geo.draw({plane, teapot});
+ * @endcode
+ *
+ * @note WebGL 2 / ES 3.0 lacks base-vertex draws; on Emscripten the base
+ *       vertex is folded into the index buffer at upload time and the visible
+ *       meshes are issued as individual \c glDrawElements calls.
+ */
+class GLStaticGeometry {
+public:
+  /**
+   * @brief One attribute of the shared vertex layout.
+   */
+  struct Attribute {
+    std::string name; ///< Attribute identifier in the shader.
+    size_t elemCount; ///< Float components per vertex (1..4).
+  };
+
+  /**
+   * @brief Location of one mesh inside the shared buffers.
+   */
+  struct MeshRange {
+    GLsizei indexCount; ///< Number of indices (3 per triangle).
+    size_t firstIndex;  ///< Offset of the first index in the index buffer.
+    GLint baseVertex;   ///< Offset added to every index of this mesh.
+    GLsizei vertexCount;///< Number of vertices owned by this mesh.
+  };
+
+  /**
+   * @brief Create an empty packer for the given vertex layout.
+   * @param layout Attributes in interleaving order.
+   * @throw GLException if the layout is empty or an attribute does not have
+   *        1 to 4 components.
+   */
+  GLStaticGeometry(const std::vector<Attribute>& layout);
+
+  /**
+   * @brief Append a mesh given as one float stream per layout attribute.
+   * @param attributes One vector per layout entry, each holding
+   *                   vertexCount*elemCount floats.
+   * @param indices    Triangle indices local to this mesh; if empty, the
+   *                   vertices are drawn in order (like glDrawArrays).
+   * @return Mesh id used with @ref draw().
+   * @throw GLException if the streams do not match the layout or after upload().
+   */
+  size_t addMesh(const std::vector<std::vector<float>>& attributes,
+                 const std::vector<GLuint>& indices = std::vector<GLuint>());
+
+  /**
+   * @brief Append a mesh from raw arrays, e.g. the static tables in Teapot.h.
+   * @param attributes One pointer per layout entry, each with
+   *                   vertexCount*elemCount floats.
+   * @param vertexCount Number of vertices.
+   * @param indices     Optional index array (may be nullptr).
+   * @param indexCount  Number of entries in @p indices.
+   * @return Mesh id used with @ref draw().
+   */
+  size_t addMesh(const std::vector<const float*>& attributes, size_t vertexCount,
+                 const GLuint* indices = nullptr, size_t indexCount = 0);
+
+  /**
+   * @brief Interleave all meshes, upload both buffers, and wire up the VAO.
+   * @param program Program used to resolve the attribute locations.
+   *
+   * The CPU copies of the mesh data are released afterwards; further calls to
+   * @ref addMesh() throw.
+   */
+  void upload(const GLProgram& program);
+
+  /** @brief Bind the shared VAO (done implicitly by the draw calls). */
+  void bind() const;
+
+  /**
+   * @brief Draw a subset of meshes with one multi-draw call.
+   * @param meshes Mesh ids as returned by @ref addMesh().
+   * @throw GLException before upload() or for an unknown mesh id.
+   */
+  void draw(const std::vector<size_t>& meshes) const;
+  /**
+   * @brief Draw a single mesh.
+   * @throw GLException before upload() or for an unknown mesh id.
+   */
+  void draw(size_t mesh) const;
+  /** @brief Draw every mesh in the pack. */
+  void drawAll() const;
+
+  /** @name Introspection */
+  ///@{
+  size_t getMeshCount() const {return ranges.size();}
+  const MeshRange& getMesh(size_t mesh) const {return ranges[mesh];}
+  size_t getVertexCount() const {return vertexCount;}
+  size_t getIndexCount() const {return indexCount;}
+  /** @brief Floats per interleaved vertex. */
+  size_t getStride() const {return stride;}
+  ///@}
+
+private:
+  std::vector<Attribute> layout;   ///< Attribute order inside one vertex.
+  size_t stride;                   ///< Sum of all layout elemCounts.
+  std::vector<MeshRange> ranges;   ///< Per-mesh base vertex / first index records.
+  std::vector<float> vertexData;   ///< Interleaved vertices until upload().
+  std::vector<GLuint> indexData;   ///< Mesh-local indices until upload().
+  size_t vertexCount;              ///< Total vertices across all meshes.
+  size_t indexCount;               ///< Total indices across all meshes.
+  bool uploaded;                   ///< True once the GL buffers hold the data.
+  std::vector<size_t> allMeshes;   ///< Ids 0..n-1 for drawAll(), built by upload().
+
+  GLArray array;                   ///< Shared VAO.
+  GLBuffer vertexBuffer;           ///< Interleaved vertex buffer.
+  GLBuffer indexBuffer;            ///< Concatenated index buffer.
+
+  mutable std::vector<GLsizei> drawCounts;      ///< Scratch for multi-draw counts.
+  mutable std::vector<GLvoid*> drawFirsts;      ///< Scratch for multi-draw byte offsets.
+  mutable std::vector<GLint> drawBases;         ///< Scratch for multi-draw base vertices.
+
+  /** @brief Range of @p mesh; throws GLException for unknown ids. */
+  const MeshRange& checkedMesh(size_t mesh) const;
+};
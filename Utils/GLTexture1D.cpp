@@ -52,6 +52,10 @@ const GLuint GLTexture1D::getId() const {
 	return id;
 }
 
+void GLTexture1D::setLabel(const std::string& label) const {
+	GLDebugOutput::label(GL_TEXTURE, id, label);
+}
+
 void GLTexture1D::setData(const std::vector<GLubyte>& data, uint32_t size, 
                           uint8_t componentCount) {
 	if (data.size() != componentCount*size) {
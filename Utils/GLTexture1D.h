@@ -1,6 +1,7 @@
 #ifndef __EMSCRIPTEN__
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "GLEnv.h"
@@ -39,6 +40,12 @@ public:
    */
   const GLuint getId() const;
 
+  /**
+   * @brief Name the texture in driver debug messages and GPU debuggers.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label) const;
+
   /**
    * @brief Upload interleaved unsigned‑byte data to the texture.
    * @param data           Pixel bytes, size must be componentCount * size.
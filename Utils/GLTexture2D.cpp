@@ -2,6 +2,7 @@
 #include <sstream>
 
 #include "GLTexture2D.h"
+#include "Trace.h"
 
 GLTexture2D::GLTexture2D(GLint magFilter, GLint minFilter, GLint wrapX, GLint wrapY) :
   id(0),
@@ -96,6 +97,10 @@ const GLuint GLTexture2D::getId() const {
   return id;
 }
 
+void GLTexture2D::setLabel(const std::string& label) const {
+  GLDebugOutput::label(GL_TEXTURE, id, label);
+}
+
 void GLTexture2D::clear() {
   setEmpty(width,height,componentCount,dataType);
 }
@@ -232,6 +237,7 @@ static GLTexInfo dataTypeToGL(GLDataType dataType, uint8_t componentCount) {
 }
 
 void GLTexture2D::setData(GLvoid* data, uint32_t width, uint32_t height, uint8_t componentCount, GLDataType dataType) {
+  TRACE_SCOPE("GLTexture2D::setData");
   this->dataType = dataType;
   this->width = width;
   this->height = height;
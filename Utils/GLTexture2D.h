@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "GLEnv.h"
@@ -56,6 +57,12 @@ public:
    */
   const GLuint getId() const;
 
+  /**
+   * @brief Name the texture in driver debug messages and GPU debuggers.
+   * @param label Label text (see GLDebugOutput::label()).
+   */
+  void setLabel(const std::string& label) const;
+
   /** @brief Clear the texture to an empty image preserving dimensions/type. */
   void clear();
 
@@ -62,6 +62,10 @@ const GLuint GLTexture3D::getId() const {
   return id;
 }
 
+void GLTexture3D::setLabel(const std::string& label) const {
+  GLDebugOutput::label(GL_TEXTURE, id, label);
+}
+
 void GLTexture3D::clear() {
   setEmpty(width,height,depth,componentCount,isFloat);
 }
@@ -115,6 +115,10 @@ const GLuint GLTextureCube::getId() const {
   return id;
 }
 
+void GLTextureCube::setLabel(const std::string& label) const {
+  GLDebugOutput::label(GL_TEXTURE, id, label);
+}
+
 void GLTextureCube::clear() {
   setEmpty(width,height,componentCount,dataType);
 }
@@ -7,6 +7,7 @@
 #include "bmp.h"
 
 #include "Grid2D.h"
+#include "Trace.h"
 
 Grid2D::Grid2D(size_t width, size_t height) :
   width(width),
@@ -477,6 +478,7 @@ static float dist(size_t x, size_t y, const Vec2ui& p) {
 }
 
 Grid2D Grid2D::toSignedDistance(float threshold) const {
+  TRACE_SCOPE("Grid2D::toSignedDistance");
   Grid2D r(width, height);
   
   std::vector<bool> I(width*height);
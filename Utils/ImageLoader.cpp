@@ -3,9 +3,11 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "ImageLoader.h"
+#include "Trace.h"
 
 namespace ImageLoader {
   Image load(const std::string& filename, bool flipY) {
+    TRACE_SCOPE_ARG("ImageLoader::load", filename);
     stbi_set_flip_vertically_on_load(flipY);
     int width, height, nrComponents;
     stbi_uc* image_data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
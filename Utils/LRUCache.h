@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @file LRUCache.h
+ * @brief String-keyed cache with least-recently-used eviction under a byte budget.
+ *
+ * Lookups take a @c std::string_view, so probing with a reused key buffer
+ * allocates nothing; memory is only allocated when a new entry is inserted.
+ * Used by @ref FontEngine and @ref FontRenderer to keep the layout of
+ * strings that are drawn every frame.
+ */
+
+/**
+ * @brief Bounded cache mapping strings to values of type @p Value.
+ *
+ * Each entry carries a caller-estimated size in bytes; inserting evicts the
+ * least recently used entries until the total fits into the budget; the
+ * newest entry is always kept. Found or inserted values stay valid until
+ * they are evicted, i.e. at least until the next @ref insert().
+ */
+template <typename Value>
+class LRUCache {
+public:
+  /** @brief Create an empty cache holding at most @p budget bytes. */
+  explicit LRUCache(size_t budget) : budget(budget) {}
+
+  /** @brief Copy entries and budget; the index is rebuilt for the copies. */
+  LRUCache(const LRUCache& other) :
+    entries(other.entries),
+    budget(other.budget),
+    totalBytes(other.totalBytes)
+  {
+    rebuildIndex();
+  }
+  LRUCache& operator=(const LRUCache& other) {
+    if (this != &other) {
+      entries = other.entries;
+      budget = other.budget;
+      totalBytes = other.totalBytes;
+      rebuildIndex();
+    }
+    return *this;
+  }
+  LRUCache(LRUCache&&) = default;
+  LRUCache& operator=(LRUCache&&) = default;
+
+  /**
+   * @brief Look up @p key and mark it as most recently used.
+   * @return The cached value, or nullptr on a miss.
+   */
+  Value* find(std::string_view key) {
+    const auto it = index.find(key);
+    if (it == index.end()) {
+      misses++;
+      return nullptr;
+    }
+    hits++;
+    entries.splice(entries.begin(), entries, it->second);
+    return &it->second->value;
+  }
+
+  /**
+   * @brief Insert or replace the value of @p key.
+   * @param bytes Approximate memory held by @p value (the key is added).
+   * @return The stored value.
+   */
+  Value& insert(std::string_view key, Value value, size_t bytes) {
+    const auto it = index.find(key);
+    if (it != index.end()) erase(it->second);
+
+    entries.push_front({std::string{key}, std::move(value), bytes + key.size() + entryOverhead});
+    index.emplace(entries.front().key, entries.begin());
+    totalBytes += entries.front().bytes;
+    while (totalBytes > budget && entries.size() > 1) erase(std::prev(entries.end()));
+    return entries.front().value;
+  }
+
+  /** @brief Remove all entries. */
+  void clear() {
+    index.clear();
+    entries.clear();
+    totalBytes = 0;
+  }
+
+  /** @brief Change the budget, evicting entries if it shrinks. */
+  void setBudget(size_t budget) {
+    this->budget = budget;
+    while (totalBytes > budget && !entries.empty()) erase(std::prev(entries.end()));
+  }
+
+  /** @name Introspection */
+  ///@{
+  size_t getBudget() const {return budget;}
+  size_t getBytes() const {return totalBytes;}
+  size_t size() const {return entries.size();}
+  size_t getHits() const {return hits;}
+  size_t getMisses() const {return misses;}
+  ///@}
+
+private:
+  struct Entry {
+    std::string key;
+    Value value;
+    size_t bytes;
+  };
+  typedef typename std::list<Entry>::iterator Iterator;
+
+  /// Rough per-entry cost of the list node and the index slot.
+  static const size_t entryOverhead = 64;
+
+  std::list<Entry> entries; ///< Most recently used first.
+  std::unordered_map<std::string_view, Iterator> index; ///< Views into Entry::key.
+  size_t budget;
+  size_t totalBytes{0};
+  size_t hits{0};
+  size_t misses{0};
+
+  void rebuildIndex() {
+    index.clear();
+    for (Iterator it = entries.begin();it != entries.end();++it) index.emplace(it->key, it);
+  }
+
+  void erase(Iterator it) {
+    totalBytes -= it->bytes;
+    index.erase(it->key);
+    entries.erase(it);
+  }
+};
@@ -527,6 +527,10 @@ public:
    * @param znear,zfar Near/Far plane distances.
    * @param focalLength Distance from eye to focus plane used for frustum shift.
    * @param eyeDist Inter-pupillary distance (eye separation).
+   *
+   * The eyes sit at ∓eyeDist/2 along the camera's x axis, and their
+   * asymmetric frusta are shifted so that objects at @p focalLength appear
+   * at the same position in both images (zero parallax).
    */
   static StereoMatrices stereoLookAtAndProjection(const Vec3t<T>& eye, const Vec3t<T>& at, const Vec3t<T>& up,
                                                   T fovy, T aspect, T znear, T zfar, T focalLength,
@@ -535,21 +539,21 @@ public:
     StereoMatrices result;
     T wd2     = znear * tanf(Mat4t::deg2Rad(fovy)/2);
     T nfdl    = znear / focalLength;
-    T shift   =   eyeDist * nfdl;
+    T shift   =   eyeDist / 2 * nfdl;
     T top     =   wd2;
     T bottom  = - wd2;
 
-    // projection matrices
-    T left    = - aspect * wd2 - shift;
-    T right   =   aspect * wd2 - shift;
+    // projection matrices, each frustum shifted towards the center
+    T left    = - aspect * wd2 + shift;
+    T right   =   aspect * wd2 + shift;
     result.leftProj = Mat4t::perspective(left, right, bottom, top, znear, zfar);
-    left    = - aspect * wd2 + shift;
-    right   =   aspect * wd2 + shift;
+    left    = - aspect * wd2 - shift;
+    right   =   aspect * wd2 - shift;
     result.rightProj = Mat4t::perspective(left, right, bottom, top, znear, zfar);
 
-    // view matrices
-    result.leftView  = Mat4t::translation(-eyeDist/2, 0, 0) * Mat4t::lookAt(eye, at, up);
-    result.rightView = Mat4t::translation(eyeDist/2, 0, 0) * Mat4t::lookAt(eye, at, up);
+    // view matrices, moving the world opposite to the eye
+    result.leftView  = Mat4t::translation(eyeDist/2, 0, 0) * Mat4t::lookAt(eye, at, up);
+    result.rightView = Mat4t::translation(-eyeDist/2, 0, 0) * Mat4t::lookAt(eye, at, up);
 
     return result;
   }
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cmath>
+
+#include "OcclusionCuller.h"
+#include "Trace.h"
+
+/** Clip-space triangles set up and binned per parallel work item. */
+static const size_t chunkSize = 1024;
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height) :
+  width((std::max(width, 1u) + tileSize - 1) / tileSize * tileSize),
+  height((std::max(height, 1u) + tileSize - 1) / tileSize * tileSize),
+  tilesX(this->width / tileSize),
+  tilesY(this->height / tileSize),
+  tiles(tilesX * tilesY)
+{
+  clear(Mat4{});
+}
+
+void OcclusionCuller::clear(const Mat4& viewProjection) {
+  this->viewProjection = viewProjection;
+  std::fill(tiles.begin(), tiles.end(), Tile{0, 1.0f, 0.0f});
+  clipTriangles.clear();
+  triangleCount = 0;
+}
+
+void OcclusionCuller::addOccluder(const std::vector<Vec3>& vertices,
+                                  const std::vector<OBJFile::IndexType>& indices, const Mat4& model) {
+  const Mat4 modelViewProjection = viewProjection * model;
+  clipVertices.resize(vertices.size());
+  #pragma omp parallel for if (vertices.size() > 4096)
+  for (int64_t i = 0;i<int64_t(vertices.size());++i)
+    clipVertices[size_t(i)] = modelViewProjection * Vec4{vertices[size_t(i)], 1.0f};
+
+  clipTriangles.reserve(clipTriangles.size() + indices.size());
+  for (const OBJFile::IndexType& index : indices)
+    clipTriangles.push_back({clipVertices[index[0]], clipVertices[index[1]], clipVertices[index[2]]});
+}
+
+void OcclusionCuller::addOccluder(const OBJFile& mesh, const Mat4& model) {
+  addOccluder(mesh.vertices, mesh.indices, model);
+}
+
+void OcclusionCuller::setupTriangle(const std::array<Vec4, 3>& clip, std::vector<Triangle>& result) const {
+  // trivially outside one of the side planes
+  for (uint32_t axis = 0;axis<2;++axis) {
+    if (clip[0].e[axis] >  clip[0].w && clip[1].e[axis] >  clip[1].w && clip[2].e[axis] >  clip[2].w) return;
+    if (clip[0].e[axis] < -clip[0].w && clip[1].e[axis] < -clip[1].w && clip[2].e[axis] < -clip[2].w) return;
+  }
+
+  // clip against the near plane z >= -w
+  Vec4 polygon[4];
+  uint32_t count = 0;
+  for (uint32_t i = 0;i<3;++i) {
+    const Vec4& a = clip[i];
+    const Vec4& b = clip[(i+1)%3];
+    const float da = a.z + a.w;
+    const float db = b.z + b.w;
+    if (da >= 0.0f) polygon[count++] = a;
+    if ((da >= 0.0f) != (db >= 0.0f)) {
+      const float t = da / (da - db);
+      polygon[count++] = a + (b - a) * t;
+    }
+  }
+  if (count < 3) return;
+
+  float x[4], y[4], z[4];
+  for (uint32_t i = 0;i<count;++i) {
+    const float w = std::max(polygon[i].w, 1e-6f);
+    x[i] = (polygon[i].x / w * 0.5f + 0.5f) * float(width);
+    y[i] = (polygon[i].y / w * 0.5f + 0.5f) * float(height);
+    z[i] = polygon[i].z / w * 0.5f + 0.5f;
+  }
+  for (uint32_t i = 1;i+1<count;++i) {
+    const Triangle t{{x[0], x[i], x[i+1]}, {y[0], y[i], y[i+1]}, {z[0], z[i], z[i+1]}};
+    // back faces and degenerate triangles
+    if ((t.x[1]-t.x[0])*(t.y[2]-t.y[0]) - (t.x[2]-t.x[0])*(t.y[1]-t.y[0]) <= 0.0f) continue;
+    result.push_back(t);
+  }
+}
+
+void OcclusionCuller::rasterize() {
+  TRACE_SCOPE("OcclusionCuller::rasterize");
+  const size_t chunkCount = (clipTriangles.size() + chunkSize - 1) / chunkSize;
+  chunkTriangles.resize(chunkCount);
+  bins.resize(chunkCount * tilesY);
+
+  // set up the triangles and sort them into rows of tiles
+  #pragma omp parallel for schedule(dynamic)
+  for (int64_t chunk = 0;chunk<int64_t(chunkCount);++chunk) {
+    std::vector<Triangle>& chunkResult = chunkTriangles[size_t(chunk)];
+    chunkResult.clear();
+    const size_t end = std::min(clipTriangles.size(), size_t(chunk+1) * chunkSize);
+    for (size_t i = size_t(chunk) * chunkSize;i<end;++i) setupTriangle(clipTriangles[i], chunkResult);
+
+    std::vector<uint32_t>* chunkBins = &bins[size_t(chunk) * tilesY];
+    for (uint32_t row = 0;row<tilesY;++row) chunkBins[row].clear();
+    for (uint32_t i = 0;i<chunkResult.size();++i) {
+      const Triangle& t = chunkResult[i];
+      const float minY = std::min({t.y[0], t.y[1], t.y[2]});
+      const float maxY = std::max({t.y[0], t.y[1], t.y[2]});
+      if (maxY < 0.0f || minY >= float(height)) continue;
+      const uint32_t first = uint32_t(std::max(minY, 0.0f)) / tileSize;
+      const uint32_t last = std::min(uint32_t(std::min(maxY, float(height-1))) / tileSize, tilesY-1);
+      for (uint32_t row = first;row<=last;++row) chunkBins[row].push_back(i);
+    }
+  }
+
+  // every row of tiles is owned by one thread and keeps the submission order
+  #pragma omp parallel for schedule(dynamic)
+  for (int64_t row = 0;row<int64_t(tilesY);++row) {
+    for (size_t chunk = 0;chunk<chunkCount;++chunk) {
+      for (uint32_t i : bins[chunk * tilesY + size_t(row)])
+        rasterizeRow(chunkTriangles[chunk][i], uint32_t(row));
+    }
+  }
+
+  triangleCount = 0;
+  for (const std::vector<Triangle>& chunk : chunkTriangles) triangleCount += chunk.size();
+}
+
+void OcclusionCuller::rasterizeRow(const Triangle& t, uint32_t tileY) {
+  // edge functions a*x + b*y + c >= 0 inside the counter-clockwise triangle
+  float a[3], b[3], c[3];
+  for (uint32_t e = 0;e<3;++e) {
+    const uint32_t n = (e+1)%3;
+    a[e] = t.y[e] - t.y[n];
+    b[e] = t.x[n] - t.x[e];
+    c[e] = t.x[e]*t.y[n] - t.x[n]*t.y[e];
+  }
+  const float minX = std::max(std::min({t.x[0], t.x[1], t.x[2]}), 0.0f);
+  const float maxX = std::min(std::max({t.x[0], t.x[1], t.x[2]}), float(width));
+  const float minY = std::min({t.y[0], t.y[1], t.y[2]});
+  const float maxY = std::max({t.y[0], t.y[1], t.y[2]});
+  if (minX >= maxX) return;
+
+  // covered pixel span of every row of the tile row, all rows at once
+  const float rowY = float(tileY * tileSize);
+  int32_t first[tileSize];
+  int32_t last[tileSize];
+  #pragma omp simd
+  for (uint32_t r = 0;r<tileSize;++r) {
+    const float y = rowY + float(r) + 0.5f;
+    float left = minX;
+    float right = maxX;
+    bool empty = y < minY || y > maxY;
+    for (uint32_t e = 0;e<3;++e) {
+      const float v = b[e]*y + c[e];
+      if (a[e] > 0.0f) left = std::max(left, -v / a[e]);
+      else if (a[e] < 0.0f) right = std::min(right, -v / a[e]);
+      else empty = empty || v < 0.0f;
+    }
+    // pixels whose centers lie inside
+    first[r] = empty ? int32_t(width) : int32_t(std::ceil(left - 0.5f));
+    last[r] = empty ? -1 : int32_t(std::floor(std::min(right, float(width)) - 0.5f));
+  }
+
+  // depth plane, evaluated conservatively at the corners of each tile
+  const float area = (t.x[1]-t.x[0])*(t.y[2]-t.y[0]) - (t.x[2]-t.x[0])*(t.y[1]-t.y[0]);
+  const float dzdx = ((t.z[1]-t.z[0])*(t.y[2]-t.y[0]) - (t.z[2]-t.z[0])*(t.y[1]-t.y[0])) / area;
+  const float dzdy = ((t.x[1]-t.x[0])*(t.z[2]-t.z[0]) - (t.x[2]-t.x[0])*(t.z[1]-t.z[0])) / area;
+  const float maxZ = std::max({t.z[0], t.z[1], t.z[2]});
+  const float y0 = std::max(rowY, minY) - t.y[0];
+  const float y1 = std::min(rowY + float(tileSize), maxY) - t.y[0];
+  const float rowZ = t.z[0] + std::max(dzdy*y0, dzdy*y1);
+
+  const uint32_t firstTile = uint32_t(minX) / tileSize;
+  const uint32_t lastTile = std::min(uint32_t(maxX) / tileSize, tilesX-1);
+  Tile* row = &tiles[tileY * tilesX];
+  for (uint32_t tx = firstTile;tx<=lastTile;++tx) {
+    const int32_t tileX = int32_t(tx * tileSize);
+    uint64_t coverage = 0;
+    for (uint32_t r = 0;r<tileSize;++r) {
+      const int32_t lo = std::max(first[r], tileX);
+      const int32_t hi = std::min(last[r], tileX + int32_t(tileSize) - 1);
+      if (lo > hi) continue;
+      const uint64_t bits = (0xFFull >> (7 - (hi - lo))) << (lo - tileX);
+      coverage |= bits << (r * tileSize);
+    }
+    if (coverage == 0) continue;
+
+    const float x0 = std::max(float(tileX), minX) - t.x[0];
+    const float x1 = std::min(float(tileX + int32_t(tileSize)), maxX) - t.x[0];
+    const float zTriangle = std::min(rowZ + std::max(dzdx*x0, dzdx*x1), maxZ);
+    updateTile(row[tx], coverage, zTriangle);
+  }
+}
+
+void OcclusionCuller::updateTile(Tile& tile, uint64_t coverage, float zTriangle) {
+  if (zTriangle >= tile.zMax0) return;
+
+  // a triangle closer to the reference than to the working layer would
+  // push the working depth far back; start a new working layer instead
+  if (zTriangle - tile.zMax1 > tile.zMax0 - zTriangle) {
+    tile.mask = 0;
+    tile.zMax1 = 0.0f;
+  }
+  tile.mask |= coverage;
+  tile.zMax1 = std::max(tile.zMax1, zTriangle);
+
+  // a full working layer bounds the whole tile
+  if (tile.mask == ~0ull) {
+    tile.zMax0 = tile.zMax1;
+    tile.zMax1 = 0.0f;
+    tile.mask = 0;
+  }
+}
+
+bool OcclusionCuller::isVisible(const Vec3& boundsMin, const Vec3& boundsMax) const {
+  float minX = float(width), maxX = 0.0f;
+  float minY = float(height), maxY = 0.0f;
+  float minZ = 1.0f;
+  for (uint32_t i = 0;i<8;++i) {
+    const Vec4 corner{(i & 1) ? boundsMax.x : boundsMin.x,
+                      (i & 2) ? boundsMax.y : boundsMin.y,
+                      (i & 4) ? boundsMax.z : boundsMin.z, 1.0f};
+    const Vec4 clip = viewProjection * corner;
+    if (clip.w <= 1e-6f || clip.z < -clip.w) return true;
+    const float x = (clip.x / clip.w * 0.5f + 0.5f) * float(width);
+    const float y = (clip.y / clip.w * 0.5f + 0.5f) * float(height);
+    minX = std::min(minX, x);
+    maxX = std::max(maxX, x);
+    minY = std::min(minY, y);
+    maxY = std::max(maxY, y);
+    minZ = std::min(minZ, clip.z / clip.w * 0.5f + 0.5f);
+  }
+  if (maxX < 0.0f || maxY < 0.0f || minX >= float(width) || minY >= float(height)) return false;
+
+  // pixels the box's screen rectangle touches, clamped before the conversion
+  // since far off-screen corners exceed the range of uint32_t
+  const uint32_t px0 = uint32_t(std::max(minX, 0.0f));
+  const uint32_t py0 = uint32_t(std::max(minY, 0.0f));
+  const uint32_t px1 = uint32_t(std::min(maxX, float(width-1)));
+  const uint32_t py1 = uint32_t(std::min(maxY, float(height-1)));
+
+  for (uint32_t ty = py0 / tileSize;ty<=py1 / tileSize;++ty) {
+    for (uint32_t tx = px0 / tileSize;tx<=px1 / tileSize;++tx) {
+      const Tile& tile = tiles[ty * tilesX + tx];
+      if (minZ >= tile.zMax0) continue;
+
+      // the box is in front of the reference layer; it is hidden only where
+      // the working layer covers it and is still in front of the box
+      const uint32_t x0 = std::max(px0, tx * tileSize) - tx * tileSize;
+      const uint32_t x1 = std::min(px1, tx * tileSize + tileSize - 1) - tx * tileSize;
+      const uint32_t y0 = std::max(py0, ty * tileSize) - ty * tileSize;
+      const uint32_t y1 = std::min(py1, ty * tileSize + tileSize - 1) - ty * tileSize;
+      const uint64_t rowBits = (0xFFull >> (7 - (x1 - x0))) << x0;
+      uint64_t rect = 0;
+      for (uint32_t r = y0;r<=y1;++r) rect |= rowBits << (r * tileSize);
+
+      if ((rect & ~tile.mask) != 0 || minZ < tile.zMax1) return true;
+    }
+  }
+  return false;
+}
+
+Image OcclusionCuller::getDebugImage() const {
+  std::vector<float> depth(size_t(width) * height);
+  float nearest = 1.0f;
+  for (uint32_t y = 0;y<height;++y) {
+    for (uint32_t x = 0;x<width;++x) {
+      const Tile& tile = tiles[(y / tileSize) * tilesX + x / tileSize];
+      const uint32_t bit = (y % tileSize) * tileSize + x % tileSize;
+      const float z = (tile.mask >> bit) & 1 ? tile.zMax1 : tile.zMax0;
+      depth[size_t(y) * width + x] = z;
+      nearest = std::min(nearest, z);
+    }
+  }
+
+  // stretch the occupied depth range, image rows run top to bottom
+  Image image{width, height, 3};
+  const float scale = nearest < 1.0f ? 255.0f / (1.0f - nearest) : 0.0f;
+  for (uint32_t y = 0;y<height;++y) {
+    for (uint32_t x = 0;x<width;++x) {
+      const uint8_t v = uint8_t((1.0f - depth[size_t(y) * width + x]) * scale);
+      for (uint8_t c = 0;c<3;++c) image.setValue(x, height - 1 - y, c, v);
+    }
+  }
+  return image;
+}
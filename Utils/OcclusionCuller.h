@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Image.h"
+#include "Mat4.h"
+#include "OBJFile.h"
+#include "Vec3.h"
+#include "Vec4.h"
+
+/**
+ * @file OcclusionCuller.h
+ * @brief CPU occlusion culling against a small masked depth buffer.
+ *
+ * Large occluders (walls, terrain, simplified building meshes) are
+ * rasterized on the CPU into a low-resolution depth buffer; the bounding
+ * boxes of the other objects are then tested against it, and objects that
+ * are completely hidden are not submitted to GL at all. With a software GL
+ * such as llvmpipe, every skipped object saves its whole vertex and
+ * fragment cost.
+ *
+ * The buffer follows the masked occlusion culling layout: it is split into
+ * 8×8 pixel tiles, and each tile stores a 64-bit coverage mask and two
+ * depths instead of 64 depth values. The reference depth @c zMax0 bounds the
+ * whole tile, the working depth @c zMax1 bounds the pixels set in the mask.
+ * A triangle only touches tiles its bounding box overlaps; its per-row
+ * coverage spans are computed for all rows of a tile at once in vectorized
+ * loops and merged into the mask with 64-bit operations. Once the mask is
+ * full, the working layer becomes the new reference. Box tests first compare
+ * against @c zMax0 and only look at the masks for tiles that are not
+ * conclusive.
+ *
+ * Triangle setup (near clipping, projection, back-face culling) and binning
+ * into rows of tiles run in parallel over chunks of triangles,
+ * rasterization in parallel over rows of tiles (OpenMP where available), so
+ * no two threads write the same tile.
+ *
+ * Per frame:
+ * @code
+ * culler.clear(projection * view);
+ * culler.addOccluder(wall.vertices, wall.indices, wallModel);
+ * culler.rasterize();
+ * for (auto& o : objects)
+ *   if (culler.isVisible(o.boundsMin, o.boundsMax)) o.draw();
+ * @endcode
+ */
+class OcclusionCuller {
+public:
+  /** @brief Width and height of a tile in pixels. */
+  static const uint32_t tileSize = 8;
+
+  /**
+   * @brief Allocate the depth buffer.
+   * @param width  Width in pixels, rounded up to whole tiles.
+   * @param height Height in pixels, rounded up to whole tiles; usually the
+   *               width divided by the aspect ratio of the view.
+   */
+  OcclusionCuller(uint32_t width=256, uint32_t height=128);
+
+  uint32_t getWidth() const {return width;}
+  uint32_t getHeight() const {return height;}
+
+  /** @brief Reset the buffer to the far plane and set the view-projection of this frame. */
+  void clear(const Mat4& viewProjection);
+
+  /**
+   * @brief Queue an occluder mesh for @ref rasterize().
+   *
+   * Back faces (clockwise in screen space) are skipped, so occluders should
+   * be closed meshes or have consistently wound front faces. Triangles are
+   * clipped at the near plane.
+   * @param vertices Object-space positions.
+   * @param indices  Triangles as index triples into @p vertices.
+   * @param model    Object-to-world matrix.
+   */
+  void addOccluder(const std::vector<Vec3>& vertices,
+                   const std::vector<OBJFile::IndexType>& indices, const Mat4& model);
+  /** @brief Queue a loaded (ideally simplified) OBJ mesh as occluder. */
+  void addOccluder(const OBJFile& mesh, const Mat4& model);
+
+  /** @brief Rasterize all occluders queued since @ref clear(). */
+  void rasterize();
+
+  /**
+   * @brief Test a world-space bounding box against the rasterized occluders.
+   *
+   * Conservative: returns false only if the box is outside the view or
+   * behind occluders everywhere it covers. Boxes that reach the near plane
+   * are always visible. Thread-safe once @ref rasterize() has returned.
+   */
+  bool isVisible(const Vec3& boundsMin, const Vec3& boundsMax) const;
+
+  /**
+   * @brief Visualize the buffer: each pixel shows its conservative depth,
+   *        from white (nearest occluder) to black (far plane).
+   */
+  Image getDebugImage() const;
+
+  /** @name Statistics */
+  ///@{
+  /** @brief Occluder triangles rasterized in the last @ref rasterize(). */
+  size_t getOccluderTriangles() const {return triangleCount;}
+  ///@}
+
+private:
+  struct Tile {
+    uint64_t mask;  ///< Pixels covered by the working layer (bit 8*row + column).
+    float zMax0;    ///< Reference layer: farthest depth of the whole tile.
+    float zMax1;    ///< Working layer: farthest depth of the masked pixels.
+  };
+
+  /** A screen-space triangle, counter-clockwise, in pixels with y up. */
+  struct Triangle {
+    float x[3];
+    float y[3];
+    float z[3];
+  };
+
+  uint32_t width;
+  uint32_t height;
+  uint32_t tilesX;
+  uint32_t tilesY;
+  Mat4 viewProjection;
+
+  std::vector<Tile> tiles;
+  std::vector<Vec4> clipVertices;
+  std::vector<std::array<Vec4, 3>> clipTriangles;
+  std::vector<std::vector<Triangle>> chunkTriangles;
+  std::vector<std::vector<uint32_t>> bins;  ///< Triangles per chunk and row of tiles.
+  size_t triangleCount{0};
+
+  /** @brief Clip a triangle at the near plane, project it, and append the front-facing parts. */
+  void setupTriangle(const std::array<Vec4, 3>& clip, std::vector<Triangle>& result) const;
+  /** @brief Rasterize @p t into the tiles of tile row @p tileY. */
+  void rasterizeRow(const Triangle& t, uint32_t tileY);
+  /** @brief Merge a triangle's coverage of one tile into it. */
+  static void updateTile(Tile& tile, uint64_t coverage, float zTriangle);
+};
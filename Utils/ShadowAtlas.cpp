@@ -0,0 +1,456 @@
+#include <algorithm>
+#include <cmath>
+
+#include "ShadowAtlas.h"
+#include "Trace.h"
+
+/** Even bits of @p v packed into the low half (inverse Morton interleave). */
+static uint32_t compactBits(uint64_t v) {
+  v &= 0x5555555555555555ull;
+  v = (v | (v >> 1))  & 0x3333333333333333ull;
+  v = (v | (v >> 2))  & 0x0f0f0f0f0f0f0f0full;
+  v = (v | (v >> 4))  & 0x00ff00ff00ff00ffull;
+  v = (v | (v >> 8))  & 0x0000ffff0000ffffull;
+  v = (v | (v >> 16)) & 0x00000000ffffffffull;
+  return uint32_t(v);
+}
+
+/** Bits of @p v spread to the even bits (Morton interleave). */
+static uint64_t spreadBits(uint32_t v) {
+  uint64_t r = v;
+  r = (r | (r << 16)) & 0x0000ffff0000ffffull;
+  r = (r | (r << 8))  & 0x00ff00ff00ff00ffull;
+  r = (r | (r << 4))  & 0x0f0f0f0f0f0f0f0full;
+  r = (r | (r << 2))  & 0x3333333333333333ull;
+  r = (r | (r << 1))  & 0x5555555555555555ull;
+  return r;
+}
+
+ShadowAtlas::ShadowAtlas(uint32_t size, uint32_t minTileSize, uint32_t maxTileSize) :
+  size(size),
+  minTileSize(std::min(minTileSize, size)),
+  maxTileSize(std::clamp(maxTileSize, this->minTileSize, size)),
+  texelBudget(uint64_t(size)*size/4)
+{
+  cells.assign(cellCount(this->size), 0);
+  atlas.setEmpty(size, size);
+  atlas.setLabel("shadow atlas");
+}
+
+uint32_t ShadowAtlas::addLight(float importance) {
+  uint32_t light = 0;
+  while (light < lights.size() && lights[light].active) light++;
+  if (light == lights.size()) lights.emplace_back();
+
+  Light& l = lights[light];
+  l = Light{};
+  l.active = true;
+  l.importance = importance;
+  l.size = tileSizeFor(importance, 0);
+  l.dirty = true;
+  l.dirtySince = updateCount;
+  if (l.size > 0) layoutChanged = true;
+  return light;
+}
+
+void ShadowAtlas::removeLight(uint32_t light) {
+  if (light >= lights.size() || !lights[light].active) return;
+  Light& l = lights[light];
+  releaseNextTile(l);
+  if (l.tileSize > 0) markCells(l.tileSize, l.x, l.y, -1);
+  l = Light{};
+  // the freed space may let other tiles grow back
+  layoutChanged = true;
+}
+
+void ShadowAtlas::setImportance(uint32_t light, float importance) {
+  if (light >= lights.size() || !lights[light].active) return;
+  Light& l = lights[light];
+  l.importance = importance;
+  const uint32_t tile = tileSizeFor(importance, l.size);
+  if (tile != l.size) {
+    l.size = tile;
+    layoutChanged = true;
+  }
+}
+
+void ShadowAtlas::invalidate(uint32_t light) {
+  if (light >= lights.size() || !lights[light].active || lights[light].dirty) return;
+  lights[light].dirty = true;
+  lights[light].dirtySince = updateCount;
+}
+
+void ShadowAtlas::invalidateAll() {
+  for (uint32_t light = 0;light<lights.size();++light) invalidate(light);
+}
+
+uint32_t ShadowAtlas::tileSizeFor(float importance, uint32_t current) const {
+  if (importance <= 0.0f) return 0;
+  const float edge = float(maxTileSize) * std::sqrt(std::min(importance, 1.0f));
+  uint32_t tile = minTileSize;
+  while (tile*2 <= maxTileSize && float(tile*2) <= edge) tile *= 2;
+  // shrink only once the ideal edge dropped well below the current tile
+  if (current > tile && edge >= 0.75f*float(current)) return current;
+  return tile;
+}
+
+uint64_t ShadowAtlas::firstCell(uint32_t x, uint32_t y) const {
+  return spreadBits(x/minTileSize) | (spreadBits(y/minTileSize) << 1);
+}
+
+uint64_t ShadowAtlas::cellCount(uint32_t tile) const {
+  return uint64_t(tile/minTileSize)*(tile/minTileSize);
+}
+
+void ShadowAtlas::markCells(uint32_t tile, uint32_t x, uint32_t y, int delta) {
+  const uint64_t first = firstCell(x, y);
+  for (uint64_t cell = first;cell<first + cellCount(tile);++cell)
+    cells[cell] = uint8_t(cells[cell] + delta);
+}
+
+bool ShadowAtlas::allocate(uint32_t tile, uint32_t& x, uint32_t& y) {
+  const uint64_t tileCells = cellCount(tile);
+  const uint64_t parentCells = std::min<uint64_t>(4*tileCells, cells.size());
+  std::vector<uint32_t> used(cells.size() + 1, 0);
+  for (size_t i = 0;i<cells.size();++i) used[i+1] = used[i] + (cells[i] > 0 ? 1 : 0);
+
+  // best fit: the free block whose parent is fullest, so small tiles gather
+  // and large free blocks stay intact
+  bool found = false;
+  uint64_t best = 0;
+  uint32_t bestFill = 0;
+  for (uint64_t first = 0;first + tileCells <= cells.size();first += tileCells) {
+    if (used[first + tileCells] != used[first]) continue;
+    const uint64_t parent = first - first % parentCells;
+    const uint32_t fill = used[parent + parentCells] - used[parent];
+    if (!found || fill > bestFill) {
+      best = first;
+      bestFill = fill;
+      found = true;
+    }
+  }
+  if (!found) return false;
+
+  x = compactBits(best) * minTileSize;
+  y = compactBits(best >> 1) * minTileSize;
+  markCells(tile, x, y, 1);
+  return true;
+}
+
+bool ShadowAtlas::evict(uint32_t light, uint32_t tile) {
+  Light& l = lights[light];
+  const uint64_t tileCells = cellCount(tile);
+  const auto overlaps = [tileCells](uint64_t first, uint64_t a, uint64_t count) {
+    return a < first + tileCells && first < a + count;
+  };
+
+  // the block whose tiles are cheapest to move; blocks overlapping tiles
+  // that are moving already or are not smaller are skipped
+  bool found = false;
+  uint64_t best = 0;
+  uint64_t bestCost = 0;
+  for (uint64_t first = 0;first + tileCells <= cells.size();first += tileCells) {
+    bool usable = true;
+    uint64_t cost = 0;
+    for (uint32_t other = 0;other<lights.size() && usable;++other) {
+      const Light& o = lights[other];
+      if (o.nextTileSize > 0 && overlaps(first, firstCell(o.nextX, o.nextY), cellCount(o.nextTileSize)))
+        usable = false;
+      else if (other != light && o.tileSize > 0 && overlaps(first, firstCell(o.x, o.y), cellCount(o.tileSize))) {
+        usable = o.tileSize < tile;
+        // tiles already moving free their cells anyway
+        if (o.nextTileSize == 0) cost += uint64_t(o.tileSize)*o.tileSize;
+      }
+    }
+    if (usable && (!found || cost < bestCost)) {
+      best = first;
+      bestCost = cost;
+      found = true;
+    }
+  }
+  if (!found) return false;
+
+  // hold the block so the evicted tiles are allocated elsewhere
+  const uint32_t x = compactBits(best) * minTileSize;
+  const uint32_t y = compactBits(best >> 1) * minTileSize;
+  markCells(tile, x, y, 1);
+  std::vector<uint32_t> evicted;
+  for (uint32_t other = 0;other<lights.size();++other) {
+    Light& o = lights[other];
+    if (other == light || o.tileSize == 0 || o.nextTileSize > 0 ||
+        !overlaps(best, firstCell(o.x, o.y), cellCount(o.tileSize))) continue;
+    if (!allocate(o.tileSize, o.nextX, o.nextY)) {
+      for (uint32_t e : evicted) releaseNextTile(lights[e]);
+      markCells(tile, x, y, -1);
+      return false;
+    }
+    o.nextTileSize = o.tileSize;
+    evicted.push_back(other);
+  }
+  l.nextTileSize = tile;
+  l.nextX = x;
+  l.nextY = y;
+  return true;
+}
+
+bool ShadowAtlas::nextTileClear(const Light& l) const {
+  // the cells must be held only by the new tile and the light's own old one
+  const uint64_t first = firstCell(l.nextX, l.nextY);
+  const uint64_t own = l.tileSize > 0 ? firstCell(l.x, l.y) : 0;
+  const uint64_t ownCells = l.tileSize > 0 ? cellCount(l.tileSize) : 0;
+  for (uint64_t cell = first;cell<first + cellCount(l.nextTileSize);++cell)
+    if (cells[cell] != 1 + (cell >= own && cell < own + ownCells ? 1 : 0)) return false;
+  return true;
+}
+
+void ShadowAtlas::releaseNextTile(Light& l) {
+  if (l.nextTileSize == 0) return;
+  markCells(l.nextTileSize, l.nextX, l.nextY, -1);
+  l.nextTileSize = 0;
+}
+
+std::vector<uint32_t> ShadowAtlas::fitTileSizes() const {
+  std::vector<uint32_t> order;
+  std::vector<uint32_t> tiles(lights.size(), 0);
+  uint64_t area = 0;
+  for (uint32_t light = 0;light<lights.size();++light) {
+    const Light& l = lights[light];
+    if (l.active && l.size > 0) {
+      order.push_back(light);
+      tiles[light] = l.size;
+      area += uint64_t(l.size)*l.size;
+    }
+  }
+
+  // oversubscribed: halve the largest, least important tile until everything
+  // fits, so big lights lose resolution before small ones lose their shadows
+  const uint64_t atlasArea = uint64_t(size)*size;
+  while (area > atlasArea) {
+    uint32_t victim = 0;
+    bool found = false;
+    for (uint32_t light : order) {
+      if (tiles[light] <= minTileSize) continue;
+      if (!found || tiles[light] > tiles[victim] ||
+          (tiles[light] == tiles[victim] && lights[light].importance < lights[victim].importance)) {
+        victim = light;
+        found = true;
+      }
+    }
+    if (!found) break;
+    tiles[victim] /= 2;
+    area -= 3*uint64_t(tiles[victim])*tiles[victim];
+  }
+
+  // only when every tile is at the minimum the least important ones drop out
+  if (area > atlasArea) {
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return lights[a].importance < lights[b].importance;
+    });
+    for (uint32_t light : order) {
+      if (area <= atlasArea) break;
+      area -= uint64_t(tiles[light])*tiles[light];
+      tiles[light] = 0;
+    }
+  }
+  return tiles;
+}
+
+bool ShadowAtlas::allocateTiles(const std::vector<uint32_t>& tiles) {
+  TRACE_SCOPE("ShadowAtlas::allocateTiles");
+  std::vector<uint32_t> order;
+  for (uint32_t light = 0;light<lights.size();++light) {
+    Light& l = lights[light];
+    const uint32_t requested = l.nextTileSize > 0 ? l.nextTileSize : l.tileSize;
+    if (tiles[light] == requested) continue;
+
+    // a new tile that was not rendered yet holds nothing worth keeping
+    releaseNextTile(l);
+    if (tiles[light] == 0) {
+      if (l.tileSize > 0) markCells(l.tileSize, l.x, l.y, -1);
+      l.tileSize = 0;
+    } else if (tiles[light] < l.tileSize) {
+      // shrink into a corner of the old tile
+      l.nextTileSize = tiles[light];
+      l.nextX = l.x;
+      l.nextY = l.y;
+      markCells(l.nextTileSize, l.nextX, l.nextY, 1);
+    } else if (tiles[light] != l.tileSize) {
+      order.push_back(light);
+    }
+  }
+
+  // largest first, among equal sizes the most important lights
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    if (tiles[a] != tiles[b]) return tiles[a] > tiles[b];
+    return lights[a].importance > lights[b].importance;
+  });
+  bool complete = true;
+  for (uint32_t light : order) {
+    Light& l = lights[light];
+    // an eviction may have moved the old tile meanwhile, which is pointless now
+    releaseNextTile(l);
+    if (allocate(tiles[light], l.nextX, l.nextY)) {
+      l.nextTileSize = tiles[light];
+    } else if (!evict(light, tiles[light])) {
+      // the light keeps its current tile, if any, until space frees up
+      complete = false;
+    }
+  }
+
+  for (Light& l : lights) {
+    if (l.nextTileSize > 0 && !l.dirty) {
+      l.dirty = true;
+      l.dirtySince = updateCount;
+    }
+  }
+  return complete;
+}
+
+void ShadowAtlas::compact(const std::vector<uint32_t>& tiles) {
+  TRACE_SCOPE("ShadowAtlas::compact");
+  std::vector<uint32_t> order;
+  for (uint32_t light = 0;light<lights.size();++light) {
+    Light& l = lights[light];
+    l.nextTileSize = 0;
+    if (tiles[light] > 0) {
+      order.push_back(light);
+    } else {
+      l.tileSize = 0;
+      l.moved = false;
+    }
+  }
+
+  // largest first keeps every tile aligned to its own size on the Z-order
+  // curve; among equal sizes the most important lights are placed first
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    if (tiles[a] != tiles[b]) return tiles[a] > tiles[b];
+    return lights[a].importance > lights[b].importance;
+  });
+
+  std::fill(cells.begin(), cells.end(), uint8_t(0));
+  uint64_t cursor = 0;
+  for (uint32_t light : order) {
+    Light& l = lights[light];
+    const uint32_t tile = tiles[light];
+    const uint32_t x = compactBits(cursor) * minTileSize;
+    const uint32_t y = compactBits(cursor >> 1) * minTileSize;
+    markCells(tile, x, y, 1);
+    if (tile != l.tileSize || x != l.x || y != l.y) {
+      l.tileSize = tile;
+      l.x = x;
+      l.y = y;
+      l.moved = true;
+    }
+    cursor += cellCount(tile);
+  }
+}
+
+bool ShadowAtlas::isPending(const Light& l) const {
+  return l.active && (l.moved || (l.nextTileSize > 0 && nextTileClear(l)) ||
+                      (l.dirty && l.tileSize > 0));
+}
+
+uint32_t ShadowAtlas::update(const std::function<void(uint32_t light)>& drawCasters) {
+  updateCount++;
+  if (layoutChanged) {
+    const std::vector<uint32_t> tiles = fitTileSizes();
+    layoutChanged = !allocateTiles(tiles);
+    // retried while moving tiles will still free their old ones
+    if (layoutChanged && std::none_of(lights.begin(), lights.end(), [](const Light& l) {
+          return l.nextTileSize > 0;
+        })) {
+      compact(tiles);
+      layoutChanged = false;
+      repacks++;
+    }
+  }
+
+  std::vector<uint32_t> pending;
+  for (uint32_t light = 0;light<lights.size();++light)
+    if (isPending(lights[light])) pending.push_back(light);
+  if (pending.empty()) return 0;
+
+  // compacted tiles hold no valid depth and go first, then lights without
+  // any shadow yet; refreshes and moves are ordered by importance, weighted
+  // with the time they have been waiting
+  std::sort(pending.begin(), pending.end(), [this](uint32_t a, uint32_t b) {
+    const Light& la = lights[a];
+    const Light& lb = lights[b];
+    if (la.moved != lb.moved) return la.moved;
+    if ((la.tileSize == 0) != (lb.tileSize == 0)) return la.tileSize == 0;
+    return la.importance * float(updateCount - la.dirtySince + 1) >
+           lb.importance * float(updateCount - lb.dirtySince + 1);
+  });
+
+  TRACE_SCOPE("ShadowAtlas::update");
+  framebuffer.bind(atlas);
+  GL(glEnable(GL_SCISSOR_TEST));
+  uint64_t texels = 0;
+  uint32_t renderCount = 0;
+  for (uint32_t light : pending) {
+    Light& l = lights[light];
+    // until its new tile is clear, a moving light is refreshed in place
+    const bool swap = l.nextTileSize > 0 && nextTileClear(l);
+    const uint32_t tile = swap ? l.nextTileSize : l.tileSize;
+    const uint32_t x = swap ? l.nextX : l.x;
+    const uint32_t y = swap ? l.nextY : l.y;
+    const uint64_t area = uint64_t(tile)*tile;
+    if (!l.moved && renderCount > 0 && texels + area > texelBudget) continue;
+
+    GL(glViewport(GLint(x), GLint(y), GLsizei(tile), GLsizei(tile)));
+    GL(glScissor(GLint(x), GLint(y), GLsizei(tile), GLsizei(tile)));
+    GL(glClear(GL_DEPTH_BUFFER_BIT));
+    drawCasters(light);
+
+    if (swap) {
+      if (l.tileSize > 0) markCells(l.tileSize, l.x, l.y, -1);
+      l.tileSize = tile;
+      l.x = x;
+      l.y = y;
+      l.nextTileSize = 0;
+    }
+    l.moved = false;
+    l.dirty = false;
+    texels += area;
+    renderCount++;
+    tileRenders++;
+  }
+  GL(glDisable(GL_SCISSOR_TEST));
+  framebuffer.unbind2D();
+  return renderCount;
+}
+
+uint32_t ShadowAtlas::getTileSize(uint32_t light) const {
+  if (light >= lights.size() || !lights[light].active) return 0;
+  return lights[light].tileSize;
+}
+
+Vec4 ShadowAtlas::getTileRect(uint32_t light) const {
+  const uint32_t tile = getTileSize(light);
+  if (tile == 0) return Vec4{0,0,0,0};
+  const Light& l = lights[light];
+  return Vec4{float(l.x)/float(size), float(l.y)/float(size),
+              float(tile)/float(size), float(tile)/float(size)};
+}
+
+std::vector<Vec4> ShadowAtlas::getTileRects() const {
+  std::vector<Vec4> rects(lights.size());
+  for (uint32_t light = 0;light<lights.size();++light) rects[light] = getTileRect(light);
+  return rects;
+}
+
+Mat4 ShadowAtlas::getClipToTile(uint32_t light) const {
+  const Vec4 rect = getTileRect(light);
+  const float scale = 0.5f*rect.z;
+  return {scale, 0.0f,  0.0f, rect.x + scale,
+          0.0f,  scale, 0.0f, rect.y + scale,
+          0.0f,  0.0f,  0.5f, 0.5f,
+          0.0f,  0.0f,  0.0f, 1.0f};
+}
+
+uint32_t ShadowAtlas::getPendingTiles() const {
+  uint32_t count = 0;
+  for (const Light& l : lights)
+    if (isPending(l)) count++;
+  return count;
+}
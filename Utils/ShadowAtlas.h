@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "GLFramebuffer.h"
+#include "GLDepthTexture.h"
+#include "Mat4.h"
+#include "Vec4.h"
+
+/**
+ * @file ShadowAtlas.h
+ * @brief One depth texture shared by the shadow maps of many lights.
+ *
+ * Instead of a @ref GLDepthTexture and a framebuffer switch per light, every
+ * shadow-casting light gets a square tile of one large atlas. Tile sizes are
+ * powers of two between a minimum and a maximum and follow each light's
+ * importance (e.g. its projected screen coverage), with hysteresis so that
+ * lights near a size boundary do not flip back and forth.
+ *
+ * Tiles are aligned blocks on a Z-order curve over cells of the minimum
+ * tile size (a buddy allocator), so they stay where they are: when a
+ * light's size changes only its own tile moves. Its new tile is allocated
+ * in free space, while the old one keeps being sampled until the new one
+ * has been rendered; a shrinking tile reuses a corner of its old one. If no
+ * aligned block is free, the smaller tiles in the block that is cheapest to
+ * clear are moved out first, in the same way. A new light has no tile
+ * (and no shadow) until its first render. If the requested tiles no longer
+ * fit into the atlas, the largest, least important ones are halved first.
+ *
+ * Tiles are refreshed under a per-frame texel budget: invalidated and
+ * resized lights wait in a queue ordered by importance and waiting time, so
+ * many lights changing at once spread their updates over several frames.
+ * Only when the free space is too fragmented for a tile and no pending
+ * resize will free any, the atlas is compacted: all tiles are sorted by
+ * size and re-laid out without gaps, and every moved tile is rendered in
+ * the same update.
+ *
+ * In the shader, a light's clip-space shadow coordinate is mapped into its
+ * tile with @ref getClipToTile(); the tile rectangles (@ref getTileRects())
+ * allow clamping filter taps to the tile:
+ * @code
+ * uniform sampler2DShadow shadowAtlas;
+ * uniform mat4 worldToShadow[LIGHTS]; // getClipToTile(i) * lightViewProjection[i]
+ * uniform vec4 shadowTiles[LIGHTS];   // getTileRects(): offset.xy, size.zw
+ *
+ * vec4 p = worldToShadow[i] * vec4(worldPos, 1.0);
+ * p.xy = clamp(p.xy/p.w, shadowTiles[i].xy + halfTexel, shadowTiles[i].xy + shadowTiles[i].zw - halfTexel);
+ * float lit = shadowTiles[i].z > 0.0 ? texture(shadowAtlas, vec3(p.xy, p.z/p.w - bias)) : 1.0;
+ * @endcode
+ */
+class ShadowAtlas {
+public:
+  /**
+   * @brief Allocate the atlas texture.
+   * @param size        Atlas width and height in texels (power of two).
+   * @param minTileSize Smallest tile in texels (power of two).
+   * @param maxTileSize Largest tile in texels (power of two, at most @p size).
+   */
+  ShadowAtlas(uint32_t size=4096, uint32_t minTileSize=128, uint32_t maxTileSize=1024);
+
+  /**
+   * @name Lights
+   * Lights are identified by the index returned from @ref addLight(); indices
+   * of removed lights are reused.
+   */
+  ///@{
+  /** @brief Register a shadow-casting light. */
+  uint32_t addLight(float importance=1.0f);
+  /** @brief Release the light's tile. */
+  void removeLight(uint32_t light);
+  /**
+   * @brief Set how much shadow resolution the light deserves, in [0,1].
+   *
+   * The tile edge scales with the square root of the importance, so an
+   * importance proportional to the light's screen area gives each light a
+   * similar texel density; 1 requests the maximum tile, 0 drops the tile.
+   */
+  void setImportance(uint32_t light, float importance);
+  /** @brief Request a refresh of the light's tile, e.g. after it or a caster moved. */
+  void invalidate(uint32_t light);
+  /** @brief Request a refresh of all tiles. */
+  void invalidateAll();
+  ///@}
+
+  /** @brief Texels rendered per @ref update() before refreshes are deferred. */
+  void setTexelBudget(uint64_t texels) {texelBudget = texels;}
+  uint64_t getTexelBudget() const {return texelBudget;}
+
+  /**
+   * @brief Re-allocate tiles whose sizes changed and render pending tiles.
+   *
+   * @p drawCasters is called per rendered light with the atlas bound, the
+   * viewport set to the light's tile, and the tile's depth cleared; it issues
+   * the depth-only draw calls with the light's own view-projection. At least
+   * one pending tile is rendered per call, so large tiles are never starved.
+   * Afterwards the default framebuffer is bound again.
+   * @return Number of tiles rendered.
+   */
+  uint32_t update(const std::function<void(uint32_t light)>& drawCasters);
+
+  /** @brief The atlas depth texture. */
+  const GLDepthTexture& getTexture() const {return atlas;}
+  uint32_t getSize() const {return size;}
+
+  /** @brief Current tile edge of the light in texels, 0 without a tile. */
+  uint32_t getTileSize(uint32_t light) const;
+  /** @brief Tile of the light in texture coordinates (offset.xy, size.zw), zero without a tile. */
+  Vec4 getTileRect(uint32_t light) const;
+  /** @brief @ref getTileRect() of every light index (removed lights are zero). */
+  std::vector<Vec4> getTileRects() const;
+  /**
+   * @brief Map the light's clip space to its tile.
+   * @return Matrix taking clip coordinates to atlas texture coordinates
+   *         (xy) and depth in [0,1] (z); apply after the light's view-projection.
+   */
+  Mat4 getClipToTile(uint32_t light) const;
+
+  /** @name Statistics */
+  ///@{
+  /** @brief Compactions, see above. */
+  uint64_t getRepacks() const {return repacks;}
+  uint64_t getTileRenders() const {return tileRenders;}
+  /** @brief Tiles still waiting for a refresh after the last update. */
+  uint32_t getPendingTiles() const;
+  ///@}
+
+private:
+  struct Light {
+    bool active{false};
+    float importance{0.0f};
+    uint32_t size{0};          ///< Requested tile edge (after hysteresis).
+    uint32_t tileSize{0};      ///< Edge of the sampled tile (0 = none).
+    uint32_t x{0}, y{0};       ///< Origin of the sampled tile in texels.
+    uint32_t nextTileSize{0};  ///< Edge of the new tile waiting to be rendered (0 = none).
+    uint32_t nextX{0}, nextY{0}; ///< Origin of the new tile in texels.
+    bool moved{false};         ///< Tile contents are invalid after a compaction.
+    bool dirty{false};         ///< Refresh requested.
+    uint64_t dirtySince{0};    ///< Update count when the refresh was requested.
+  };
+
+  uint32_t size;
+  uint32_t minTileSize;
+  uint32_t maxTileSize;
+  uint64_t texelBudget;
+
+  GLDepthTexture atlas;
+  GLFramebuffer framebuffer;
+  std::vector<Light> lights;
+  std::vector<uint8_t> cells; ///< Per minimum-size cell in Z-order: number of tiles holding it.
+  bool layoutChanged{false};
+  uint64_t updateCount{0};
+
+  uint64_t repacks{0};
+  uint64_t tileRenders{0};
+
+  /** @brief Tile edge for @p importance, starting from the current edge @p current. */
+  uint32_t tileSizeFor(float importance, uint32_t current) const;
+  /** @brief Tile edge per light after shrinking the requests to fit the atlas. */
+  std::vector<uint32_t> fitTileSizes() const;
+  /**
+   * @brief Give every light whose tile edge changed a tile of the new edge.
+   * @return False if a tile could not be allocated.
+   */
+  bool allocateTiles(const std::vector<uint32_t>& tiles);
+  /** @brief Lay out all tiles along the Z-order curve without gaps. */
+  void compact(const std::vector<uint32_t>& tiles);
+  /** @brief Index of the first cell of the tile at @p x, @p y on the Z-order curve. */
+  uint64_t firstCell(uint32_t x, uint32_t y) const;
+  /** @brief Number of cells covered by a tile of edge @p tile. */
+  uint64_t cellCount(uint32_t tile) const;
+  /** @brief Add @p delta to the hold counts of the tile's cells. */
+  void markCells(uint32_t tile, uint32_t x, uint32_t y, int delta);
+  /** @brief Find and hold a free aligned block for a tile of edge @p tile. */
+  bool allocate(uint32_t tile, uint32_t& x, uint32_t& y);
+  /**
+   * @brief Hold the aligned block whose tiles are cheapest to move as the
+   *        light's new tile, and allocate new tiles for those tiles.
+   */
+  bool evict(uint32_t light, uint32_t tile);
+  /** @brief True once no other tile holds cells of the light's new tile. */
+  bool nextTileClear(const Light& l) const;
+  /** @brief Drop the light's new tile before it was rendered. */
+  void releaseNextTile(Light& l);
+  /** @brief True if the light's tile needs rendering. */
+  bool isPending(const Light& l) const;
+};
@@ -0,0 +1,68 @@
+#include <cstring>
+
+#include "ShadowMapCache.h"
+#include "Trace.h"
+
+ShadowMapCache::ShadowMapCache(uint32_t width, uint32_t height, bool cacheStaticLayer) :
+  cacheStaticLayer(cacheStaticLayer)
+{
+  shadowMap.setEmpty(width, height);
+  shadowMap.setLabel("shadow map");
+  if (cacheStaticLayer) {
+    // same format as the shadow map, so the depth blit is a plain copy
+    staticLayer.setEmpty(width, height);
+    staticLayer.setLabel("static shadow casters");
+  }
+}
+
+bool ShadowMapCache::update(const Mat4& lightViewProjection, uint64_t staticGeneration,
+                            const std::function<void()>& drawStatic,
+                            uint64_t dynamicGeneration,
+                            const std::function<void()>& drawDynamic) {
+  // bitwise comparison: an unchanged light yields identical matrices
+  const bool lightChanged = !valid ||
+    std::memcmp(static_cast<const float*>(lightViewProjection),
+                static_cast<const float*>(lastViewProjection), 16*sizeof(float)) != 0;
+  const bool staticChanged = lightChanged || staticGeneration != lastStaticGeneration;
+  const bool dynamicChanged = drawDynamic && dynamicGeneration != lastDynamicGeneration;
+
+  if (!staticChanged && !dynamicChanged) {
+    reuses++;
+    return false;
+  }
+
+  TRACE_SCOPE("ShadowMapCache::update");
+  const GLint width = GLint(shadowMap.getWidth());
+  const GLint height = GLint(shadowMap.getHeight());
+
+  if (!cacheStaticLayer) {
+    framebuffer.bind(shadowMap);
+    GL(glClear(GL_DEPTH_BUFFER_BIT));
+    drawStatic();
+    if (drawDynamic) drawDynamic();
+    staticRenders++;
+  } else {
+    if (staticChanged) {
+      staticFramebuffer.bind(staticLayer);
+      GL(glClear(GL_DEPTH_BUFFER_BIT));
+      drawStatic();
+      staticRenders++;
+    } else {
+      dynamicRenders++;
+    }
+    framebuffer.bind(shadowMap);
+    // the static layer stays attached to its own framebuffer between updates
+    GL(glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFramebuffer.getId()));
+    GL(glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                         GL_DEPTH_BUFFER_BIT, GL_NEAREST));
+    GL(glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.getId()));
+    if (drawDynamic) drawDynamic();
+  }
+  framebuffer.unbind2D();
+
+  valid = true;
+  lastViewProjection = lightViewProjection;
+  lastStaticGeneration = staticGeneration;
+  lastDynamicGeneration = dynamicGeneration;
+  return true;
+}
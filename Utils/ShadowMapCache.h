@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "GLFramebuffer.h"
+#include "GLDepthTexture.h"
+#include "Mat4.h"
+
+/**
+ * @file ShadowMapCache.h
+ * @brief Shadow map that is only re-rendered when the light or the scene changed.
+ *
+ * A shadow map depends on nothing but the light's view-projection and the
+ * shadow casters. @ref ShadowMapCache remembers both (the casters through a
+ * caller-maintained generation counter that is bumped on every change) and
+ * skips the depth pass while neither changed, which for a paused light is
+ * every frame.
+ *
+ * Optionally, the static casters are kept in a separate depth layer. Moving
+ * casters then only cost a depth copy plus their own draw calls, and the
+ * static geometry is re-rendered only when the light moves.
+ *
+ * @code
+ *   ShadowMapCache shadows{2048, 2048};
+ *   shadows.update(lightProjection*lightView, sceneGeneration, [&]() {drawCasters();});
+ *   program.setTexture("shadowMap", shadows.getShadowMap(), 3);
+ * @endcode
+ */
+class ShadowMapCache {
+public:
+  /**
+   * @brief Allocate the shadow map (and the static layer if requested).
+   * @param width            Shadow map width in texels.
+   * @param height           Shadow map height in texels.
+   * @param cacheStaticLayer Keep the static casters in their own layer and
+   *                         composite dynamic casters on top of a copy.
+   */
+  ShadowMapCache(uint32_t width, uint32_t height, bool cacheStaticLayer=false);
+
+  /**
+   * @brief Bring the shadow map up to date.
+   *
+   * The callbacks issue the depth-only draw calls of the casters with the
+   * shadow framebuffer bound, its viewport set, and (for a full redraw) depth
+   * cleared. Afterwards the default framebuffer is bound again; the viewport
+   * is left at the shadow map size.
+   * @param lightViewProjection Projection times view matrix of the light.
+   * @param staticGeneration    Changes whenever a static caster changed.
+   * @param drawStatic          Draws the static casters.
+   * @param dynamicGeneration   Changes whenever a dynamic caster changed
+   *                            (typically every frame they move).
+   * @param drawDynamic         Draws the dynamic casters (may be empty).
+   * @return True if anything was rendered, false if the cached map was reused.
+   */
+  bool update(const Mat4& lightViewProjection, uint64_t staticGeneration,
+              const std::function<void()>& drawStatic,
+              uint64_t dynamicGeneration=0,
+              const std::function<void()>& drawDynamic={});
+
+  /** @brief Force a full redraw on the next @ref update(), e.g. after a context reset. */
+  void invalidate() {valid = false;}
+
+  /** @brief Depth texture to sample; valid after the first @ref update(). */
+  const GLDepthTexture& getShadowMap() const {return shadowMap;}
+  /** @brief Whether static casters are kept in their own layer. */
+  bool hasStaticLayer() const {return cacheStaticLayer;}
+
+  /** @name Statistics */
+  ///@{
+  /** @brief Updates that rendered the static casters. */
+  uint64_t getStaticRenders() const {return staticRenders;}
+  /** @brief Updates that rendered only the dynamic casters onto the static layer. */
+  uint64_t getDynamicRenders() const {return dynamicRenders;}
+  /** @brief Updates that reused the cached map. */
+  uint64_t getReuses() const {return reuses;}
+  ///@}
+
+private:
+  bool cacheStaticLayer;
+  GLDepthTexture shadowMap;
+  GLDepthTexture staticLayer;
+  GLFramebuffer framebuffer;
+  GLFramebuffer staticFramebuffer;
+
+  bool valid{false};
+  Mat4 lastViewProjection;
+  uint64_t lastStaticGeneration{0};
+  uint64_t lastDynamicGeneration{0};
+
+  uint64_t staticRenders{0};
+  uint64_t dynamicRenders{0};
+  uint64_t reuses{0};
+};
@@ -0,0 +1,109 @@
+#include <vector>
+
+#include "SinglePassStereo.h"
+
+static const std::string vertexFunctions = R"(
+uniform mat4 stereoView[2];
+uniform mat4 stereoProjection[2];
+
+int stereoEye() {
+  return gl_InstanceID & 1;
+}
+
+int stereoInstance() {
+  return gl_InstanceID >> 1;
+}
+
+mat4 stereoViewMatrix() {
+  return stereoView[stereoEye()];
+}
+
+mat4 stereoProjectionMatrix() {
+  return stereoProjection[stereoEye()];
+}
+)";
+
+#ifndef __EMSCRIPTEN__
+static const std::string clipOutput = R"(
+void stereoClipDistance(float d) {
+  gl_ClipDistance[0] = d;
+}
+)";
+
+static const std::string fragmentFunctions = R"(
+void stereoClip() {}
+)";
+#else
+// WebGL has no clip distances; interpolate the distance and discard instead
+static const std::string clipOutput = R"(
+out float stereoClipDistanceVarying;
+
+void stereoClipDistance(float d) {
+  stereoClipDistanceVarying = d;
+}
+)";
+
+static const std::string fragmentFunctions = R"(
+in float stereoClipDistanceVarying;
+
+void stereoClip() {
+  if (stereoClipDistanceVarying < 0.0) discard;
+}
+)";
+#endif
+
+static const std::string projectFunction = R"(
+vec4 stereoProject(vec4 viewPosition) {
+  vec4 p = stereoProjectionMatrix() * viewPosition;
+  // left eye: x/w in [-1,1] -> [-1,0], right eye: -> [0,1]
+  float side = stereoEye() == 0 ? -1.0 : 1.0;
+  // the eye's own frustum ends where its half of the viewport does
+  stereoClipDistance(p.w + side * p.x);
+  p.x = 0.5 * (p.x + side * p.w);
+  return p;
+}
+)";
+
+void SinglePassStereo::setCamera(const Vec3& eye, const Vec3& at, const Vec3& up,
+                                 float fovy, float aspect, float znear, float zfar,
+                                 float focalLength, float eyeDist) {
+  matrices = Mat4::stereoLookAtAndProjection(eye, at, up, fovy, aspect, znear, zfar,
+                                             focalLength, eyeDist);
+}
+
+std::string SinglePassStereo::vertexShaderFunctions() {
+  return vertexFunctions + clipOutput + projectFunction;
+}
+
+std::string SinglePassStereo::fragmentShaderFunctions() {
+  return fragmentFunctions;
+}
+
+void SinglePassStereo::begin(const Dimensions& size) const {
+  GL(glViewport(0, 0, GLsizei(size.width), GLsizei(size.height)));
+#ifndef __EMSCRIPTEN__
+  GL(glEnable(GL_CLIP_DISTANCE0));
+#endif
+}
+
+void SinglePassStereo::end() const {
+#ifndef __EMSCRIPTEN__
+  GL(glDisable(GL_CLIP_DISTANCE0));
+#endif
+}
+
+void SinglePassStereo::setUniforms(const GLProgram& program) const {
+  const std::vector<Mat4> views{matrices.leftView, matrices.rightView};
+  const std::vector<Mat4> projections{matrices.leftProj, matrices.rightProj};
+  program.setUniform(program.getUniformLocation("stereoView"), views);
+  program.setUniform(program.getUniformLocation("stereoProjection"), projections);
+}
+
+void SinglePassStereo::drawArrays(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) {
+  GL(glDrawArraysInstanced(mode, first, count, 2 * instanceCount));
+}
+
+void SinglePassStereo::drawElements(GLenum mode, GLsizei count, GLenum type,
+                                    const void* indices, GLsizei instanceCount) {
+  GL(glDrawElementsInstanced(mode, count, type, indices, 2 * instanceCount));
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+
+#include "GLEnv.h"
+#include "GLProgram.h"
+#include "Mat4.h"
+#include "Vec3.h"
+
+/**
+ * @file SinglePassStereo.h
+ * @brief Render both eyes of a stereo frame with one submission per mesh.
+ *
+ * The straightforward stereo frame renders the scene twice, once per eye
+ * with its own viewport and matrices, which doubles the draw calls, state
+ * changes, and uniform uploads. Here every mesh is drawn once with twice its
+ * instance count. The vertex shader picks the eye from \c gl_InstanceID
+ * (even instances left, odd right), transforms with that eye's matrices
+ * from @ref Mat4::stereoLookAtAndProjection(), and squeezes the result into
+ * the eye's half of a side-by-side viewport. A clip plane at the center
+ * keeps each eye out of the other's half: \c gl_ClipDistance on desktop GL;
+ * WebGL lacks it, so there the fragment shader discards instead.
+ *
+ * Vertex and fragment shaders include the helpers after the version header:
+ * @code
+ * // vertex shader
+ * uniform mat4 M;
+ * in vec3 vPos;
+ * void main() {
+ *   gl_Position = stereoProject(stereoViewMatrix() * M * vec4(vPos, 1.0));
+ * }
+ * // fragment shader
+ * void main() {
+ *   stereoClip();
+ *   ...
+ * }
+ *
+ * auto program = GLProgram::createFromStrings(
+ *   {GLProgramVariants::versionHeader(), SinglePassStereo::vertexShaderFunctions(), vs},
+ *   {GLProgramVariants::versionHeader(), SinglePassStereo::fragmentShaderFunctions(), fs});
+ *
+ * stereo.setCamera(eye, at, up, 60.0f, 0.5f * getAspect(), 0.1f, 100.0f, 10.0f, 0.065f);
+ * stereo.begin(getRenderSize());
+ * stereo.setUniforms(program);
+ * for (auto& o : objects) {
+ *   program.setUniform("M", o.model);
+ *   o.array.bind();
+ *   SinglePassStereo::drawElements(GL_TRIANGLES, o.indexCount, GL_UNSIGNED_INT);
+ * }
+ * stereo.end();
+ * @endcode
+ *
+ * For instanced meshes, \c stereoInstance() returns the mesh's own instance
+ * index, and per-instance vertex attributes need a divisor of 2 so that
+ * both eyes read the same instance.
+ *
+ * The output is side-by-side on every platform. Routing the eyes into a
+ * 2-layer texture array instead needs \c gl_Layer: from the vertex shader
+ * only with \c ARB_shader_viewport_layer_array, which GL 4.1 lacks, or from
+ * a geometry shader as in @ref CubeMapPass, which adds a stage to every
+ * stereo draw. WebGL 2 offers neither, so it would fall back to one pass
+ * per eye, the cost this class exists to avoid. Copy the halves into
+ * separate textures where a compositor wants one image per eye.
+ *
+ * The drawing helpers of @ref GLApp (drawLines(), drawTriangles(),
+ * drawImage(), ...) stay mono: their stock programs do not include these
+ * functions. Draw helper geometry once per eye with that eye's half of the
+ * viewport and matrices (@ref GLApp::setDrawProjection(),
+ * @ref GLApp::setDrawTransform()), or after @ref end() for overlays that
+ * span both halves.
+ */
+class SinglePassStereo {
+public:
+  /** @brief Use eye matrices computed elsewhere. */
+  void setMatrices(const Mat4::StereoMatrices& matrices) {this->matrices = matrices;}
+  /**
+   * @brief Compute the eye matrices with @ref Mat4::stereoLookAtAndProjection().
+   * @param aspect Aspect ratio of one eye, i.e. of half the viewport.
+   * See there for the other parameters.
+   */
+  void setCamera(const Vec3& eye, const Vec3& at, const Vec3& up,
+                 float fovy, float aspect, float znear, float zfar,
+                 float focalLength, float eyeDist);
+  const Mat4::StereoMatrices& getMatrices() const {return matrices;}
+
+  /**
+   * @brief GLSL for vertex shaders.
+   *
+   * - \c int stereoEye(): 0 for the left, 1 for the right eye.
+   * - \c int stereoInstance(): instance index of the mesh itself.
+   * - \c mat4 stereoViewMatrix(), \c mat4 stereoProjectionMatrix(): the
+   *   matrices of the eye.
+   * - \c vec4 stereoProject(vec4 viewPosition): clip-space position in the
+   *   eye's half of the viewport; also sets up the clipping at the center,
+   *   so it must be called exactly once.
+   */
+  static std::string vertexShaderFunctions();
+  /**
+   * @brief GLSL for fragment shaders: \c void stereoClip(), to be called
+   *        first in \c main().
+   */
+  static std::string fragmentShaderFunctions();
+
+  /**
+   * @brief Set the side-by-side viewport and enable the center clip plane.
+   * @param size Size of both halves together, e.g. @ref GLApp::getRenderSize().
+   */
+  void begin(const Dimensions& size) const;
+  /** @brief Disable the center clip plane again. */
+  void end() const;
+
+  /** @brief Upload both eyes' matrices to @p program (which must be enabled). */
+  void setUniforms(const GLProgram& program) const;
+
+  /** @name Draw calls for both eyes */
+  ///@{
+  /** @brief \c glDrawArraysInstanced() with 2 × @p instanceCount instances. */
+  static void drawArrays(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount=1);
+  /** @brief \c glDrawElementsInstanced() with 2 × @p instanceCount instances. */
+  static void drawElements(GLenum mode, GLsizei count, GLenum type,
+                           const void* indices=nullptr, GLsizei instanceCount=1);
+  ///@}
+
+private:
+  Mat4::StereoMatrices matrices; ///< Identity until set: both eyes at the origin.
+};
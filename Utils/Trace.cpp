@@ -0,0 +1,219 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "Trace.h"
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  struct Event {
+    const char* name;
+    char phase;       ///< 'B', 'E', or 'C' as in the trace_event format.
+    double timestamp; ///< Microseconds since the process started tracing.
+    double value;     ///< Counter value.
+    std::string arg;  ///< Optional string argument of 'B' events.
+  };
+
+  /**
+   * Fixed-size block of events. The owning thread fills the slots and
+   * publishes them by bumping @c count (release); the flush reads @c count
+   * (acquire) and never touches unpublished slots, so neither side locks.
+   */
+  struct Chunk {
+    static const size_t capacity = 4096;
+    Event events[capacity];
+    std::atomic<size_t> count{0};
+    std::atomic<Chunk*> next{nullptr};
+  };
+
+  struct ThreadBuffer {
+    uint32_t tid;
+    std::string name;
+    Chunk* head;
+    Chunk* tail; ///< Only accessed by the owning thread.
+  };
+
+  struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+    Clock::time_point start{Clock::now()};
+    std::string filename;
+    bool flushed{false};
+
+    Registry() {
+      const char* env = std::getenv("TRACE_FILE");
+      filename = env ? env : "trace.json";
+    }
+  };
+
+  // never destroyed so that threads still running during static
+  // destruction can record safely
+  Registry& registry() {
+    static Registry* r = new Registry();
+    return *r;
+  }
+
+  void flushAtExit() {
+    Trace::flush();
+  }
+
+  ThreadBuffer& threadBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer) return *buffer;
+
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.threads.empty()) std::atexit(flushAtExit);
+    std::unique_ptr<ThreadBuffer> b{new ThreadBuffer()};
+    b->tid  = uint32_t(r.threads.size()+1);
+    b->name = b->tid == 1 ? "main" : "thread " + std::to_string(b->tid);
+    b->head = b->tail = new Chunk();
+    buffer = b.get();
+    r.threads.push_back(std::move(b));
+    return *buffer;
+  }
+
+  void record(const char* name, char phase, double value, const std::string* arg) {
+    ThreadBuffer& b = threadBuffer();
+    Chunk* chunk = b.tail;
+    size_t index = chunk->count.load(std::memory_order_relaxed);
+    if (index == Chunk::capacity) {
+      Chunk* fresh = new Chunk();
+      chunk->next.store(fresh, std::memory_order_release);
+      b.tail = chunk = fresh;
+      index = 0;
+    }
+
+    Event& e = chunk->events[index];
+    e.name      = name;
+    e.phase     = phase;
+    e.timestamp = std::chrono::duration<double, std::micro>(Clock::now() - registry().start).count();
+    e.value     = value;
+    if (arg) e.arg = *arg;
+    chunk->count.store(index+1, std::memory_order_release);
+  }
+
+  void writeEscaped(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+      switch (c) {
+        case '"'  : out << "\\\""; break;
+        case '\\' : out << "\\\\"; break;
+        case '\n' : out << "\\n"; break;
+        case '\t' : out << "\\t"; break;
+        default :
+          if (static_cast<unsigned char>(c) < 0x20) {
+            char hex[8];
+            snprintf(hex, sizeof(hex), "\\u%04x", c);
+            out << hex;
+          } else {
+            out << c;
+          }
+      }
+    }
+    out << '"';
+  }
+
+  void writeEvent(std::ostream& out, const Event& e, uint32_t tid) {
+    out << "{\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << e.timestamp;
+    switch (e.phase) {
+      case 'B' :
+        out << ",\"name\":";
+        writeEscaped(out, e.name);
+        if (!e.arg.empty()) {
+          out << ",\"args\":{\"detail\":";
+          writeEscaped(out, e.arg);
+          out << "}";
+        }
+        break;
+      case 'C' :
+        out << ",\"name\":";
+        writeEscaped(out, e.name);
+        out << ",\"args\":{\"value\":" << e.value << "}";
+        break;
+      default :
+        break;
+    }
+    out << "}";
+  }
+
+  void writeTrace(std::ostream& out, Registry& r) {
+    out << std::fixed;
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const std::unique_ptr<ThreadBuffer>& b : r.threads) {
+      out << (first ? "" : ",\n")
+          << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+      writeEscaped(out, b->name);
+      out << "}}";
+      first = false;
+
+      for (Chunk* c = b->head;c;c = c->next.load(std::memory_order_acquire)) {
+        const size_t count = c->count.load(std::memory_order_acquire);
+        for (size_t i = 0;i<count;++i) {
+          out << ",\n";
+          writeEvent(out, c->events[i], b->tid);
+        }
+      }
+    }
+    out << "\n]}\n";
+  }
+}
+
+namespace Trace {
+  void begin(const char* name) {
+    record(name, 'B', 0.0, nullptr);
+  }
+
+  void begin(const char* name, const std::string& arg) {
+    record(name, 'B', 0.0, &arg);
+  }
+
+  void end() {
+    record(nullptr, 'E', 0.0, nullptr);
+  }
+
+  void counter(const char* name, double value) {
+    record(name, 'C', value, nullptr);
+  }
+
+  void setThreadName(const std::string& name) {
+    ThreadBuffer& b = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    b.name = name;
+  }
+
+  void setOutputFile(const std::string& filename) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.filename = filename;
+  }
+
+  void flush() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.filename.empty() || r.threads.empty()) return;
+
+    if (r.filename == "-") {
+      writeTrace(std::cout, r);
+    } else {
+      std::ofstream file{r.filename};
+      if (!file) {
+        std::cerr << "Trace: unable to write " << r.filename << std::endl;
+        return;
+      }
+      writeTrace(file, r);
+      if (!r.flushed) std::cout << "Trace written to " << r.filename << std::endl;
+    }
+    r.flushed = true;
+  }
+}
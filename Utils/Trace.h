@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @file Trace.h
+ * @brief Timeline tracing to Chrome \c trace_event JSON (chrome://tracing, Perfetto).
+ *
+ * Tracing is compiled in only when \c ENABLE_TRACING is defined (for example
+ * via \c make \c trace). Otherwise all \c TRACE_* macros expand to nothing and
+ * the instrumented code is unchanged.
+ *
+ * @details Usage:
+ * @code
+ * void load() {
+ *   TRACE_SCOPE("load");              // begin/end pair around the block
+ *   TRACE_SCOPE_ARG("file", name);    // with a string argument
+ *   TRACE_COUNTER("triangles", n);    // counter track
+ * }
+ * @endcode
+ * Every thread appends to its own event buffer, so recording takes no
+ * locks; a mutex is only taken once per thread to register its buffer. All
+ * buffers are written when the process exits, to the file named by the
+ * \c TRACE_FILE environment variable or \c trace.json by default (see
+ * @ref Trace::setOutputFile()).
+ *
+ * @note Event names must be string literals (or otherwise outlive the
+ *       process); use the \c _ARG variants for dynamic text.
+ */
+namespace Trace {
+  /** @brief Open a duration event on the calling thread. */
+  void begin(const char* name);
+  /** @brief Open a duration event with a string argument shown in the viewer. */
+  void begin(const char* name, const std::string& arg);
+  /** @brief Close the innermost open duration event of the calling thread. */
+  void end();
+  /** @brief Record the value of a counter track. */
+  void counter(const char* name, double value);
+  /** @brief Name the calling thread in the timeline. */
+  void setThreadName(const std::string& name);
+  /** @brief Override the output filename (empty disables writing). */
+  void setOutputFile(const std::string& filename);
+  /** @brief Write all events now (also happens automatically at exit). */
+  void flush();
+
+  /**
+   * @brief RAII helper that emits a begin/end pair.
+   */
+  class Scope {
+  public:
+    explicit Scope(const char* name) {begin(name);}
+    Scope(const char* name, const std::string& arg) {begin(name, arg);}
+    ~Scope() {end();}
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  };
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef ENABLE_TRACING
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__){name}
+#define TRACE_SCOPE_ARG(name, arg) Trace::Scope TRACE_CONCAT(traceScope, __LINE__){name, arg}
+#define TRACE_BEGIN(name) Trace::begin(name)
+#define TRACE_END() Trace::end()
+#define TRACE_COUNTER(name, value) Trace::counter(name, double(value))
+#define TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_ARG(name, arg)
+#define TRACE_BEGIN(name)
+#define TRACE_END()
+#define TRACE_COUNTER(name, value)
+#define TRACE_THREAD_NAME(name)
+#endif
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "MicroBench.h"
+
+const void* volatile MicroBench::sink = nullptr;
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  double secondsFor(uint64_t iterations, const std::function<void()>& kernel) {
+    const Clock::time_point start = Clock::now();
+    for (uint64_t i = 0;i<iterations;++i) kernel();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  const char* unitName(MicroBench::Unit unit) {
+    switch (unit) {
+      case MicroBench::Unit::PIXELS : return "pixels/s";
+      case MicroBench::Unit::BYTES  : return "MB/s";
+      default                       : return "ops/s";
+    }
+  }
+
+  std::string humanReadable(double value) {
+    const char* suffix[] = {"", "k", "M", "G", "T"};
+    size_t i = 0;
+    while (value >= 1000.0 && i < 4) {
+      value /= 1000.0;
+      ++i;
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%7.2f%s", value, suffix[i]);
+    return buffer;
+  }
+
+  // value following "key": on a line written by writeJSON
+  std::string findField(const std::string& line, const std::string& key) {
+    const std::string pattern = "\"" + key + "\":";
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos) return "";
+    pos = line.find_first_not_of(' ', pos + pattern.size());
+    if (pos == std::string::npos) return "";
+    if (line[pos] == '"') {
+      const size_t end = line.find('"', pos+1);
+      return end == std::string::npos ? "" : line.substr(pos+1, end-pos-1);
+    }
+    const size_t end = line.find_first_of(",}", pos);
+    return line.substr(pos, end == std::string::npos ? std::string::npos : end-pos);
+  }
+}
+
+MicroBench::MicroBench(double sampleTime, size_t samples, const std::string& filter) :
+  sampleTime(sampleTime),
+  samples(std::max<size_t>(samples, 1)),
+  filter(filter),
+  results()
+{
+}
+
+void MicroBench::run(const std::string& name, Unit unit, double work, const std::function<void()>& kernel) {
+  if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+  // warm up caches and allocators, then grow the batch until it fills a sample
+  kernel();
+  uint64_t iterations = 1;
+  double seconds = secondsFor(iterations, kernel);
+  while (seconds < sampleTime) {
+    const double scale = seconds > 0.0 ? 1.2 * sampleTime / seconds : 10.0;
+    iterations = std::max(iterations+1, uint64_t(double(iterations) * std::min(scale, 10.0)));
+    seconds = secondsFor(iterations, kernel);
+  }
+
+  std::vector<double> nsPerOp(samples);
+  for (double& ns : nsPerOp) {
+    ns = secondsFor(iterations, kernel) * 1e9 / double(iterations);
+  }
+  std::sort(nsPerOp.begin(), nsPerOp.end());
+  const double median = nsPerOp[nsPerOp.size()/2];
+
+  double throughput = work / (median * 1e-9);
+  if (unit == Unit::BYTES) throughput /= 1e6;
+
+  results.push_back({name, unitName(unit), median, throughput, iterations});
+  std::cout << std::left << std::setw(36) << name << std::right
+            << std::setw(14) << std::fixed << std::setprecision(1) << median << " ns/op  "
+            << humanReadable(throughput) << " " << unitName(unit) << std::endl;
+}
+
+bool MicroBench::writeJSON(const std::string& filename) const {
+  std::ofstream file{filename};
+  if (!file) return false;
+
+  file << "{\n  \"benchmarks\": [\n";
+  file << std::setprecision(9);
+  for (size_t i = 0;i<results.size();++i) {
+    const Result& r = results[i];
+    file << "    {\"name\": \"" << r.name << "\", \"unit\": \"" << r.unit
+         << "\", \"ns_per_op\": " << r.nsPerOp << ", \"throughput\": " << r.throughput
+         << ", \"iterations\": " << r.iterations << "}" << (i+1 < results.size() ? "," : "") << "\n";
+  }
+  file << "  ]\n}\n";
+  return bool(file);
+}
+
+std::map<std::string, double> MicroBench::readJSON(const std::string& filename) {
+  std::ifstream file{filename};
+  if (!file) throw std::runtime_error{"Unable to read benchmark baseline " + filename};
+
+  std::map<std::string, double> throughput;
+  std::string line;
+  while (std::getline(file, line)) {
+    const std::string name  = findField(line, "name");
+    const std::string value = findField(line, "throughput");
+    if (name.empty() || value.empty()) continue;
+    throughput[name] = std::stod(value);
+  }
+  return throughput;
+}
+
+bool MicroBench::compare(const std::map<std::string, double>& baseline, double tolerance, std::ostream& out) const {
+  bool passed = true;
+  size_t regressions = 0;
+  out << "\nComparison against baseline (tolerance " << int(tolerance*100+0.5) << "%)\n";
+  for (const Result& r : results) {
+    out << "  " << std::left << std::setw(36) << r.name << std::right;
+    const auto b = baseline.find(r.name);
+    if (b == baseline.end() || b->second <= 0.0) {
+      out << "     new\n";
+      continue;
+    }
+    const double ratio = r.throughput / b->second;
+    const bool regressed = ratio < 1.0 - tolerance;
+    out << std::setw(8) << std::fixed << std::setprecision(2) << ratio << "x"
+        << (regressed ? "  REGRESSION" : "") << "\n";
+    if (regressed) {
+      passed = false;
+      ++regressions;
+    }
+  }
+  for (const auto& b : baseline) {
+    const bool measured = std::any_of(results.begin(), results.end(),
+                                      [&b](const Result& r) {return r.name == b.first;});
+    if (!measured && (filter.empty() || b.first.find(filter) != std::string::npos)) {
+      out << "  " << std::left << std::setw(36) << b.first << std::right << " missing\n";
+    }
+  }
+  if (passed) {
+    out << "PASSED\n";
+  } else {
+    out << "FAILED: " << regressions << " regression(s)\n";
+  }
+  return passed;
+}
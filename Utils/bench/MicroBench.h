@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @file MicroBench.h
+ * @brief Minimal micro-benchmark harness for the CPU kernels in Utils.
+ *
+ * Each benchmark is a kernel (a callable performing one operation) together
+ * with the amount of work that operation represents. @ref MicroBench::run
+ * first calibrates how many calls make up one sample of at least
+ * @c sampleTime seconds, then takes @c samples samples and reports the median
+ * time per call and the resulting throughput.
+ *
+ * Results can be written as JSON and compared against an earlier report;
+ * a benchmark whose throughput dropped by more than the tolerance counts as
+ * a regression (see @ref MicroBench::compare).
+ */
+class MicroBench {
+public:
+  /**
+   * @brief Unit of the work performed by one kernel call.
+   */
+  enum class Unit {
+    PIXELS, ///< Pixels (or grid cells), reported as pixels/s.
+    BYTES,  ///< Bytes, reported as MB/s.
+    OPS     ///< Operations, reported as ops/s.
+  };
+
+  /**
+   * @brief Measurement of one benchmark.
+   */
+  struct Result {
+    std::string name;
+    std::string unit;    ///< "pixels/s", "MB/s", or "ops/s".
+    double nsPerOp;      ///< Median time of one kernel call in nanoseconds.
+    double throughput;   ///< Work per second in @ref unit.
+    uint64_t iterations; ///< Kernel calls per sample.
+  };
+
+  /**
+   * @brief Create a harness.
+   * @param sampleTime Minimum duration of one sample in seconds.
+   * @param samples    Number of samples per benchmark (the median is reported).
+   * @param filter     Only benchmarks whose name contains this string run.
+   */
+  MicroBench(double sampleTime=0.05, size_t samples=5, const std::string& filter="");
+
+  /**
+   * @brief Measure @p kernel, print a line, and store the result. Does
+   *        nothing if @p name does not match the filter.
+   * @param name   Unique name, conventionally "Class::function/size".
+   * @param unit   Unit of @p work.
+   * @param work   Work performed by one call of @p kernel.
+   * @param kernel The operation to measure.
+   */
+  void run(const std::string& name, Unit unit, double work, const std::function<void()>& kernel);
+
+  /** @brief All results so far, in run order. */
+  const std::vector<Result>& getResults() const {return results;}
+
+  /**
+   * @brief Write the results as JSON (one benchmark per line).
+   * @return False if @p filename cannot be written.
+   */
+  bool writeJSON(const std::string& filename) const;
+
+  /**
+   * @brief Read the throughput per benchmark name from a report written by
+   *        @ref writeJSON.
+   * @throw std::runtime_error If the file cannot be read.
+   */
+  static std::map<std::string, double> readJSON(const std::string& filename);
+
+  /**
+   * @brief Print each result relative to @p baseline.
+   * @param tolerance Relative throughput loss that still passes (0.15 = 15%).
+   * @return False if any benchmark regressed by more than @p tolerance.
+   *         Benchmarks missing from either side are listed but never fail.
+   */
+  bool compare(const std::map<std::string, double>& baseline, double tolerance, std::ostream& out) const;
+
+  /**
+   * @brief Prevent the compiler from discarding a value computed only for
+   *        benchmarking.
+   */
+  template <typename T> static void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    sink = &value;
+#endif
+  }
+
+private:
+  double sampleTime;
+  size_t samples;
+  std::string filter;
+  std::vector<Result> results;
+
+  static const void* volatile sink;
+};
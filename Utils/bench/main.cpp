@@ -0,0 +1,320 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+#include "Grid2D.h"
+#include "OBJFile.h"
+#include "bmp.h"
+#include "ImageLoader.h"
+#include "Mat4.h"
+#include "OcclusionCuller.h"
+#include "Rand.h"
+
+#include "MicroBench.h"
+
+/**
+ * @file main.cpp
+ * @brief Micro-benchmarks of the CPU kernels in Utils (\c make \c bench).
+ *
+ * Usage: <tt>utils_bench [--quick] [--filter TEXT] [--report FILE]
+ * [--baseline FILE] [--tolerance FRACTION]</tt>
+ *
+ * All inputs are generated from fixed seeds; files for the loaders are
+ * written to a temporary directory first, so the file-based benchmarks
+ * include the (warm) page cache but no disk access.
+ */
+
+namespace {
+  typedef MicroBench::Unit Unit;
+
+  Image randomImage(uint32_t size, uint8_t componentCount, uint32_t seed) {
+    Random random{seed};
+    Image image{size, size, componentCount};
+    for (uint8_t& v : image.data) v = uint8_t(random.rand01() * 255.0f);
+    return image;
+  }
+
+  double fileSize(const std::string& filename) {
+    return double(std::filesystem::file_size(filename));
+  }
+
+  /**
+   * Triangulated UV sphere with roughly 2*size*size faces, written the way
+   * common exporters do (positions, normals, then faces).
+   */
+  void writeSphereOBJ(const std::string& filename, uint32_t size) {
+    std::ofstream file{filename};
+    const float pi = 3.14159265358979f;
+    for (uint32_t i = 0;i<=size;++i) {
+      const float theta = pi * float(i) / float(size);
+      for (uint32_t j = 0;j<size;++j) {
+        const float phi = 2.0f * pi * float(j) / float(size);
+        const Vec3 p{std::sin(theta)*std::cos(phi), std::cos(theta), std::sin(theta)*std::sin(phi)};
+        file << "v " << p.x << " " << p.y << " " << p.z << "\n";
+      }
+    }
+    for (uint32_t i = 0;i<=size;++i) {
+      const float theta = pi * float(i) / float(size);
+      for (uint32_t j = 0;j<size;++j) {
+        const float phi = 2.0f * pi * float(j) / float(size);
+        file << "vn " << std::sin(theta)*std::cos(phi) << " " << std::cos(theta) << " "
+             << std::sin(theta)*std::sin(phi) << "\n";
+      }
+    }
+    for (uint32_t i = 0;i<size;++i) {
+      for (uint32_t j = 0;j<size;++j) {
+        const uint32_t a = i*size + j + 1;
+        const uint32_t b = i*size + (j+1)%size + 1;
+        const uint32_t c = a + size;
+        const uint32_t d = b + size;
+        file << "f " << a << " " << c << " " << b << "\n";
+        file << "f " << b << " " << c << " " << d << "\n";
+      }
+    }
+  }
+
+  void benchImage(MicroBench& bench, const std::vector<uint32_t>& sizes) {
+    Grid2D blur{3, 3};
+    blur.fill(1.0f/9.0f);
+
+    for (uint32_t size : sizes) {
+      const Image image = randomImage(size, 4, size);
+      const double pixels = double(size)*double(size);
+      const std::string s = "/" + std::to_string(size);
+
+      bench.run("Image::filter" + s, Unit::PIXELS, pixels, [&]() {
+        MicroBench::keep(image.filter(blur));
+      });
+      bench.run("Image::resample" + s, Unit::PIXELS, pixels/4, [&]() {
+        MicroBench::keep(image.resample(size/2));
+      });
+      bench.run("Image::toGrayscale" + s, Unit::PIXELS, pixels, [&]() {
+        MicroBench::keep(image.toGrayscale());
+      });
+      bench.run("Image::flipHorizontal" + s, Unit::PIXELS, pixels, [&]() {
+        MicroBench::keep(image.flipHorizontal());
+      });
+      bench.run("Image::flipVertical" + s, Unit::PIXELS, pixels, [&]() {
+        MicroBench::keep(image.flipVertical());
+      });
+    }
+  }
+
+  void benchGrid2D(MicroBench& bench, const std::vector<uint32_t>& sizes) {
+    for (uint32_t size : sizes) {
+      const Grid2D a = Grid2D::genRandom(size, size, 1);
+      const Grid2D b = Grid2D::genRandom(size, size, 2);
+      const double cells = double(size)*double(size);
+      const std::string s = "/" + std::to_string(size);
+
+      bench.run("Grid2D::operator+" + s, Unit::PIXELS, cells, [&]() {
+        MicroBench::keep(a + b);
+      });
+      bench.run("Grid2D::operator*" + s, Unit::PIXELS, cells, [&]() {
+        MicroBench::keep(a * b);
+      });
+      bench.run("Grid2D::operator*(float)" + s, Unit::PIXELS, cells, [&]() {
+        MicroBench::keep(a * 0.5f);
+      });
+
+      Random random{size};
+      std::vector<Vec2> positions(65536);
+      for (Vec2& p : positions) p = Vec2{random.rand01(), random.rand01()};
+      bench.run("Grid2D::sample" + s, Unit::OPS, double(positions.size()), [&]() {
+        float sum = 0.0f;
+        for (const Vec2& p : positions) sum += a.sample(p);
+        MicroBench::keep(sum);
+      });
+
+      bench.run("Grid2D::toSignedDistance" + s, Unit::PIXELS, cells, [&]() {
+        MicroBench::keep(a.toSignedDistance(0.5f));
+      });
+    }
+  }
+
+  void benchOBJFile(MicroBench& bench, const std::filesystem::path& dir, const std::vector<uint32_t>& sizes) {
+    for (uint32_t size : sizes) {
+      const std::string filename = (dir / ("sphere" + std::to_string(size) + ".obj")).string();
+      writeSphereOBJ(filename, size);
+      bench.run("OBJFile::OBJFile/" + std::to_string(2*size*size), Unit::BYTES, fileSize(filename), [&]() {
+        MicroBench::keep(OBJFile{filename});
+      });
+    }
+  }
+
+  void benchFiles(MicroBench& bench, const std::filesystem::path& dir, const std::vector<uint32_t>& sizes) {
+    for (uint32_t size : sizes) {
+      const Image image = randomImage(size, 3, size);
+      const std::string s = "/" + std::to_string(size);
+      const std::string filename = (dir / ("image" + std::to_string(size) + ".bmp")).string();
+      BMP::save(filename, image);
+      const double bytes = fileSize(filename);
+
+      bench.run("BMP::save" + s, Unit::BYTES, bytes, [&]() {
+        MicroBench::keep(BMP::save(filename, image));
+      });
+      bench.run("BMP::load" + s, Unit::BYTES, bytes, [&]() {
+        MicroBench::keep(BMP::load(filename));
+      });
+      bench.run("ImageLoader::load" + s, Unit::BYTES, bytes, [&]() {
+        MicroBench::keep(ImageLoader::load(filename));
+      });
+    }
+  }
+
+  void benchMat4(MicroBench& bench) {
+    const size_t count = 1024;
+    std::vector<Mat4> matrices(count);
+    for (size_t i = 0;i<count;++i) {
+      matrices[i] = Mat4::rotationAxis({1.0f, float(i), 2.0f}, float(i)) *
+                    Mat4::translation(float(i), 1.0f, -float(i)) * Mat4::scaling(1.0f + float(i)/count);
+    }
+    std::vector<Mat4> out(count);
+
+    bench.run("Mat4::operator*", Unit::OPS, double(count), [&]() {
+      for (size_t i = 0;i<count;++i) out[i] = matrices[i] * matrices[count-1-i];
+      MicroBench::keep(out);
+    });
+    bench.run("Mat4::inverse", Unit::OPS, double(count), [&]() {
+      for (size_t i = 0;i<count;++i) out[i] = Mat4::inverse(matrices[i]);
+      MicroBench::keep(out);
+    });
+  }
+
+  void benchOcclusionCuller(MicroBench& bench, const std::filesystem::path& dir) {
+    const std::string filename = (dir / "occluder.obj").string();
+    writeSphereOBJ(filename, 32);
+    const OBJFile sphere{filename};
+    const Mat4 viewProjection = Mat4::perspective(60.0f, 2.0f, 0.5f, 200.0f) *
+                                Mat4::lookAt({0.0f, 2.0f, 15.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+
+    OcclusionCuller culler{256, 128};
+    const auto drawOccluders = [&]() {
+      culler.clear(viewProjection);
+      for (uint32_t i = 0;i<16;++i) {
+        const Mat4 model = Mat4::translation(float(i%4)*4.0f - 6.0f, float(i/4)*2.0f - 3.0f, 0.0f) * Mat4::scaling(1.5f);
+        culler.addOccluder(sphere, model);
+      }
+      culler.rasterize();
+    };
+    drawOccluders();
+    bench.run("OcclusionCuller::rasterize/" + std::to_string(16*sphere.indices.size()), Unit::OPS,
+              double(16*sphere.indices.size()), [&]() {
+      drawOccluders();
+      MicroBench::keep(culler.getOccluderTriangles());
+    });
+
+    const size_t count = 4096;
+    Random random{42};
+    std::vector<Vec3> centers(count);
+    for (Vec3& c : centers) c = Vec3{random.rand11()*10.0f, random.rand11()*5.0f, -random.rand01()*20.0f};
+    bench.run("OcclusionCuller::isVisible", Unit::OPS, double(count), [&]() {
+      size_t visible = 0;
+      for (const Vec3& c : centers) visible += culler.isVisible(c - Vec3{0.5f, 0.5f, 0.5f}, c + Vec3{0.5f, 0.5f, 0.5f});
+      MicroBench::keep(visible);
+    });
+  }
+
+  void benchRandom(MicroBench& bench) {
+    const size_t count = 65536;
+    Random random{42};
+
+    bench.run("Random::rand01", Unit::OPS, double(count), [&]() {
+      float sum = 0.0f;
+      for (size_t i = 0;i<count;++i) sum += random.rand01();
+      MicroBench::keep(sum);
+    });
+    bench.run("Random::rand11", Unit::OPS, double(count), [&]() {
+      float sum = 0.0f;
+      for (size_t i = 0;i<count;++i) sum += random.rand11();
+      MicroBench::keep(sum);
+    });
+    bench.run("Random::rand0Pi", Unit::OPS, double(count), [&]() {
+      float sum = 0.0f;
+      for (size_t i = 0;i<count;++i) sum += random.rand0Pi();
+      MicroBench::keep(sum);
+    });
+    bench.run("Random::rand<int>", Unit::OPS, double(count), [&]() {
+      int sum = 0;
+      for (size_t i = 0;i<count;++i) sum += random.rand(0, 100);
+      MicroBench::keep(sum);
+    });
+  }
+
+  void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--quick] [--filter TEXT] [--report FILE]"
+              << " [--baseline FILE] [--tolerance FRACTION]" << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  bool quick = false;
+  std::string filter;
+  std::string reportFile;
+  std::string baselineFile;
+  double tolerance = 0.15;
+
+  for (int i = 1;i<argc;++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i+1 < argc;
+    if (arg == "--quick") {
+      quick = true;
+    } else if (arg == "--filter" && hasValue) {
+      filter = argv[++i];
+    } else if (arg == "--report" && hasValue) {
+      reportFile = argv[++i];
+    } else if (arg == "--baseline" && hasValue) {
+      baselineFile = argv[++i];
+    } else if (arg == "--tolerance" && hasValue) {
+      tolerance = std::atof(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  const std::filesystem::path dir = std::filesystem::temp_directory_path() / "utils_bench";
+  std::filesystem::create_directories(dir);
+
+  MicroBench bench{quick ? 0.01 : 0.05, quick ? 3u : 5u, filter};
+  try {
+    benchImage(bench, quick ? std::vector<uint32_t>{256} : std::vector<uint32_t>{256, 1024});
+    benchGrid2D(bench, quick ? std::vector<uint32_t>{256} : std::vector<uint32_t>{256, 1024});
+    benchOBJFile(bench, dir, quick ? std::vector<uint32_t>{64} : std::vector<uint32_t>{64, 256});
+    benchFiles(bench, dir, quick ? std::vector<uint32_t>{512} : std::vector<uint32_t>{512, 2048});
+    benchMat4(bench);
+    benchOcclusionCuller(bench, dir);
+    benchRandom(bench);
+  } catch (const std::exception& e) {
+    std::cerr << "Benchmark failed: " << e.what() << std::endl;
+    std::filesystem::remove_all(dir);
+    return EXIT_FAILURE;
+  }
+  std::filesystem::remove_all(dir);
+
+  if (!reportFile.empty()) {
+    if (!bench.writeJSON(reportFile)) {
+      std::cerr << "Unable to write " << reportFile << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "Report written to " << reportFile << std::endl;
+  }
+
+  if (!baselineFile.empty()) {
+    if (!std::filesystem::exists(baselineFile)) {
+      std::cout << "No baseline " << baselineFile << " (create one with 'make bench-baseline')" << std::endl;
+      return EXIT_SUCCESS;
+    }
+    try {
+      return bench.compare(MicroBench::readJSON(baselineFile), tolerance, std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}